@@ -0,0 +1,214 @@
+#pragma once
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include "iViewXTypes.h"
+
+
+namespace SMIbuff
+{
+    // Binary log of a recording, written by SMIbuffer's log thread (see
+    // SMIbuffer::startLogging). Layout, all little-endian:
+    //   file header: LogFileHeader
+    //   blocks:      LogBlockHeader, followed by count SampleStructs or EventStructs
+    //                stored as in memory
+    // Blocks are only appended, each with a checksum of its contents. If the writing
+    // process dies while a block is written, the file ends in a partial block, which
+    // the loader detects and skips: everything before it is still read.
+    constexpr char     g_logMagic[8]  = {'S','M','I','B','L','O','G','\0'};
+    constexpr uint32_t g_logVersion   = 1;
+
+    struct LogFileHeader
+    {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    sampleSize;     // sizeof(SampleStruct) of the writer, structs are stored
+        uint32_t    eventSize;      // as is, so loader must match
+        uint32_t    reserved;
+    };
+    enum class LogBlockType : uint32_t
+    {
+        Samples = 1,
+        Events  = 2
+    };
+    struct LogBlockHeader
+    {
+        LogBlockType    type;
+        uint32_t        count;      // number of elements in the block
+        uint64_t        checksum;   // logChecksum of the block's elements
+    };
+
+    // FNV-1a style hash, on 8 bytes at a time so the loader isn't limited by it
+    inline uint64_t logChecksum(const void* data_, size_t nBytes_)
+    {
+        auto p = static_cast<const unsigned char*>(data_);
+        uint64_t h = 14695981039346656037ull;
+        for (; nBytes_ >= 8; nBytes_ -= 8, p += 8)
+        {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            h = (h ^ w) * 1099511628211ull;
+        }
+        for (; nBytes_; nBytes_--, p++)
+            h = (h ^ *p) * 1099511628211ull;
+        return h;
+    }
+
+    // Appends blocks to a log file. Each write() is flushed to the OS before it returns.
+    // What survives a crash is decided by the blocks' checksums: the loader keeps all
+    // complete blocks and skips a partial or corrupt last one. write() returns false
+    // once the file can't be written (e.g. disk full), the file then likely ends in a
+    // partial block, and nothing more should be written to it (SMIbuffer stops logging).
+    // Not thread safe, caller (SMIbuffer) serializes access.
+    class LogWriter
+    {
+    public:
+        bool open(const std::string& path_)
+        {
+            close();
+            _file.open(path_, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!_file.is_open())
+                return false;
+
+            LogFileHeader header{};
+            std::memcpy(header.magic, g_logMagic, sizeof(g_logMagic));
+            header.version    = g_logVersion;
+            header.sampleSize = sizeof(SampleStruct);
+            header.eventSize  = sizeof(EventStruct);
+            _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            _file.flush();
+            return _file.good();
+        }
+        bool isOpen() const
+        {
+            return _file.is_open();
+        }
+        void close()
+        {
+            if (_file.is_open())
+                _file.close();
+        }
+
+        bool write(const std::vector<SampleStruct>& data_)
+        {
+            return writeBlock(LogBlockType::Samples, data_);
+        }
+        bool write(const std::vector<EventStruct>& data_)
+        {
+            return writeBlock(LogBlockType::Events, data_);
+        }
+
+    private:
+        template <typename T>
+        bool writeBlock(LogBlockType type_, const std::vector<T>& data_)
+        {
+            // split very large batches, count is 32 bit
+            constexpr size_t maxCount = UINT32_MAX / sizeof(T);
+            for (size_t i = 0; i < data_.size(); i += maxCount)
+            {
+                const auto n = std::min(data_.size() - i, maxCount);
+                LogBlockHeader header{};
+                header.type     = type_;
+                header.count    = static_cast<uint32_t>(n);
+                header.checksum = logChecksum(data_.data() + i, n * sizeof(T));
+                _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                _file.write(reinterpret_cast<const char*>(data_.data() + i), n * sizeof(T));
+                if (!_file.good())
+                    return false;
+            }
+            _file.flush();
+            return _file.good();
+        }
+
+    private:
+        std::ofstream   _file;
+    };
+
+    struct LogContents
+    {
+        std::vector<SampleStruct>   samples;
+        std::vector<EventStruct>    events;
+        bool                        complete = true;    // false if file ended in a partial or corrupt block (e.g. writer crashed)
+    };
+
+    // read a whole log file. Returns false if the file can't be opened or isn't a log
+    // file written by a compatible build
+    inline bool readLog(const std::string& path_, LogContents& out_)
+    {
+        out_ = LogContents{};
+        std::ifstream file(path_, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+        const auto fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        LogFileHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, g_logMagic, sizeof(g_logMagic)) != 0 ||
+            header.version != g_logVersion ||
+            header.sampleSize != sizeof(SampleStruct) || header.eventSize != sizeof(EventStruct))
+            return false;
+
+        // first pass over block headers to size the outputs, so that the second pass
+        // can read each block straight into its final place
+        struct Block { LogBlockHeader header; uint64_t offset; };
+        std::vector<Block> blocks;
+        size_t nSamples = 0, nEvents = 0;
+        uint64_t pos = sizeof(header);
+        LogBlockHeader block;
+        while (pos + sizeof(block) <= fileSize && file.read(reinterpret_cast<char*>(&block), sizeof(block)))
+        {
+            size_t elSize;
+            if (block.type == LogBlockType::Samples)
+                elSize = sizeof(SampleStruct);
+            else if (block.type == LogBlockType::Events)
+                elSize = sizeof(EventStruct);
+            else
+                break;
+            const auto nBytes = static_cast<uint64_t>(block.count) * elSize;
+            if (pos + sizeof(block) + nBytes > fileSize)
+                break;
+
+            blocks.push_back({block, pos + sizeof(block)});
+            (block.type == LogBlockType::Samples ? nSamples : nEvents) += block.count;
+            pos += sizeof(block) + nBytes;
+            file.seekg(static_cast<std::streamoff>(pos));
+        }
+        out_.complete = pos == fileSize;
+
+        out_.samples.resize(nSamples);
+        out_.events.resize(nEvents);
+        file.clear();
+        size_t iSamp = 0, iEv = 0;
+        for (const auto& b : blocks)
+        {
+            char* dest;
+            size_t nBytes;
+            if (b.header.type == LogBlockType::Samples)
+            {
+                dest   = reinterpret_cast<char*>(out_.samples.data() + iSamp);
+                nBytes = b.header.count * sizeof(SampleStruct);
+            }
+            else
+            {
+                dest   = reinterpret_cast<char*>(out_.events.data() + iEv);
+                nBytes = b.header.count * sizeof(EventStruct);
+            }
+            file.seekg(static_cast<std::streamoff>(b.offset));
+            if (!file.read(dest, nBytes) || logChecksum(dest, nBytes) != b.header.checksum)
+            {
+                // corrupt block, keep what came before it
+                out_.complete = false;
+                break;
+            }
+            (b.header.type == LogBlockType::Samples ? iSamp : iEv) += b.header.count;
+        }
+        out_.samples.resize(iSamp);
+        out_.events.resize(iEv);
+        return true;
+    }
+}
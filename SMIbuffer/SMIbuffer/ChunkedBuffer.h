@@ -0,0 +1,1156 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "SpillFile.h"
+#include "CompressedStore.h"
+
+
+namespace SMIbuff
+{
+    // what happens when a buffer is full
+    enum class OverflowPolicy
+    {
+        Grow,           // buffer grows (default). Memory use is unbounded
+        DropOldest,     // fixed capacity, oldest elements are overwritten
+        DropNewest,     // fixed capacity, incoming elements are discarded
+        SpillToDisk,    // fixed capacity, a background thread moves the oldest elements to a
+                        // temporary file on disk. They are returned first by consume()
+                        // If the spill thread can't keep up, or the file can't be written
+                        // (e.g. disk full), incoming elements are discarded (and counted)
+        Compress        // as SpillToDisk, but the oldest elements are compressed (losslessly)
+                        // and kept in memory (see CompressedStore). The fixed capacity is the
+                        // window of recent elements kept uncompressed. Noisy samples only
+                        // compress to about 3/4 of their size
+    };
+
+    // name of the reader that exists from the start, used when no reader is specified
+    constexpr const char* g_defaultReader = "";
+
+    struct OverflowCounts
+    {
+        uint64_t dropped    = 0;    // elements lost because the buffer was full (under DropOldest, some readers may have read them before)
+        uint64_t spilled    = 0;    // elements moved to disk (not lost, still returned by consume)
+        uint64_t compressed = 0;    // elements moved to the compressed tier (idem)
+    };
+
+    // runtime statistics of a buffer, see ChunkedBuffer::getStats()
+    struct BufferStats
+    {
+        uint64_t dropped          = 0;  // as in OverflowCounts
+        uint64_t spilled          = 0;
+        uint64_t compressed       = 0;
+        uint64_t compressedBytes  = 0;  // memory used by the compressed tier (bytes)
+        uint64_t peakSize         = 0;  // most elements held in memory at once
+        uint64_t chunkAllocations = 0;  // chunks the producer had to allocate because none were free (buffer grew beyond what was reserved)
+        uint64_t lockWaits        = 0;  // number of times a reader had to wait for the buffer's lock
+        uint64_t lockWaitTime     = 0;  // total time readers waited for the lock (ns)
+        uint64_t maxLockWait      = 0;  // longest wait for the lock (ns)
+    };
+
+    // shared mutex that keeps track of how long lockers had to wait for it. The clock is
+    // only read when the lock is not immediately available, so uncontended locking costs
+    // the same as for the plain mutex
+    class WaitTimedMutex
+    {
+    public:
+        void lock()
+        {
+            if (!_m.try_lock())
+            {
+                const auto t0 = std::chrono::steady_clock::now();
+                _m.lock();
+                recordWait(t0);
+            }
+        }
+        bool try_lock()
+        {
+            return _m.try_lock();
+        }
+        void unlock()
+        {
+            _m.unlock();
+        }
+        void lock_shared()
+        {
+            if (!_m.try_lock_shared())
+            {
+                const auto t0 = std::chrono::steady_clock::now();
+                _m.lock_shared();
+                recordWait(t0);
+            }
+        }
+        bool try_lock_shared()
+        {
+            return _m.try_lock_shared();
+        }
+        void unlock_shared()
+        {
+            _m.unlock_shared();
+        }
+
+        void getStats(BufferStats& out_) const
+        {
+            out_.lockWaits    = _waits.load(std::memory_order_relaxed);
+            out_.lockWaitTime = _waitTime.load(std::memory_order_relaxed);
+            out_.maxLockWait  = _maxWait.load(std::memory_order_relaxed);
+        }
+        void resetStats()
+        {
+            _waits.store(0, std::memory_order_relaxed);
+            _waitTime.store(0, std::memory_order_relaxed);
+            _maxWait.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        void recordWait(std::chrono::steady_clock::time_point t0_)
+        {
+            const auto wait = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0_).count());
+            _waits.fetch_add(1, std::memory_order_relaxed);
+            _waitTime.fetch_add(wait, std::memory_order_relaxed);
+            auto cur = _maxWait.load(std::memory_order_relaxed);
+            while (cur < wait && !_maxWait.compare_exchange_weak(cur, wait, std::memory_order_relaxed))
+                ;
+        }
+
+    private:
+        std::shared_timed_mutex _m;
+        std::atomic<uint64_t>   _waits{0};
+        std::atomic<uint64_t>   _waitTime{0};
+        std::atomic<uint64_t>   _maxWait{0};
+    };
+
+    // Zero-copy view on the next unconsumed elements of a reader: spans pointing
+    // directly into the buffer's storage (one per chunk touched). The view stays valid
+    // until the reader is advanced or removed, or the buffer is cleared. Under the
+    // DropOldest policy the producer may overwrite viewed elements, and under
+    // SpillToDisk and Compress they may be moved out of memory and their storage reused:
+    // check isValid() after processing the view, and view again if it wasn't.
+    // Elements that were spilled to disk or compressed can't be viewed. If the reader's
+    // next elements are on disk (or compressed), the view is empty and nOnDisk says how
+    // many to consume() first
+    template <typename T>
+    struct BufferView
+    {
+        struct Span
+        {
+            const T*    data;
+            size_t      size;
+        };
+        std::vector<Span>   spans;
+        uint64_t            start   = 0;    // position of first element
+        size_t              size    = 0;    // total number of elements in the spans
+        size_t              nOnDisk = 0;
+    };
+
+    // storage is made up of chunks of this many elements
+    constexpr size_t g_chunkSizeLog2 = 12;
+    constexpr size_t g_chunkSize     = size_t(1) << g_chunkSizeLog2;
+    // max number of chunks in use at the same time (for samples, that is 268M samples, ~30GB)
+    constexpr size_t g_maxChunks     = size_t(1) << 16;
+
+    // timestamp of an element, used by the time range queries. Specialize for each
+    // element type (see Timestamps.h)
+    template <typename T>
+    struct TimestampOf;
+
+    // Layout of the elements within a chunk. A layout provides the storage for one
+    // chunk (Block), a function to store an element, and functions to copy elements out
+    // as array of T or into a columns type (one array per field, e.g. SampleColumns).
+    // The default layout stores elements as is
+    template <typename T>
+    struct RowLayout
+    {
+        static constexpr bool isContiguous = true;  // elements can be viewed in place
+
+        struct Block
+        {
+            T data[g_chunkSize];    // NB: default-init, so memory isn't touched up front
+        };
+
+        static void store(Block& block_, size_t i_, const T& item_)
+        {
+            block_.data[i_] = item_;
+        }
+        template <typename Columns>
+        static void store(Block& block_, size_t i_, const Columns& in_, size_t from_, size_t n_)
+        {
+            in_.get(from_, block_.data + i_, n_);
+        }
+        static const T* data(const Block& block_, size_t i_)
+        {
+            return block_.data + i_;
+        }
+        static int64_t timestamp(const Block& block_, size_t i_)
+        {
+            return TimestampOf<T>::get(block_.data[i_]);
+        }
+        static void copy(const Block& block_, size_t i_, size_t n_, T* out_)
+        {
+            std::copy_n(block_.data + i_, n_, out_);
+        }
+        template <typename Columns>
+        static void copy(const Block& block_, size_t i_, size_t n_, Columns& out_, size_t at_)
+        {
+            out_.put(at_, block_.data + i_, n_);
+        }
+    };
+
+    // Storage engine for the sample and event streams.
+    // There is a single producer (the SDK's callback thread) and any number of readers.
+    // The producer never takes a lock and never waits for readers. Readers serialize
+    // among themselves: peeks can run concurrently, consumes and other modifying calls
+    // are exclusive.
+    // Elements are stored in fixed-size chunks. Positions are absolute (count of elements
+    // pushed since construction); position p lives in chunk p/g_chunkSize, which is found
+    // through a directory of chunk pointers indexed by chunk number modulo g_maxChunks.
+    // Growing means adding a chunk, and consuming only touches the consumed elements.
+    // Chunks that have been fully consumed are returned to a pool, from which the
+    // producer takes new chunks. The pool is kept across clears, so that after the first
+    // trial no more allocations are needed.
+    // Under the DropOldest policy, the producer advances the tail and reuses the oldest
+    // chunk itself. Readers therefore validate what they copied: anything that fell
+    // behind the tail while copying may be torn and is discarded.
+    // Consuming is done through named readers, each with their own read position, so
+    // that multiple consumers (e.g. display, logging and online analysis) each get all
+    // elements. Storage is only released once the slowest reader is past it. A default
+    // reader (g_defaultReader) exists from the start; remove it if only named readers
+    // are used, or it will hold on to all data.
+    // How elements are laid out in a chunk is determined by Layout (see RowLayout).
+    template <typename T, typename Layout = RowLayout<T>>
+    class ChunkedBuffer
+    {
+    public:
+        ChunkedBuffer() :
+            _directory(std::make_unique<std::atomic<Chunk*>[]>(g_maxChunks))
+        {
+            _readers[g_defaultReader] = 0;
+        }
+        ~ChunkedBuffer()
+        {
+            stopSpillThread();
+            // delete chunks in use and in the pool
+            const auto h = _head.load();
+            const auto last = (h + g_chunkSize - 1) >> g_chunkSizeLog2;
+            for (auto c = _released.load(); c < last; ++c)
+                delete _directory[c % g_maxChunks].load();
+            while (auto chunk = poolPop())
+                delete chunk;
+        }
+        ChunkedBuffer(const ChunkedBuffer&) = delete;
+        ChunkedBuffer& operator=(const ChunkedBuffer&) = delete;
+
+        // producer side. Only to be called from a single thread
+        void push(const T& item_)
+        {
+            const auto h = _head.load(std::memory_order_relaxed);
+            const auto policy = _policy.load(std::memory_order_relaxed);
+            if (policy != OverflowPolicy::Grow)
+            {
+                const auto t = _tail.load(std::memory_order_acquire);
+                const auto capacity = _capacity.load(std::memory_order_relaxed);
+                if (h - t >= capacity)
+                {
+                    if (policy == OverflowPolicy::DropOldest)
+                    {
+                        // make room by moving tail. A consumer may move the tail concurrently, so CAS
+                        auto cur = t;
+                        const auto newTail = h + 1 - capacity;
+                        while (cur < newTail && !_tail.compare_exchange_weak(cur, newTail, std::memory_order_relaxed))
+                            ;
+                        if (cur < newTail)
+                            _dropped.fetch_add(newTail - cur, std::memory_order_relaxed);
+                        // tail update must be visible before we overwrite anything (pairs with fence in validate())
+                        std::atomic_thread_fence(std::memory_order_release);
+                    }
+                    else
+                    {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+
+            const auto offset = static_cast<size_t>(h & (g_chunkSize - 1));
+            if (!offset)
+            {
+                // first element of a new chunk
+                _writeChunk = acquireChunk(h >> g_chunkSizeLog2, policy);
+                if (!_writeChunk)
+                {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+
+            Layout::store(_writeChunk->block, offset, item_);
+            _head.store(h + 1, std::memory_order_release);
+
+            // only the producer writes the peak, so no CAS needed
+            const auto fill = h + 1 - _tail.load(std::memory_order_relaxed);
+            if (fill > _peakSize.load(std::memory_order_relaxed))
+                _peakSize.store(fill, std::memory_order_relaxed);
+        }
+        // push n_ elements of a columns type (e.g. SampleColumns), starting at its index
+        // from_. Same as pushing them one at a time, but stores each field a chunk-run
+        // at a time. Only the fields selected in in_ are stored
+        template <typename Columns>
+        void push(const Columns& in_, size_t from_, size_t n_)
+        {
+            while (n_)
+            {
+                const auto h = _head.load(std::memory_order_relaxed);
+                const auto policy = _policy.load(std::memory_order_relaxed);
+                const auto offset = static_cast<size_t>(h & (g_chunkSize - 1));
+                const auto run = std::min(n_, g_chunkSize - offset);
+                if (policy != OverflowPolicy::Grow &&
+                    h + run - _tail.load(std::memory_order_acquire) > _capacity.load(std::memory_order_relaxed))
+                {
+                    // (about to be) full: leave the overflow handling to the single-element push
+                    T item{};
+                    in_.get(from_++, &item, 1);
+                    push(item);
+                    --n_;
+                    continue;
+                }
+
+                if (!offset)
+                {
+                    _writeChunk = acquireChunk(h >> g_chunkSizeLog2, policy);
+                    if (!_writeChunk)
+                    {
+                        _dropped.fetch_add(n_, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+
+                Layout::store(_writeChunk->block, offset, in_, from_, run);
+                _head.store(h + run, std::memory_order_release);
+                from_ += run;
+                n_    -= run;
+
+                const auto fill = h + run - _tail.load(std::memory_order_relaxed);
+                if (fill > _peakSize.load(std::memory_order_relaxed))
+                    _peakSize.store(fill, std::memory_order_relaxed);
+            }
+        }
+
+        // reader side
+        // set overflow policy, and make sure that enough chunks for capacity_ elements
+        // are allocated. For the bounded policies, capacity_ is the fixed capacity of the
+        // buffer, for Grow it is the initial capacity
+        void reserve(size_t capacity_, OverflowPolicy policy_ = OverflowPolicy::Grow)
+        {
+            {
+                write_lock l(_readMutex);
+                _capacity.store(std::max<size_t>(capacity_, 1), std::memory_order_relaxed);
+                _policy.store(policy_, std::memory_order_relaxed);
+
+                // +1 as the used range generally doesn't start at a chunk boundary
+                const auto nChunks = std::min((capacity_ + g_chunkSize - 1) / g_chunkSize + 1, g_maxChunks);
+                while (_nAllocated.load(std::memory_order_relaxed) < nChunks)
+                {
+                    poolPush(new Chunk);
+                    _nAllocated.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            if (policy_ == OverflowPolicy::SpillToDisk || policy_ == OverflowPolicy::Compress)
+                startSpillThread();
+            else
+                stopSpillThread();
+        }
+        void clear()
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            _spillFile.clear();
+            _compressedStore.clear();
+            auto cur = _tail.load(std::memory_order_relaxed);
+            const auto h = _head.load(std::memory_order_acquire);
+            while (cur < h && !_tail.compare_exchange_weak(cur, h, std::memory_order_relaxed))
+                ;
+            for (auto& r : _readers)
+                r.second = std::max(r.second, h);
+            releaseChunks();
+            _dropped.store(0, std::memory_order_relaxed);
+            _spilled.store(0, std::memory_order_relaxed);
+            _compressed.store(0, std::memory_order_relaxed);
+        }
+        // number of elements stored, both in memory and on disk (or compressed)
+        size_t size() const
+        {
+            return memSize() + coldSize();
+        }
+
+        // add a reader. It starts at the oldest element still stored. Returns false if
+        // a reader with this name already exists
+        bool addReader(const std::string& name_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            return _readers.emplace(name_, coldSize() ? _fileStart : _tail.load(std::memory_order_acquire)).second;
+        }
+        // remove a reader, storage only it still needed is released. Returns false if
+        // there is no reader with this name
+        bool removeReader(const std::string& name_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            if (!_readers.erase(name_))
+                return false;
+            releaseConsumed();
+            return true;
+        }
+        bool hasReader(const std::string& name_) const
+        {
+            read_lock l(_readMutex);
+            return _readers.count(name_) > 0;
+        }
+        std::vector<std::string> getReaders() const
+        {
+            read_lock l(_readMutex);
+            std::vector<std::string> out;
+            out.reserve(_readers.size());
+            for (const auto& r : _readers)
+                out.push_back(r.first);
+            return out;
+        }
+        // number of elements not yet consumed by reader_
+        size_t available(const std::string& reader_ = g_defaultReader) const
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            read_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            return it == _readers.end() ? 0 : availableFrom(it->second);
+        }
+        OverflowCounts getOverflowCounts() const
+        {
+            OverflowCounts out;
+            out.dropped = _dropped.load(std::memory_order_relaxed);
+            out.spilled = _spilled.load(std::memory_order_relaxed);
+            out.compressed = _compressed.load(std::memory_order_relaxed);
+            return out;
+        }
+        // statistics, for diagnosing stutters. These are collected always, and accumulate
+        // until resetStats() (dropped and spilled are also reset by clear())
+        BufferStats getStats() const
+        {
+            BufferStats out;
+            out.dropped          = _dropped.load(std::memory_order_relaxed);
+            out.spilled          = _spilled.load(std::memory_order_relaxed);
+            out.compressed       = _compressed.load(std::memory_order_relaxed);
+            out.compressedBytes  = _compressedStore.memoryUsage();
+            out.peakSize         = _peakSize.load(std::memory_order_relaxed);
+            out.chunkAllocations = _chunkAllocations.load(std::memory_order_relaxed);
+            _readMutex.getStats(out);
+            return out;
+        }
+        // peak size restarts from the current size. NB: racing with the producer, an
+        // update may get lost
+        void resetStats()
+        {
+            _peakSize.store(memSize(), std::memory_order_relaxed);
+            _chunkAllocations.store(0, std::memory_order_relaxed);
+            _readMutex.resetStats();
+        }
+        // copy last N or all elements if less than N available
+        std::vector<T> peek(size_t lastN_) const
+        {
+            return peekImpl<std::vector<T>>(lastN_, {});
+        }
+        // same, but output one array per field (e.g. SampleColumns). out_ is the empty
+        // container to fill, e.g. a SampleColumns with a field selection
+        template <typename Columns>
+        Columns peekColumns(size_t lastN_, Columns out_ = Columns{}) const
+        {
+            return peekImpl<Columns>(lastN_, std::move(out_));
+        }
+        // return first N or all elements if less than N available that reader_ has not
+        // consumed yet, and mark them consumed for that reader
+        std::vector<T> consume(size_t firstN_, const std::string& reader_ = g_defaultReader)
+        {
+            return consumeImpl<std::vector<T>>(firstN_, reader_, {});
+        }
+        // same, but output one array per field (e.g. SampleColumns)
+        template <typename Columns>
+        Columns consumeColumns(size_t firstN_, const std::string& reader_ = g_defaultReader, Columns out_ = Columns{})
+        {
+            return consumeImpl<Columns>(firstN_, reader_, std::move(out_));
+        }
+        // same as consume, but write into caller-owned storage instead of a new vector:
+        // out_ has room for capacity_ elements. Returns the number of elements written
+        size_t consumeInto(T* out_, size_t capacity_, const std::string& reader_ = g_defaultReader)
+        {
+            if (!out_)
+                return 0;
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            if (it == _readers.end())
+                return 0;
+
+            const auto n = readFrom(it->second, out_, std::min(capacity_, availableFrom(it->second)));
+            releaseConsumed();
+            return n;
+        }
+        // same as consumeColumns, but reuse out_'s arrays (and field selection), which
+        // then only allocate when they have to grow beyond what they held before
+        template <typename Columns>
+        size_t consumeColumnsInto(Columns& out_, size_t firstN_, const std::string& reader_ = g_defaultReader)
+        {
+            out_.resize(0);
+            out_ = consumeImpl<Columns>(firstN_, reader_, std::move(out_));
+            return out_.size();
+        }
+
+        // time range queries, using the element's timestamp (see TimestampOf). As
+        // timestamps are monotonic, the range is found with a binary search, so these
+        // cost O(log n + k) for k elements returned
+        // copy elements with tStart_ <= timestamp < tEnd_
+        std::vector<T> peekRange(int64_t tStart_, int64_t tEnd_) const
+        {
+            return peekRangeImpl<std::vector<T>>(tStart_, tEnd_, {});
+        }
+        template <typename Columns>
+        Columns peekRangeColumns(int64_t tStart_, int64_t tEnd_, Columns out_ = Columns{}) const
+        {
+            return peekRangeImpl<Columns>(tStart_, tEnd_, std::move(out_));
+        }
+        // return elements not yet consumed by reader_ with timestamp < ts_, and mark
+        // them consumed for that reader
+        std::vector<T> consumeUntil(int64_t ts_, const std::string& reader_ = g_defaultReader)
+        {
+            return consumeUntilImpl<std::vector<T>>(ts_, reader_, {});
+        }
+        template <typename Columns>
+        Columns consumeUntilColumns(int64_t ts_, const std::string& reader_ = g_defaultReader, Columns out_ = Columns{})
+        {
+            return consumeUntilImpl<Columns>(ts_, reader_, std::move(out_));
+        }
+        // zero-copy access to the first N (or all if less available) elements that
+        // reader_ has not consumed yet. They are not marked consumed, call advance() when
+        // done with them. Only possible for layouts that store T as is, for others the
+        // view is always empty
+        BufferView<T> view(const std::string& reader_, size_t firstN_) const
+        {
+            BufferView<T> out;
+            if constexpr (Layout::isContiguous)
+            {
+                // need the spill lock even if the file is empty, the spill thread may be
+                // between moving the tail and writing to the file
+                std::lock_guard<std::mutex> sl(_spillMutex);
+                read_lock l(_readMutex);
+                const auto it = _readers.find(reader_);
+                if (it == _readers.end())
+                    return out;
+                auto pos = it->second;
+                const auto fileEnd = _fileBase + coldSize();
+                if (pos < fileEnd)
+                {
+                    out.nOnDisk = static_cast<size_t>(fileEnd - std::max(pos, _fileStart));
+                    return out;
+                }
+
+                pos = std::max(pos, _tail.load(std::memory_order_acquire));
+                auto n = static_cast<size_t>(std::min<uint64_t>(_head.load(std::memory_order_acquire) - pos, firstN_));
+                out.start = pos;
+                out.size  = n;
+                while (n)
+                {
+                    const auto offset = static_cast<size_t>(pos & (g_chunkSize - 1));
+                    const auto nSpan  = std::min(n, g_chunkSize - offset);
+                    out.spans.push_back({Layout::data(chunkAt(pos)->block, offset), nSpan});
+                    pos += nSpan;
+                    n   -= nSpan;
+                }
+            }
+            return out;
+        }
+        // check that a view's elements weren't overwritten by the producer, spilled to
+        // disk or compressed, or removed by clear(). Call after processing the view
+        bool isValid(const BufferView<T>& view_) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return _tail.load(std::memory_order_relaxed) <= view_.start;
+        }
+        // mark first N (or all if less available) unconsumed elements of reader_ as
+        // consumed, without copying them. Returns number of elements skipped
+        size_t advance(const std::string& reader_, size_t n_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            if (it == _readers.end())
+                return 0;
+
+            n_ = readFrom(it->second, static_cast<T*>(nullptr), n_);
+            releaseConsumed();
+            return n_;
+        }
+
+        // access by position: elements are numbered in order of arrival, from 0. Unlike
+        // time ranges, positions need no search, e.g. to remember where something began
+        // position of the next element to be written. Not reset by clear()
+        uint64_t writePosition() const
+        {
+            return _head.load(std::memory_order_acquire);
+        }
+        // copy elements at positions [first_, last_) that are still stored
+        std::vector<T> peekPositions(uint64_t first_, uint64_t last_) const
+        {
+            return peekPositionsImpl<std::vector<T>>(first_, last_, {});
+        }
+        template <typename Columns>
+        Columns peekPositionsColumns(uint64_t first_, uint64_t last_, Columns out_ = Columns{}) const
+        {
+            return peekPositionsImpl<Columns>(first_, last_, std::move(out_));
+        }
+        // return elements at positions [first_, last_) that reader_ has not consumed
+        // yet, and move the reader past last_ (skipping anything before first_)
+        std::vector<T> consumePositions(uint64_t first_, uint64_t last_, const std::string& reader_ = g_defaultReader)
+        {
+            return consumePositionsImpl<std::vector<T>>(first_, last_, reader_, {});
+        }
+        template <typename Columns>
+        Columns consumePositionsColumns(uint64_t first_, uint64_t last_, const std::string& reader_ = g_defaultReader, Columns out_ = Columns{})
+        {
+            return consumePositionsImpl<Columns>(first_, last_, reader_, std::move(out_));
+        }
+        // move all readers to at least position pos_, releasing the storage before it
+        void discardUntil(uint64_t pos_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            pos_ = std::min(pos_, _head.load(std::memory_order_acquire));
+            for (auto& r : _readers)
+                r.second = std::max(r.second, pos_);
+            releaseConsumed();
+        }
+        // position of the first element still stored with a timestamp of at least ts_
+        // (writePosition() if there is none), a binary search as for the time range
+        // queries
+        uint64_t findPosition(int64_t ts_) const
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            read_lock l(_readMutex);
+            return lowerBound(0, ts_);
+        }
+
+    private:
+        typedef WaitTimedMutex               mutex_type;
+        typedef std::shared_lock<mutex_type> read_lock;
+        typedef std::unique_lock<mutex_type> write_lock;
+
+        struct Chunk
+        {
+            Chunk*                  next;   // for use in pool
+            typename Layout::Block  block;
+        };
+
+        // spill thread checks fill at this interval, and starts spilling (or compressing)
+        // when buffer is more than 3/4 full, until it is at most half full
+        static constexpr auto   g_spillInterval = std::chrono::milliseconds(10);
+
+        size_t memSize() const
+        {
+            return static_cast<size_t>(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+        }
+
+        Chunk* chunkAt(uint64_t pos_) const
+        {
+            return _directory[(pos_ >> g_chunkSizeLog2) % g_maxChunks].load(std::memory_order_acquire);
+        }
+
+        // Out is either T* or pointer to a columns type. at_ is the index in out_ to
+        // start writing at
+        template <typename Out>
+        void copyOut(uint64_t from_, size_t n_, Out out_, size_t at_) const
+        {
+            // copy chunk by chunk
+            while (n_)
+            {
+                const auto offset = static_cast<size_t>(from_ & (g_chunkSize - 1));
+                const auto nCopy  = std::min(n_, g_chunkSize - offset);
+                if constexpr (std::is_same_v<Out, T*>)
+                    Layout::copy(chunkAt(from_)->block, offset, nCopy, out_ + at_);
+                else
+                    Layout::copy(chunkAt(from_)->block, offset, nCopy, *out_, at_);
+                from_ += nCopy;
+                at_   += nCopy;
+                n_    -= nCopy;
+            }
+        }
+        // the elements moved out of memory are in the spill file or in the compressed
+        // store, depending on the policy. Only one of them holds elements at a time. Need
+        // _spillMutex (except coldSize)
+        size_t coldSize() const
+        {
+            return _spillFile.size() + _compressedStore.size();
+        }
+        size_t coldRead(uint64_t index_, T* out_, size_t n_) const
+        {
+            return _compressedStore.size() ? _compressedStore.read(index_, out_, n_) : _spillFile.read(index_, out_, n_);
+        }
+
+        template <typename Out>
+        size_t copyOutDisk(uint64_t index_, size_t n_, Out out_, size_t at_) const
+        {
+            if constexpr (std::is_same_v<Out, T*>)
+                return coldRead(index_, out_ + at_, n_);
+            else
+            {
+                std::vector<T> temp(n_);
+                temp.resize(coldRead(index_, temp.data(), n_));
+                out_->put(at_, temp.data(), temp.size());
+                return temp.size();
+            }
+        }
+
+        // check that elements copied from [from_, from_+n_) were not overwritten by the
+        // producer while copying (can only happen under DropOldest). Invalid elements are
+        // removed from out_ (they start at at_). Returns position and number of remaining
+        // elements
+        template <typename Out>
+        std::pair<uint64_t, size_t> validate(uint64_t from_, Out out_, size_t at_, size_t n_) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const auto t = _tail.load(std::memory_order_relaxed);
+            if (t <= from_ || !n_)
+                return {from_, n_};
+
+            const auto nBad = static_cast<size_t>(std::min<uint64_t>(t - from_, n_));
+            if constexpr (std::is_same_v<Out, T*>)
+                std::memmove(out_ + at_, out_ + at_ + nBad, (n_ - nBad) * sizeof(T));
+            else
+                out_->erase(at_, nBad);
+            return {from_ + nBad, n_ - nBad};
+        }
+
+        // T* for std::vector<T>, else the container is a columns type and used directly
+        static T* outPtr(std::vector<T>& out_)
+        {
+            return out_.data();
+        }
+        template <typename Columns>
+        static Columns* outPtr(Columns& out_)
+        {
+            return &out_;
+        }
+
+        template <typename Container>
+        Container peekImpl(size_t lastN_, Container out_) const
+        {
+            // if more is requested than available in memory, also need to read from disk
+            std::unique_lock<std::mutex> sl(_spillMutex, std::defer_lock);
+            if (lastN_ > memSize() && coldSize())
+                sl.lock();
+
+            read_lock l(_readMutex);
+            const auto h = _head.load(std::memory_order_acquire);
+            const auto nMem = std::min(static_cast<size_t>(h - _tail.load(std::memory_order_acquire)), lastN_);
+            size_t nDisk = 0;
+            uint64_t fileEnd = 0;
+            if (sl.owns_lock() && nMem < lastN_)
+            {
+                // newest elements on disk go before those in memory
+                fileEnd = _fileBase + coldSize();
+                nDisk = static_cast<size_t>(std::min<uint64_t>(lastN_ - nMem, fileEnd - std::min(_fileStart, fileEnd)));
+            }
+
+            out_.resize(nDisk + nMem);
+            if (nDisk)
+                nDisk = copyOutDisk(fileEnd - nDisk - _fileBase, nDisk, outPtr(out_), 0);
+            copyOut(h - nMem, nMem, outPtr(out_), nDisk);
+            const auto n = validate(h - nMem, outPtr(out_), nDisk, nMem).second;
+            out_.resize(nDisk + n);
+            return out_;
+        }
+
+        template <typename Container>
+        Container consumeImpl(size_t firstN_, const std::string& reader_, Container out_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            if (it == _readers.end())
+                return out_;
+
+            out_.resize(std::min(firstN_, availableFrom(it->second)));
+            out_.resize(readFrom(it->second, outPtr(out_), out_.size()));
+            releaseConsumed();
+            return out_;
+        }
+
+        // number of elements in positions [pos_, end_) that are still stored, on disk
+        // and in memory. Needs _spillMutex and _readMutex
+        size_t availableFrom(uint64_t pos_, uint64_t end_ = UINT64_MAX) const
+        {
+            uint64_t n = 0;
+            const auto fileEnd = std::min(_fileBase + coldSize(), end_);
+            if (pos_ < fileEnd)
+                n += fileEnd - std::min(std::max(pos_, _fileStart), fileEnd);
+            const auto h = std::min(_head.load(std::memory_order_acquire), end_);
+            n += h - std::min(std::max(pos_, _tail.load(std::memory_order_acquire)), h);
+            return static_cast<size_t>(n);
+        }
+
+        // read up to n_ elements from position pos_ on, first from disk and then from
+        // memory, skipping elements that are no longer stored. pos_ is moved past the
+        // elements read. If out_ is null, elements are only skipped over. Doesn't read
+        // at or beyond position end_. Returns number of elements read. Needs _spillMutex
+        // and _readMutex
+        template <typename Out>
+        size_t readFrom(uint64_t& pos_, Out out_, size_t n_, uint64_t end_ = UINT64_MAX) const
+        {
+            size_t nRead = 0;
+            const auto fileEnd = std::min(_fileBase + coldSize(), end_);
+            if (pos_ < fileEnd && n_)
+            {
+                pos_ = std::min(std::max(pos_, _fileStart), fileEnd);
+                nRead = static_cast<size_t>(std::min<uint64_t>(fileEnd - pos_, n_));
+                if (out_)
+                    nRead = copyOutDisk(pos_ - _fileBase, nRead, out_, 0);
+                pos_ += nRead;
+                // reading the file failed: stop here, rather than skip the rest of it
+                if (pos_ < fileEnd && nRead < n_)
+                    return nRead;
+            }
+            if (nRead < n_)
+            {
+                const auto h = std::min(_head.load(std::memory_order_acquire), end_);
+                pos_ = std::min(std::max(pos_, _tail.load(std::memory_order_acquire)), h);
+                auto n = static_cast<size_t>(std::min<uint64_t>(h - pos_, n_ - nRead));
+                if (out_)
+                {
+                    copyOut(pos_, n, out_, nRead);
+                    const auto valid = validate(pos_, out_, nRead, n);
+                    pos_ = valid.first;
+                    n    = valid.second;
+                }
+                pos_  += n;
+                nRead += n;
+            }
+            return nRead;
+        }
+
+        // timestamp of element at position pos_, which must be stored
+        int64_t timestampAt(uint64_t pos_) const
+        {
+            if (pos_ < _fileBase + coldSize())
+            {
+                T item{};
+                coldRead(pos_ - _fileBase, &item, 1);
+                return TimestampOf<T>::get(item);
+            }
+            return Layout::timestamp(chunkAt(pos_)->block, static_cast<size_t>(pos_ & (g_chunkSize - 1)));
+        }
+        // position of first element at or after pos_ with a timestamp of at least ts_
+        // (head if none). As timestamps are monotonic, this is a binary search. Done
+        // separately for disk and memory, as there may be a gap between them. Under
+        // DropOldest, the producer may overwrite the oldest elements while we search,
+        // the caller's validation of what it reads takes care of that. Needs _spillMutex
+        // and _readMutex
+        uint64_t lowerBound(uint64_t pos_, int64_t ts_) const
+        {
+            auto search = [&](uint64_t lo_, uint64_t hi_)
+            {
+                while (lo_ < hi_)
+                {
+                    const auto mid = lo_ + (hi_ - lo_) / 2;
+                    if (timestampAt(mid) < ts_)
+                        lo_ = mid + 1;
+                    else
+                        hi_ = mid;
+                }
+                return lo_;
+            };
+
+            const auto fileEnd = _fileBase + coldSize();
+            if (pos_ < fileEnd)
+            {
+                const auto p = search(std::max(pos_, _fileStart), fileEnd);
+                if (p < fileEnd)
+                    return p;
+                pos_ = fileEnd;
+            }
+            return search(std::max(pos_, _tail.load(std::memory_order_acquire)), _head.load(std::memory_order_acquire));
+        }
+
+        template <typename Container>
+        Container peekRangeImpl(int64_t tStart_, int64_t tEnd_, Container out_) const
+        {
+            // search may touch disk, so always need the spill lock
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            read_lock l(_readMutex);
+            auto first = lowerBound(0, tStart_);
+            const auto last = lowerBound(first, tEnd_);
+
+            out_.resize(availableFrom(first, last));
+            out_.resize(readFrom(first, outPtr(out_), out_.size(), last));
+            return out_;
+        }
+
+        template <typename Container>
+        Container peekPositionsImpl(uint64_t first_, uint64_t last_, Container out_) const
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            read_lock l(_readMutex);
+            out_.resize(availableFrom(first_, last_));
+            out_.resize(readFrom(first_, outPtr(out_), out_.size(), last_));
+            return out_;
+        }
+
+        template <typename Container>
+        Container consumePositionsImpl(uint64_t first_, uint64_t last_, const std::string& reader_, Container out_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            if (it == _readers.end())
+                return out_;
+
+            auto& pos = it->second;
+            pos = std::max(pos, first_);
+            out_.resize(availableFrom(pos, last_));
+            out_.resize(readFrom(pos, outPtr(out_), out_.size(), last_));
+            pos = std::max(pos, std::min(last_, _head.load(std::memory_order_acquire)));
+            releaseConsumed();
+            return out_;
+        }
+
+        template <typename Container>
+        Container consumeUntilImpl(int64_t ts_, const std::string& reader_, Container out_)
+        {
+            std::lock_guard<std::mutex> sl(_spillMutex);
+            write_lock l(_readMutex);
+            const auto it = _readers.find(reader_);
+            if (it == _readers.end())
+                return out_;
+
+            const auto last = lowerBound(it->second, ts_);
+            out_.resize(availableFrom(it->second, last));
+            out_.resize(readFrom(it->second, outPtr(out_), out_.size(), last));
+            releaseConsumed();
+            return out_;
+        }
+
+        // after readers moved: release storage that all readers are past. Memory up to
+        // the slowest reader is returned to the pool, the spill file (or compressed store)
+        // is cleared once all readers are past its end. Needs _spillMutex and exclusive
+        // _readMutex
+        void releaseConsumed()
+        {
+            auto slowest = _head.load(std::memory_order_acquire);
+            for (const auto& r : _readers)
+                slowest = std::min(slowest, r.second);
+
+            auto cur = _tail.load(std::memory_order_relaxed);
+            while (cur < slowest && !_tail.compare_exchange_weak(cur, slowest, std::memory_order_release, std::memory_order_relaxed))
+                ;
+            releaseChunks();
+
+            if (coldSize())
+            {
+                if (slowest >= _fileBase + coldSize())
+                {
+                    _spillFile.clear();
+                    _compressedStore.clear();
+                }
+                else
+                {
+                    _fileStart = std::max(_fileStart, slowest);
+                    // unlike the file, compressed blocks hold memory: release those done with
+                    _compressedStore.release(_fileStart - _fileBase);
+                }
+            }
+        }
+
+        // return all chunks entirely behind the tail to the pool
+        void releaseChunks()
+        {
+            const auto t = _tail.load(std::memory_order_acquire);
+            auto c = _released.load(std::memory_order_acquire);
+            // under DropOldest the producer may claim a chunk too, so CAS
+            while (((c + 1) << g_chunkSizeLog2) <= t)
+            {
+                if (_released.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel))
+                    poolPush(_directory[c++ % g_maxChunks].load(std::memory_order_relaxed));
+            }
+        }
+
+        // producer only: get chunk for storing chunk number chunk_
+        Chunk* acquireChunk(uint64_t chunk_, OverflowPolicy policy_)
+        {
+            auto released = _released.load(std::memory_order_acquire);
+            Chunk* chunk = nullptr;
+            if (policy_ == OverflowPolicy::DropOldest)
+            {
+                // reuse oldest chunk ourselves if it's entirely behind the tail
+                const auto t = _tail.load(std::memory_order_relaxed);
+                if (((released + 1) << g_chunkSizeLog2) <= t &&
+                    _released.compare_exchange_strong(released, released + 1, std::memory_order_acq_rel))
+                    chunk = _directory[released++ % g_maxChunks].load(std::memory_order_relaxed);
+            }
+            if (chunk_ - released >= g_maxChunks)
+            {
+                // directory full (can't happen under the bounded policies)
+                if (chunk)
+                    poolPush(chunk);
+                return nullptr;
+            }
+
+            if (!chunk)
+                chunk = poolPop();
+            if (!chunk)
+            {
+                // pool empty, grow
+                chunk = new Chunk;
+                _nAllocated.fetch_add(1, std::memory_order_relaxed);
+                _chunkAllocations.store(_chunkAllocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            _directory[chunk_ % g_maxChunks].store(chunk, std::memory_order_release);
+            return chunk;
+        }
+
+        // pool of free chunks: lock-free stack. Any thread may push, only the producer
+        // pops (no ABA problem with a single popper). Destructor pops as well, but then
+        // nobody else is running
+        void poolPush(Chunk* chunk_)
+        {
+            chunk_->next = _pool.load(std::memory_order_relaxed);
+            while (!_pool.compare_exchange_weak(chunk_->next, chunk_, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+        Chunk* poolPop()
+        {
+            auto chunk = _pool.load(std::memory_order_acquire);
+            while (chunk && !_pool.compare_exchange_weak(chunk, chunk->next, std::memory_order_acquire, std::memory_order_acquire))
+                ;
+            return chunk;
+        }
+
+        void startSpillThread()
+        {
+            if (_spillThread.joinable())
+                return;
+            _spillStop = false;
+            _spillThread = std::thread(&ChunkedBuffer::spillLoop, this);
+        }
+        void stopSpillThread()
+        {
+            if (!_spillThread.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> l(_spillStopMutex);
+                _spillStop = true;
+            }
+            _spillStopCv.notify_all();
+            _spillThread.join();
+        }
+        void spillLoop()
+        {
+            std::vector<T> temp;
+            std::unique_lock<std::mutex> sl(_spillStopMutex);
+            while (!_spillStopCv.wait_for(sl, g_spillInterval, [this]() { return _spillStop; }))
+            {
+                std::lock_guard<std::mutex> l(_spillMutex);
+                const auto capacity = _capacity.load(std::memory_order_relaxed);
+                if (memSize() < capacity / 4 * 3)
+                    continue;
+                const bool compress = _policy.load(std::memory_order_relaxed) == OverflowPolicy::Compress;
+
+                // copy oldest elements
+                uint64_t first;
+                {
+                    write_lock wl(_readMutex);
+                    const auto t = _tail.load(std::memory_order_acquire);
+                    const auto size = static_cast<size_t>(_head.load(std::memory_order_acquire) - t);
+                    const auto n = size - std::min(size, capacity / 2);
+                    temp.resize(n);
+                    copyOut(t, n, temp.data(), 0);
+                    const auto valid = validate(t, temp.data(), 0, n);
+                    temp.resize(valid.second);
+                    if (!coldSize())
+                        _fileBase = _fileStart = valid.first;
+                    else if (_fileBase + coldSize() != valid.first || (compress ? _spillFile.size() : _compressedStore.size()))
+                    {
+                        // file must be contiguous with memory. There is a gap when elements
+                        // were dropped (policy changed in the meantime): wait until readers
+                        // are done with the file. Same when the policy changed between
+                        // SpillToDisk and Compress, only one tier is used at a time
+                        continue;
+                    }
+                    first = valid.first;
+                }
+                // file I/O or compression outside the read lock. Until stored, the elements
+                // stay in memory (readers are kept out by _spillMutex): if writing the file
+                // fails, nothing is lost, the buffer stays full and the producer drops (and
+                // counts) new elements instead. Next time writing is tried again
+                if (compress)
+                {
+                    _compressedStore.append(temp.data(), temp.size());
+                    _compressed.fetch_add(temp.size(), std::memory_order_relaxed);
+                }
+                else if (_spillFile.append(temp.data(), temp.size()))
+                    _spilled.fetch_add(temp.size(), std::memory_order_relaxed);
+                else
+                    continue;
+
+                // now move them out of memory. Readers behind the new tail will find them
+                // in the file
+                write_lock wl(_readMutex);
+                auto cur = first;
+                const auto newTail = first + temp.size();
+                while (cur < newTail && !_tail.compare_exchange_weak(cur, newTail, std::memory_order_release, std::memory_order_relaxed))
+                    ;
+                releaseChunks();
+            }
+        }
+
+    private:
+        std::unique_ptr<std::atomic<Chunk*>[]> _directory;
+        Chunk*                      _writeChunk = nullptr;  // chunk producer is currently writing to. Producer only
+        std::atomic<Chunk*>         _pool{nullptr};
+        std::atomic<size_t>         _nAllocated{0};     // number of chunks ever allocated
+        std::atomic<OverflowPolicy> _policy{OverflowPolicy::Grow};
+        std::atomic<size_t>         _capacity{0};       // only used by bounded policies
+        alignas(64)
+        std::atomic<uint64_t>       _head{0};           // position of next element to write. Only written by the producer
+        std::atomic<uint64_t>       _peakSize{0};       // statistics, written by the producer (and resetStats())
+        std::atomic<uint64_t>       _chunkAllocations{0};
+        alignas(64)
+        std::atomic<uint64_t>       _tail{0};           // position of first element in memory. Written by readers holding the write lock, and by the producer under DropOldest
+        std::atomic<uint64_t>       _released{0};       // chunks before this chunk number have been returned to the pool
+        std::atomic<uint64_t>       _dropped{0};
+        std::atomic<uint64_t>       _spilled{0};
+        std::atomic<uint64_t>       _compressed{0};
+        mutable mutex_type          _readMutex;
+        std::map<std::string, uint64_t> _readers;       // read position per reader. Guarded by _readMutex
+
+        // spill to disk. Lock order: _spillMutex before _readMutex
+        mutable SpillFile<T>        _spillFile;
+        mutable CompressedStore<T>  _compressedStore;   // instead of the file under Compress
+        mutable std::mutex          _spillMutex;
+        uint64_t                    _fileBase  = 0;     // position of first element in the file. Guarded by _spillMutex
+        uint64_t                    _fileStart = 0;     // position of first element in the file any reader still needs
+        std::thread                 _spillThread;
+        std::mutex                  _spillStopMutex;
+        std::condition_variable     _spillStopCv;
+        bool                        _spillStop = false;
+    };
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    // host clock: std::chrono::steady_clock, in us. On Windows that is
+    // QueryPerformanceCounter, as used by e.g. Psychtoolbox's GetSecs
+    inline int64_t hostTimeNow()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // linear relation between the tracker's clock (sample timestamps) and the host
+    // clock: host = tracker + offset + drift * (tracker - refTracker). The offset
+    // includes the fastest delivery of a sample to the host, as that can't be told apart
+    // from the clock offset
+    struct ClockModel
+    {
+        int64_t refTracker = 0;     // tracker time at which offset holds (us)
+        double  offset     = 0.;    // host - tracker at refTracker (us)
+        double  drift      = 0.;    // host us gained per tracker us (e.g. 1e-6: 1 ppm)
+        uint64_t nWindows  = 0;     // number of windows the model is fit on (0: provisional, from the current window only)
+
+        int64_t toHost(int64_t tracker_) const
+        {
+            const auto dt = static_cast<double>(tracker_ - refTracker);
+            return tracker_ + static_cast<int64_t>(std::llround(offset + drift * dt));
+        }
+        int64_t toTracker(int64_t host_) const
+        {
+            const auto dt = static_cast<double>(host_ - refTracker) - offset;
+            return refTracker + static_cast<int64_t>(std::llround(dt / (1. + drift)));
+        }
+    };
+
+    // Estimates a ClockModel from samples' tracker timestamps and host arrival times.
+    // Arrival is the sample's time in host clock plus a delivery delay that is never
+    // below some minimum but often above it (scheduling, transport), so host - tracker
+    // is noisy upward only. The lower envelope is therefore used: per window of
+    // windowDuration_ us tracker time, the smallest host - tracker, and a robust
+    // (Theil-Sen: median of pairwise slopes) line through those of the last nWindows_
+    // windows. Refitting happens once per window, processing a sample otherwise is a
+    // comparison. Not thread-safe, run from the sample callback
+    class ClockSync
+    {
+    public:
+        explicit ClockSync(int64_t windowDuration_ = 1000000, size_t nWindows_ = 30) :
+            _windowDuration(windowDuration_),
+            _nWindows(std::max<size_t>(nWindows_, 2))
+        {
+            _points.reserve(_nWindows);
+            _slopes.reserve(_nWindows * (_nWindows - 1) / 2);
+            _intercepts.reserve(_nWindows);
+        }
+
+        // returns true if the model changed
+        bool process(int64_t tracker_, int64_t host_)
+        {
+            // tracker clock went back (e.g. it was restarted): start over
+            if (_hasWindow && tracker_ < _windowStart)
+            {
+                _hasWindow = false;
+                _points.clear();
+            }
+            bool changed = false;
+            if (_hasWindow && tracker_ - _windowStart >= _windowDuration)
+            {
+                if (_points.size() == _nWindows)
+                    _points.erase(_points.begin());
+                _points.push_back(_windowMin);
+                fit();
+                _hasWindow = false;
+                changed = true;
+            }
+            const Point p{tracker_, host_ - tracker_};
+            if (!_hasWindow)
+            {
+                _windowStart = tracker_;
+                _windowMin   = p;
+                _hasWindow   = true;
+                // until the first window completes, provisional model from this window
+                if (_points.empty())
+                {
+                    _model = ClockModel{p.tracker, static_cast<double>(p.offset), 0., 0};
+                    changed = true;
+                }
+            }
+            else if (p.offset < _windowMin.offset)
+            {
+                _windowMin = p;
+                if (_points.empty())
+                {
+                    _model = ClockModel{p.tracker, static_cast<double>(p.offset), 0., 0};
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        bool hasModel() const
+        {
+            return _hasWindow || !_points.empty();
+        }
+        const ClockModel& getModel() const
+        {
+            return _model;
+        }
+
+    private:
+        struct Point
+        {
+            int64_t tracker;
+            int64_t offset;     // host - tracker
+        };
+
+        void fit()
+        {
+            // relative to the newest point, keeps the numbers small
+            const auto ref = _points.back();
+            double slope = 0.;
+            if (_points.size() > 1)
+            {
+                _slopes.clear();
+                for (size_t i = 0; i < _points.size(); i++)
+                    for (size_t j = i + 1; j < _points.size(); j++)
+                        if (_points[j].tracker != _points[i].tracker)
+                            _slopes.push_back(static_cast<double>(_points[j].offset - _points[i].offset) / static_cast<double>(_points[j].tracker - _points[i].tracker));
+                slope = median(_slopes);
+            }
+            _intercepts.clear();
+            for (const auto& p : _points)
+                _intercepts.push_back(static_cast<double>(p.offset - ref.offset) - slope * static_cast<double>(p.tracker - ref.tracker));
+            _model = ClockModel{ref.tracker, static_cast<double>(ref.offset) + median(_intercepts), slope, _points.size()};
+        }
+
+        static double median(std::vector<double>& values_)
+        {
+            if (values_.empty())
+                return 0.;
+            const auto mid = values_.begin() + values_.size() / 2;
+            std::nth_element(values_.begin(), mid, values_.end());
+            if (values_.size() % 2)
+                return *mid;
+            return (*mid + *std::max_element(values_.begin(), mid)) / 2.;
+        }
+
+    private:
+        int64_t             _windowDuration;    // us, tracker time
+        size_t              _nWindows;
+
+        bool                _hasWindow = false;
+        int64_t             _windowStart = 0;
+        Point               _windowMin{};       // of the current window
+
+        std::vector<Point>  _points;            // minimum of each completed window, oldest first
+        std::vector<double> _slopes;            // scratch for fit()
+        std::vector<double> _intercepts;
+        ClockModel          _model;
+    };
+}
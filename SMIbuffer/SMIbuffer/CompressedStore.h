@@ -0,0 +1,381 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    // elements are compressed in blocks of this many
+    constexpr size_t g_compressedBlockSize = 1024;
+    // reads covering at least this many whole blocks are decompressed on multiple threads
+    constexpr size_t g_parallelDecodeBlocks = 16;
+
+    // In-memory tier used by the Compress overflow policy to hold the oldest part of a
+    // stream in compressed form. Same interface as SpillFile: elements are appended at
+    // the end and read by index, and the owner clears the store once all readers are
+    // done with it. Additionally, whole blocks all readers are past can be released
+    // early.
+    // Each element is treated as a row of 64-bit words, and each word column of a block
+    // is coded against the element before: as the difference (e.g. counters), the
+    // difference of differences (e.g. timestamps at a fixed sampling rate) or the XOR
+    // (e.g. doubles, whose sign, exponent and leading mantissa bits rarely change),
+    // whichever is smallest for that column in that block. The resulting residuals are
+    // stored without their leading and trailing zero bytes, and runs of zero residuals
+    // (unchanged values, such as the zeros during lost tracking) as a count. Elements
+    // that don't fill a block yet are kept as is.
+    // Compression is lossless, so noise in the data can't be compressed away: timestamps,
+    // constant fields and lost data cost next to nothing, but a noisy full-precision double
+    // still takes 6-7 bytes. For samples that is a ratio of only about 1.35 (see
+    // SMIbuffer_bench), or about 2.3 when the gaze and eye position values have float
+    // precision. Memory use is therefore still roughly proportional to recording length.
+    // Not thread safe except for size() and memoryUsage(), caller (ChunkedBuffer)
+    // serializes access.
+    template <typename T>
+    class CompressedStore
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "CompressedStore needs a trivially copyable type");
+        static constexpr size_t nWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    public:
+        CompressedStore() = default;
+        CompressedStore(const CompressedStore&) = delete;
+        CompressedStore& operator=(const CompressedStore&) = delete;
+
+        // number of elements in the store. Safe to call from any thread
+        size_t size() const
+        {
+            return static_cast<size_t>(_size.load(std::memory_order_acquire));
+        }
+        // bytes used for the stored elements. Safe to call from any thread
+        size_t memoryUsage() const
+        {
+            return _bytes.load(std::memory_order_relaxed);
+        }
+
+        void append(const T* data_, size_t n_)
+        {
+            if (_pending.capacity() < g_compressedBlockSize)
+                _pending.reserve(g_compressedBlockSize);
+            while (n_)
+            {
+                const auto nCopy = std::min(n_, g_compressedBlockSize - _pending.size());
+                _pending.insert(_pending.end(), data_, data_ + nCopy);
+                data_ += nCopy;
+                n_    -= nCopy;
+                if (_pending.size() == g_compressedBlockSize)
+                {
+                    _blocks.emplace_back();
+                    encode(_pending.data(), _pending.size(), _blocks.back());
+                    _blocks.back().shrink_to_fit();
+                    _blockBytes += _blocks.back().size();
+                    _pending.clear();
+                }
+            }
+            _bytes.store(_blockBytes + _pending.size() * sizeof(T), std::memory_order_relaxed);
+            _size.store(_firstBlock * g_compressedBlockSize + _blocks.size() * g_compressedBlockSize + _pending.size(), std::memory_order_release);
+        }
+
+        // read N elements starting at element index_ (or all till the end if less
+        // available). Returns number read. Elements of released blocks can't be read.
+        // Whole blocks are decompressed straight into out_, on multiple threads if there
+        // are enough of them
+        size_t read(uint64_t index_, T* out_, size_t n_)
+        {
+            const auto w = _size.load(std::memory_order_relaxed);
+            if (index_ >= w || index_ < _firstBlock * g_compressedBlockSize)
+                return 0;
+            n_ = static_cast<size_t>(std::min<uint64_t>(n_, w - index_));
+
+            const auto endBlock = _firstBlock + _blocks.size();     // blocks before this are compressed
+            uint64_t firstWhole = 0, nWhole = 0;                    // range of whole blocks in the read
+            size_t   wholeAt    = 0;                                // where the first goes in out_
+            size_t   nRead      = 0;
+            while (nRead < n_)
+            {
+                const auto pos    = index_ + nRead;
+                const auto block  = pos / g_compressedBlockSize;
+                const auto offset = static_cast<size_t>(pos % g_compressedBlockSize);
+                const auto nCopy  = std::min(n_ - nRead, g_compressedBlockSize - offset);
+                if (block >= endBlock)
+                    std::copy_n(_pending.data() + offset, nCopy, out_ + nRead);
+                else if (nCopy == g_compressedBlockSize)
+                {
+                    if (!nWhole++)
+                    {
+                        firstWhole = block;
+                        wholeAt    = nRead;
+                    }
+                }
+                else
+                    std::copy_n(cachedBlock(block) + offset, nCopy, out_ + nRead);
+                nRead += nCopy;
+            }
+
+            if (nWhole)
+                decodeBlocks(firstWhole, static_cast<size_t>(nWhole), out_ + wholeAt);
+            return n_;
+        }
+
+        // release the blocks entirely before element index_
+        void release(uint64_t index_)
+        {
+            while (!_blocks.empty() && (_firstBlock + 1) * g_compressedBlockSize <= index_)
+            {
+                _blockBytes -= _blocks.front().size();
+                _blocks.pop_front();
+                if (_cacheBlock == _firstBlock)
+                    _cacheBlock = UINT64_MAX;
+                _firstBlock++;
+            }
+            _bytes.store(_blockBytes + _pending.size() * sizeof(T), std::memory_order_relaxed);
+        }
+
+        void clear()
+        {
+            _blocks.clear();
+            _pending.clear();
+            _firstBlock = 0;
+            _blockBytes = 0;
+            _cacheBlock = UINT64_MAX;
+            _bytes.store(0, std::memory_order_relaxed);
+            _size.store(0, std::memory_order_release);
+        }
+
+    private:
+        enum class Coding : uint8_t
+        {
+            Xor,
+            Delta,
+            Delta2
+        };
+
+        static uint64_t zigzag(uint64_t d_)
+        {
+            return (d_ << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(d_) >> 63);
+        }
+        static uint64_t unzigzag(uint64_t r_)
+        {
+            return (r_ >> 1) ^ (~(r_ & 1) + 1);
+        }
+        // r_ must not be 0
+        static unsigned leadingZeroBytes(uint64_t r_)
+        {
+            unsigned n = 0;
+            for (; !(r_ >> 56); r_ <<= 8)
+                n++;
+            return n;
+        }
+        static unsigned trailingZeroBytes(uint64_t r_)
+        {
+            unsigned n = 0;
+            for (; !(r_ & 0xff); r_ >>= 8)
+                n++;
+            return n;
+        }
+
+        static uint64_t loadWord(const T& item_, size_t w_)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, reinterpret_cast<const char*>(&item_) + w_ * sizeof(uint64_t), std::min(sizeof(uint64_t), sizeof(T) - w_ * sizeof(uint64_t)));
+            return word;
+        }
+        static void storeWord(T& item_, size_t w_, uint64_t word_)
+        {
+            std::memcpy(reinterpret_cast<char*>(&item_) + w_ * sizeof(uint64_t), &word_, std::min(sizeof(uint64_t), sizeof(T) - w_ * sizeof(uint64_t)));
+        }
+
+        // Residuals are coded as a sequence of tokens. A control byte with the number of
+        // trailing zero bytes in the high nibble and the number of bytes that follow in
+        // the low nibble, then those bytes (little endian). Control byte 0 is a run of
+        // zero residuals, followed by its length - 1 as a varint
+        template <bool Write>
+        static size_t codeResiduals(const uint64_t* r_, size_t n_, std::vector<uint8_t>* out_)
+        {
+            size_t bytes = 0;
+            for (size_t i = 0; i < n_;)
+            {
+                if (!r_[i])
+                {
+                    size_t run = 1;
+                    while (i + run < n_ && !r_[i + run])
+                        run++;
+                    i += run;
+                    uint8_t varint[10];
+                    size_t  nVarint = 0;
+                    for (auto v = run - 1; ; v >>= 7)
+                    {
+                        varint[nVarint++] = static_cast<uint8_t>(v & 0x7f) | (v >= 0x80 ? 0x80 : 0);
+                        if (v < 0x80)
+                            break;
+                    }
+                    bytes += 1 + nVarint;
+                    if constexpr (Write)
+                    {
+                        out_->push_back(0);
+                        out_->insert(out_->end(), varint, varint + nVarint);
+                    }
+                    continue;
+                }
+
+                const auto tz = trailingZeroBytes(r_[i]);
+                const auto nb = 8 - leadingZeroBytes(r_[i]) - tz;
+                bytes += 1 + nb;
+                if constexpr (Write)
+                {
+                    out_->push_back(static_cast<uint8_t>(tz << 4 | nb));
+                    auto v = r_[i] >> (8 * tz);
+                    for (unsigned b = 0; b < nb; b++, v >>= 8)
+                        out_->push_back(static_cast<uint8_t>(v));
+                }
+                i++;
+            }
+            return bytes;
+        }
+
+        void encode(const T* data_, size_t n_, std::vector<uint8_t>& out_)
+        {
+            _column.resize(n_);
+            for (auto& r : _residuals)
+                r.resize(n_);
+            for (size_t w = 0; w < nWords; w++)
+            {
+                for (size_t i = 0; i < n_; i++)
+                    _column[i] = loadWord(data_[i], w);
+
+                uint64_t prev = 0, prevDelta = 0;
+                for (size_t i = 0; i < n_; i++)
+                {
+                    const auto delta = _column[i] - prev;
+                    _residuals[static_cast<size_t>(Coding::Xor)][i]    = _column[i] ^ prev;
+                    _residuals[static_cast<size_t>(Coding::Delta)][i]  = zigzag(delta);
+                    _residuals[static_cast<size_t>(Coding::Delta2)][i] = zigzag(delta - prevDelta);
+                    prev      = _column[i];
+                    prevDelta = delta;
+                }
+
+                size_t best = 0, bestBytes = SIZE_MAX;
+                for (size_t c = 0; c < _residuals.size(); c++)
+                {
+                    const auto bytes = codeResiduals<false>(_residuals[c].data(), n_, nullptr);
+                    if (bytes < bestBytes)
+                    {
+                        best      = c;
+                        bestBytes = bytes;
+                    }
+                }
+                out_.push_back(static_cast<uint8_t>(best));
+                codeResiduals<true>(_residuals[best].data(), n_, &out_);
+            }
+        }
+
+        static void decode(const std::vector<uint8_t>& in_, size_t n_, T* out_)
+        {
+            const uint8_t* p = in_.data();
+            for (size_t w = 0; w < nWords; w++)
+            {
+                const auto coding = static_cast<Coding>(*p++);
+                uint64_t prev = 0, prevDelta = 0;
+                auto next = [&](uint64_t r_)
+                {
+                    switch (coding)
+                    {
+                        case Coding::Xor:
+                            prev ^= r_;
+                            break;
+                        case Coding::Delta:
+                            prev += unzigzag(r_);
+                            break;
+                        case Coding::Delta2:
+                            prevDelta += unzigzag(r_);
+                            prev      += prevDelta;
+                            break;
+                    }
+                    return prev;
+                };
+
+                for (size_t i = 0; i < n_;)
+                {
+                    const auto control = *p++;
+                    if (!control)
+                    {
+                        uint64_t run = 0;
+                        for (unsigned shift = 0; ; shift += 7)
+                        {
+                            const auto b = *p++;
+                            run |= static_cast<uint64_t>(b & 0x7f) << shift;
+                            if (!(b & 0x80))
+                                break;
+                        }
+                        for (auto end = i + static_cast<size_t>(run) + 1; i < end; i++)
+                            storeWord(out_[i], w, next(0));
+                        continue;
+                    }
+
+                    const unsigned nb = control & 0xf, tz = control >> 4;
+                    uint64_t r = 0;
+                    for (unsigned b = 0; b < nb; b++)
+                        r |= static_cast<uint64_t>(*p++) << (8 * b);
+                    storeWord(out_[i++], w, next(r << (8 * tz)));
+                }
+            }
+        }
+
+        // decode whole blocks [first_, first_+n_) into out_. Large reads are split over
+        // threads, each decoding a contiguous range of blocks
+        void decodeBlocks(uint64_t first_, size_t n_, T* out_) const
+        {
+            auto run = [&](size_t from_, size_t to_)
+            {
+                for (auto b = from_; b < to_; b++)
+                    decode(_blocks[static_cast<size_t>(first_ - _firstBlock) + b], g_compressedBlockSize, out_ + b * g_compressedBlockSize);
+            };
+
+            size_t nThreads = 1;
+            if (n_ >= g_parallelDecodeBlocks)
+                nThreads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), n_ / (g_parallelDecodeBlocks / 2));
+            std::vector<std::thread> threads;
+            threads.reserve(nThreads - 1);
+            for (size_t t = 1; t < nThreads; t++)
+                threads.emplace_back(run, n_ * t / nThreads, n_ * (t + 1) / nThreads);
+            run(0, n_ / nThreads);
+            for (auto& t : threads)
+                t.join();
+        }
+
+        // decoded block_, kept so that reads of parts of the same block (e.g. small
+        // consumes, or the binary search of a time range query) decode it only once
+        const T* cachedBlock(uint64_t block_)
+        {
+            if (_cacheBlock != block_)
+            {
+                _cache.resize(g_compressedBlockSize);
+                decode(_blocks[static_cast<size_t>(block_ - _firstBlock)], g_compressedBlockSize, _cache.data());
+                _cacheBlock = block_;
+            }
+            return _cache.data();
+        }
+
+    private:
+        std::deque<std::vector<uint8_t>>    _blocks;            // compressed blocks, oldest first
+        uint64_t                            _firstBlock = 0;    // block number of _blocks.front(), those before were released
+        size_t                              _blockBytes = 0;    // total size of _blocks
+        std::vector<T>                      _pending;           // elements after the last block, not compressed yet
+        std::atomic<uint64_t>               _size{0};           // in elements
+        std::atomic<size_t>                 _bytes{0};
+
+        // scratch for encode()
+        std::vector<uint64_t>                   _column;
+        std::array<std::vector<uint64_t>, 3>    _residuals;     // per Coding
+
+        std::vector<T>                      _cache;
+        uint64_t                            _cacheBlock = UINT64_MAX;
+    };
+}
@@ -0,0 +1,321 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include "iViewXTypes.h"
+
+
+namespace SMIbuff
+{
+    enum class QualityWindowType
+    {
+        Time,       // the samples of the last windowLength ms
+        Count       // the last windowLength samples
+    };
+
+    struct QualitySettings
+    {
+        QualityWindowType windowType = QualityWindowType::Time;
+        double  windowLength    = 500.;     // ms (Time) or samples (Count)
+        double  targetX         = 0.;       // pixels, offset is the mean gaze position relative to this
+        double  targetY         = 0.;       // position, e.g. that of a validation point
+        double  maxSampleRate   = 2000.;    // Hz, bound on the sampling rate that sizes a time window
+                                            // (Time). If samples come faster, the window only holds as
+                                            // many samples as this rate gives
+
+        bool isValid() const
+        {
+            return windowLength >= 1. && (windowType != QualityWindowType::Time || maxSampleRate >= 1.);
+        }
+    };
+
+    // data quality of one eye over the samples in the window, in pixels. Metrics that
+    // have no data to be computed on are NaN
+    struct EyeQuality
+    {
+        uint64_t nSamples   = 0;        // samples in the window
+        uint64_t nLost      = 0;        // of which lost (both gaze coordinates 0)
+        double  dataLoss    = std::numeric_limits<double>::quiet_NaN();     // nLost / nSamples
+        double  rms         = std::numeric_limits<double>::quiet_NaN();     // RMS of the distance between successive samples (pairs without lost data)
+        double  stdev       = std::numeric_limits<double>::quiet_NaN();     // sqrt(var(x) + var(y))
+        double  meanX       = std::numeric_limits<double>::quiet_NaN();
+        double  meanY       = std::numeric_limits<double>::quiet_NaN();
+        double  offsetX     = std::numeric_limits<double>::quiet_NaN();     // mean - target
+        double  offsetY     = std::numeric_limits<double>::quiet_NaN();
+        double  offset      = std::numeric_limits<double>::quiet_NaN();     // distance between mean and target
+    };
+
+    struct QualityMetrics
+    {
+        int64_t     windowStart = 0;    // timestamps of the first and last sample in the window
+        int64_t     windowEnd   = 0;
+        EyeQuality  left;
+        EyeQuality  right;
+    };
+
+    // Data-quality metrics over a sliding window, updated one sample at a time as they
+    // arrive. Each eye keeps running sums over the window, to which an arriving sample
+    // is added and from which one leaving the window is subtracted, so that both
+    // updating and getting the metrics cost the same regardless of the window length.
+    // To keep rounding errors from accumulating, the sums are recomputed from the window
+    // (relative to its mean, which also keeps them small) each time as many samples have
+    // left it as it holds. This is spread over the following samples: each adds a few
+    // window entries to a second set of sums, which replaces the first once it covers
+    // the whole window. The window is allocated up front, so process() does not allocate
+    // and its cost doesn't depend on the window length, it runs on the data source's
+    // thread
+    class QualityMonitor
+    {
+    public:
+        explicit QualityMonitor(const QualitySettings& settings_) :
+            _settings(settings_),
+            _windowDuration(static_cast<int64_t>(settings_.windowLength * 1000.)),   // us
+            _windowCount(static_cast<size_t>(settings_.windowLength))
+        {
+            if (_settings.windowType == QualityWindowType::Count)
+                _window.resize(_windowCount + 1);
+            else
+                _window.resize(static_cast<size_t>(std::ceil(settings_.windowLength * settings_.maxSampleRate / 1000.)) + 1);
+        }
+
+        void process(const SampleStruct& sample_)
+        {
+            // only for time windows and samples faster than maxSampleRate
+            if (_size == _window.size())
+                evict();
+            Entry& entry = _window[(_first + _size) % _window.size()];
+            entry.timestamp = sample_.timestamp;
+            const Entry* prev = _size ? &at(_size - 1) : nullptr;
+            _left.add(entry.left, sample_.leftEye, prev ? &prev->left : nullptr);
+            _right.add(entry.right, sample_.rightEye, prev ? &prev->right : nullptr);
+            _size++;
+
+            if (_settings.windowType == QualityWindowType::Count)
+                while (_size > _windowCount)
+                    evict();
+            else
+                while (at(0).timestamp <= sample_.timestamp - _windowDuration)
+                    evict();
+
+            if (_resyncing)
+                resyncStep();
+            else if (_evicted >= _size)
+                startResync();
+        }
+
+        QualityMetrics getMetrics() const
+        {
+            QualityMetrics metrics;
+            if (_size)
+            {
+                metrics.windowStart = at(0).timestamp;
+                metrics.windowEnd   = at(_size - 1).timestamp;
+            }
+            metrics.left  = _left.get(_settings);
+            metrics.right = _right.get(_settings);
+            return metrics;
+        }
+
+        const QualitySettings& getSettings() const
+        {
+            return _settings;
+        }
+
+    private:
+        struct EyeEntry
+        {
+            double  x = 0., y = 0.;
+            bool    valid = false;
+            bool    hasPair = false;    // valid and so is the preceding sample in the window
+            double  pairDist2 = 0.;     // squared distance to the preceding sample
+        };
+        struct Entry
+        {
+            int64_t  timestamp = 0;
+            EyeEntry left, right;
+        };
+
+        class Eye
+        {
+        public:
+            void add(EyeEntry& entry_, const EyeDataStruct& data_, const EyeEntry* prev_)
+            {
+                entry_.x = data_.gazeX;
+                entry_.y = data_.gazeY;
+                entry_.valid   = data_.gazeX != 0. || data_.gazeY != 0.;
+                entry_.hasPair = entry_.valid && prev_ && prev_->valid;
+                entry_.pairDist2 = entry_.hasPair ? dist2(entry_, *prev_) : 0.;
+                accumulate(entry_, 1);
+            }
+            // entry_ leaves the window. next_ is the sample after it, if included in the
+            // sums: its pair now has a sample outside the window (caller then clears its
+            // hasPair)
+            void remove(const EyeEntry& entry_, const EyeEntry* next_)
+            {
+                accumulate(entry_, -1);
+                if (next_ && next_->hasPair)
+                {
+                    _sumDist2 -= next_->pairDist2;
+                    _nPairs--;
+                }
+            }
+            void reset(double refX_, double refY_)
+            {
+                *this = Eye{};
+                _refX = refX_;
+                _refY = refY_;
+            }
+            void add(const EyeEntry& entry_)
+            {
+                accumulate(entry_, 1);
+            }
+            bool getMean(double& x_, double& y_) const
+            {
+                if (!_nValid)
+                    return false;
+                x_ = _refX + _sumX / _nValid;
+                y_ = _refY + _sumY / _nValid;
+                return true;
+            }
+
+            EyeQuality get(const QualitySettings& settings_) const
+            {
+                EyeQuality q;
+                q.nSamples = _n;
+                q.nLost    = _n - _nValid;
+                if (_n)
+                    q.dataLoss = static_cast<double>(q.nLost) / _n;
+                if (_nPairs)
+                    q.rms = std::sqrt(std::max(_sumDist2, 0.) / _nPairs);
+                if (_nValid)
+                {
+                    const double mx = _sumX / _nValid, my = _sumY / _nValid;
+                    const double var = (_sumXX / _nValid - mx * mx) + (_sumYY / _nValid - my * my);
+                    q.stdev   = std::sqrt(std::max(var, 0.));
+                    q.meanX   = _refX + mx;
+                    q.meanY   = _refY + my;
+                    q.offsetX = q.meanX - settings_.targetX;
+                    q.offsetY = q.meanY - settings_.targetY;
+                    q.offset  = std::hypot(q.offsetX, q.offsetY);
+                }
+                return q;
+            }
+
+        private:
+            static double dist2(const EyeEntry& a_, const EyeEntry& b_)
+            {
+                const double dx = a_.x - b_.x, dy = a_.y - b_.y;
+                return dx * dx + dy * dy;
+            }
+            // sign_: 1 to add, -1 to remove
+            void accumulate(const EyeEntry& entry_, int sign_)
+            {
+                const auto one = static_cast<uint64_t>(sign_);  // wraps around for -1, which is what we want
+                _n += one;
+                if (!entry_.valid)
+                    return;
+                const double x = entry_.x - _refX, y = entry_.y - _refY;
+                _nValid += one;
+                _sumX  += sign_ * x;
+                _sumY  += sign_ * y;
+                _sumXX += sign_ * x * x;
+                _sumYY += sign_ * y * y;
+                if (entry_.hasPair)
+                {
+                    _sumDist2 += sign_ * entry_.pairDist2;
+                    _nPairs   += one;
+                }
+            }
+
+        private:
+            uint64_t _n = 0, _nValid = 0, _nPairs = 0;
+            double   _refX = 0., _refY = 0.;       // sums are of positions relative to this
+            double   _sumX = 0., _sumY = 0., _sumXX = 0., _sumYY = 0., _sumDist2 = 0.;
+        };
+
+        Entry& at(size_t i_)
+        {
+            return _window[(_first + i_) % _window.size()];
+        }
+        const Entry& at(size_t i_) const
+        {
+            return _window[(_first + i_) % _window.size()];
+        }
+
+        void evict()
+        {
+            const Entry& entry = at(0);
+            Entry* next = _size > 1 ? &at(1) : nullptr;
+            _left.remove(entry.left, next ? &next->left : nullptr);
+            _right.remove(entry.right, next ? &next->right : nullptr);
+            if (_nResynced)
+            {
+                // the resync sums include the entry, and the next one only if added already
+                const bool hasNext = next && _nResynced > 1;
+                _resyncLeft.remove(entry.left, hasNext ? &next->left : nullptr);
+                _resyncRight.remove(entry.right, hasNext ? &next->right : nullptr);
+                _nResynced--;
+            }
+            if (next)
+                next->left.hasPair = next->right.hasPair = false;
+            _first = (_first + 1) % _window.size();
+            _size--;
+            _evicted++;
+        }
+
+        // start summing the window anew, relative to its current mean. The resync sums
+        // cover the first _nResynced entries of the window
+        void startResync()
+        {
+            double refX = 0., refY = 0.;
+            _left.getMean(refX, refY);
+            _resyncLeft.reset(refX, refY);
+            refX = refY = 0.;
+            _right.getMean(refX, refY);
+            _resyncRight.reset(refX, refY);
+            _nResynced = 0;
+            _resyncing = true;
+            resyncStep();
+        }
+        // add the next few entries, more than arrive per sample, so it catches up
+        void resyncStep()
+        {
+            for (size_t i = 0; i < nResyncPerSample && _nResynced < _size; i++, _nResynced++)
+            {
+                _resyncLeft.add(at(_nResynced).left);
+                _resyncRight.add(at(_nResynced).right);
+            }
+            if (_nResynced < _size)
+                return;
+            _left  = _resyncLeft;
+            _right = _resyncRight;
+            _nResynced = 0;
+            _resyncing = false;
+            _evicted = 0;
+        }
+
+    private:
+        QualitySettings     _settings;
+        int64_t             _windowDuration;    // us (Time)
+        size_t              _windowCount;       // (Count)
+
+        std::vector<Entry>  _window;            // ring buffer of the samples in the window
+        size_t              _first = 0;
+        size_t              _size = 0;
+        size_t              _evicted = 0;       // since the last resync
+
+        Eye                 _left;
+        Eye                 _right;
+
+        // resync in progress
+        static constexpr size_t nResyncPerSample = 4;    // window entries added per sample
+        bool                _resyncing = false;
+        size_t              _nResynced = 0;
+        Eye                 _resyncLeft;
+        Eye                 _resyncRight;
+    };
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "iViewXTypes.h"
+
+
+namespace SMIbuff
+{
+    constexpr int g_sourceSuccess = 1;      // same as the iViewX SDK's RET_SUCCESS
+
+    // Where SMIbuffer gets its samples and events from. SMIbuffer sets a callback per
+    // stream when buffering starts, and removes it (empty function) when buffering
+    // stops. Callbacks are called from the source's thread, once a set call returns the
+    // previous callback is no longer called. Set functions return an iViewX SDK return
+    // code (g_sourceSuccess on success)
+    class DataSource
+    {
+    public:
+        using SampleCallback = std::function<void(const SampleStruct&)>;
+        using EventCallback  = std::function<void(const EventStruct&)>;
+
+        virtual ~DataSource() = default;
+
+        virtual int setSampleCallback(SampleCallback callback_) = 0;
+        virtual int setEventCallback (EventCallback  callback_) = 0;
+    };
+
+#ifndef SMIBUFFER_NO_IVIEWX
+    // data from the iViewX SDK. The SDK only has one set of callbacks, so all instances
+    // share them
+    class IViewXSource : public DataSource
+    {
+    public:
+        int setSampleCallback(SampleCallback callback_) override;
+        int setEventCallback (EventCallback  callback_) override;
+    };
+#endif
+
+    // iViewX SDK source, or none (nullptr) when building without the SDK
+    std::shared_ptr<DataSource> defaultDataSource();
+
+
+    // Base for sources that generate data on a thread of their own, which runs while a
+    // callback is set. The thread calls produce() about every millisecond with the time
+    // the thread has been running (pauses while no callback is set don't count), which
+    // emits everything that is due by then. Derived classes must call stopThread() in
+    // their destructor. Don't set callbacks from within a callback
+    class ThreadedSource : public DataSource
+    {
+    public:
+        ~ThreadedSource() override;
+
+        int setSampleCallback(SampleCallback callback_) override;
+        int setEventCallback (EventCallback  callback_) override;
+
+        // true once produce() indicated there is no more data
+        bool finished() const
+        {
+            return _finished.load(std::memory_order_acquire);
+        }
+
+    protected:
+        // return false when there is nothing more to produce
+        virtual bool produce(std::chrono::duration<double> elapsed_) = 0;
+
+        void emitSample(const SampleStruct& sample_)
+        {
+            if (_sampleCallback)
+                _sampleCallback(sample_);
+        }
+        void emitEvent(const EventStruct& event_)
+        {
+            if (_eventCallback)
+                _eventCallback(event_);
+        }
+
+        void stopThread();
+
+    private:
+        void updateThread();    // start or stop thread depending on whether callbacks are set
+        void run();
+
+    private:
+        std::mutex                  _mutex;     // held while producing, so that callbacks don't change halfway
+        SampleCallback              _sampleCallback;
+        EventCallback               _eventCallback;
+        std::thread                 _thread;
+        std::atomic<bool>           _stop{false};
+        std::atomic<bool>           _finished{false};
+        std::chrono::duration<double> _elapsed{0};  // running time before the current run of the thread
+    };
+
+    // Replays recorded samples and events (e.g. from SMIbuff::readLog), at their
+    // original rate times speed_ (0: as fast as possible). Timestamps are taken to be in
+    // microseconds, as the SDK's. Events are emitted when they end, as the SDK does.
+    // When looping, timestamps keep increasing over repetitions. NB: playback starts as
+    // soon as the first stream is buffered, so at speed 0 the other stream may miss data
+    class ReplaySource : public ThreadedSource
+    {
+    public:
+        ReplaySource(std::vector<SampleStruct> samples_, std::vector<EventStruct> events_, double speed_ = 1., bool loop_ = false);
+        ~ReplaySource() override;
+
+    protected:
+        bool produce(std::chrono::duration<double> elapsed_) override;
+
+    private:
+        std::vector<SampleStruct>   _samples;
+        std::vector<EventStruct>    _events;
+        double                      _speed;
+        bool                        _loop;
+
+        long long                   _t0 = 0;        // first timestamp in the recording
+        long long                   _period = 0;    // duration of one repetition, for looping
+        long long                   _offset = 0;    // added to timestamps, increases each repetition
+        size_t                      _iSample = 0;
+        size_t                      _iEvent = 0;
+    };
+
+    // Generates plausible binocular data at a fixed rate: fixations at random positions
+    // on a 1920x1080 screen with a little noise, connected by saccades, and a fixation
+    // event per eye at the end of each fixation. Timestamps in microseconds, starting
+    // at 0. Runs until destroyed
+    class SyntheticSource : public ThreadedSource
+    {
+    public:
+        SyntheticSource(double sampleRate_ = 1000., uint32_t seed_ = 0);
+        ~SyntheticSource() override;
+
+    protected:
+        bool produce(std::chrono::duration<double> elapsed_) override;
+
+    private:
+        void nextFixation();
+
+    private:
+        double                      _sampleRate;
+        std::mt19937                _rng;
+        uint64_t                    _iSample = 0;
+
+        // current fixation and the saccade to it
+        double                      _fromX = 960., _fromY = 540.;
+        double                      _x = 960., _y = 540.;
+        long long                   _saccadeStart = 0;
+        long long                   _fixStart = 0;
+        long long                   _fixEnd = 0;
+    };
+}
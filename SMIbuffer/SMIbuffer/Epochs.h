@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    constexpr uint64_t g_epochOpen = UINT64_MAX;    // end position of the epoch still being recorded
+    constexpr size_t   g_noEpoch   = static_cast<size_t>(-1);
+
+    // an epoch (e.g. a trial) is the data that arrived between markEpoch and the next
+    // markEpoch or endEpoch call. Its samples and events are identified by their
+    // positions in the buffers (see ChunkedBuffer::writePosition), so retrieving them
+    // needs no search
+    struct Epoch
+    {
+        std::string label;
+        int64_t     trackerTime = 0;    // timestamp of the latest sample when the epoch was marked (0 if there was none)
+        int64_t     hostTime    = 0;    // std::chrono::steady_clock when the epoch was marked (us)
+        uint64_t    sampleStart = 0;    // positions [start, end) in the sample/event buffer
+        uint64_t    sampleEnd   = g_epochOpen;
+        uint64_t    eventStart  = 0;
+        uint64_t    eventEnd    = g_epochOpen;
+
+        bool isOpen() const
+        {
+            return sampleEnd == g_epochOpen;
+        }
+    };
+
+    // list of epochs, findable by index (order of marking) and by label (the last epoch
+    // with that label). Not thread-safe
+    class EpochIndex
+    {
+    public:
+        // starts a new epoch, ending the current one. Returns its index
+        size_t mark(Epoch epoch_)
+        {
+            end(epoch_.sampleStart, epoch_.eventStart);
+            _epochs.push_back(std::move(epoch_));
+            _labels[_epochs.back().label] = _epochs.size() - 1;
+            return _epochs.size() - 1;
+        }
+        // ends the current epoch, if any
+        void end(uint64_t samplePos_, uint64_t eventPos_)
+        {
+            if (_epochs.empty() || !_epochs.back().isOpen())
+                return;
+            _epochs.back().sampleEnd = samplePos_;
+            _epochs.back().eventEnd  = eventPos_;
+        }
+        // sample storage was recreated, positions start again from 0: the samples of the
+        // epochs so far are gone
+        void resetSamplePositions()
+        {
+            for (auto& epoch : _epochs)
+            {
+                epoch.sampleStart = 0;
+                if (!epoch.isOpen())
+                    epoch.sampleEnd = 0;
+            }
+        }
+
+        // g_noEpoch if there is no epoch with that label
+        size_t find(const std::string& label_) const
+        {
+            const auto it = _labels.find(label_);
+            return it == _labels.end() ? g_noEpoch : it->second;
+        }
+        // nullptr if index_ is out of range
+        const Epoch* get(size_t index_) const
+        {
+            return index_ < _epochs.size() ? &_epochs[index_] : nullptr;
+        }
+        const std::vector<Epoch>& getAll() const
+        {
+            return _epochs;
+        }
+        void clear()
+        {
+            _epochs.clear();
+            _labels.clear();
+        }
+
+    private:
+        std::vector<Epoch>                      _epochs;
+        std::unordered_map<std::string, size_t> _labels;
+    };
+}
@@ -0,0 +1,393 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "iViewXTypes.h"
+
+#include "SampleProfiles.h"
+
+
+namespace SMIbuff
+{
+    // online event detection algorithm
+    enum class DetectionAlgorithm
+    {
+        Velocity,       // I-VT: samples faster than velocityThreshold are saccade samples
+        Dispersion      // I-DT: windows of at least minFixationDuration whose dispersion stays
+                        // within dispersionThreshold are fixations, what's in between saccades
+    };
+
+    struct DetectorSettings
+    {
+        DetectionAlgorithm algorithm        = DetectionAlgorithm::Velocity;
+        SampleEyes  eyes                    = SampleEyes::Binocular;    // each eye is detected on separately
+        double      pixelsPerDegree         = 40.;      // gaze is in pixels, thresholds are in degrees
+        double      velocityThreshold       = 30.;      // deg/s (Velocity)
+        size_t      velocityWindow          = 4;        // samples (Velocity), velocity is the displacement over this many
+                                                        // sample intervals, so that noise doesn't cross the threshold.
+                                                        // At most g_maxVelocityWindow
+        double      dispersionThreshold     = 1.;       // deg, horizontal + vertical extent (Dispersion)
+        double      minFixationDuration     = 60.;      // ms, shorter fixations are discarded
+        double      minSaccadeDuration      = 10.;      // ms, shorter saccades are merged into the surrounding fixation (Velocity)
+    };
+
+    constexpr size_t g_maxVelocityWindow = 16;
+
+    // event types produced by EventDetector
+    constexpr char g_fixationEvent = 'F';
+    constexpr char g_saccadeEvent  = 'S';
+
+    // Incremental fixation and saccade detection, fed one sample at a time as they arrive
+    // (state is carried over between calls). Produces EventStructs with eventType
+    // g_fixationEvent or g_saccadeEvent and eye 'l' or 'r', with the fixation's mean
+    // position or the saccade's end position, and times in the samples' clock.
+    // Fixations are reported once they have ended. A saccade is reported twice: at the
+    // sample where its onset is detected, with endTime and duration 0, and again in full
+    // once it has ended. An onset that turns out to be too short to be a saccade is not
+    // followed by a full saccade.
+    // Samples with both gaze coordinates 0 are lost data: they end the current event.
+    class EventDetector
+    {
+    public:
+        explicit EventDetector(const DetectorSettings& settings_) :
+            _settings(settings_),
+            _left('l', settings_),
+            _right('r', settings_)
+        {}
+
+        // emit_ is called with each produced event
+        template <typename F>
+        void process(const SampleStruct& sample_, F&& emit_)
+        {
+            if (_settings.eyes != SampleEyes::Right)
+                _left.process(sample_.timestamp, sample_.leftEye, emit_);
+            if (_settings.eyes != SampleEyes::Left)
+                _right.process(sample_.timestamp, sample_.rightEye, emit_);
+        }
+        // end ongoing events, e.g. when detection stops. Reports them if they qualify
+        template <typename F>
+        void finish(F&& emit_)
+        {
+            _left.finish(emit_);
+            _right.finish(emit_);
+        }
+
+        const DetectorSettings& getSettings() const
+        {
+            return _settings;
+        }
+
+    private:
+        class Eye
+        {
+        public:
+            Eye(char eye_, const DetectorSettings& settings_) :
+                _eye(eye_),
+                _algorithm(settings_.algorithm),
+                _velocityThreshold(settings_.velocityThreshold * settings_.pixelsPerDegree / 1e6),      // px/us
+                _velocityWindow(std::clamp<size_t>(settings_.velocityWindow, 1, g_maxVelocityWindow)),
+                _dispersionThreshold(settings_.dispersionThreshold * settings_.pixelsPerDegree),        // px
+                _minFixation(static_cast<int64_t>(settings_.minFixationDuration * 1000.)),              // us
+                _minSaccade(static_cast<int64_t>(settings_.minSaccadeDuration * 1000.))
+            {}
+
+            template <typename F>
+            void process(int64_t ts_, const EyeDataStruct& eye_, F& emit_)
+            {
+                if (eye_.gazeX == 0. && eye_.gazeY == 0.)
+                {
+                    finish(emit_);
+                    return;
+                }
+                if (_hasLast && ts_ <= _lastTs)
+                    return;     // out of order or duplicate
+
+                if (_algorithm == DetectionAlgorithm::Velocity)
+                    processVelocity(ts_, eye_.gazeX, eye_.gazeY, emit_);
+                else
+                    processDispersion(ts_, eye_.gazeX, eye_.gazeY, emit_);
+                _hasLast = true;
+                _lastTs  = ts_;
+                _recent[_nRecent++ % g_maxVelocityWindow] = {ts_, eye_.gazeX, eye_.gazeY};
+            }
+
+            template <typename F>
+            void finish(F& emit_)
+            {
+                // a Velocity saccade that isn't confirmed yet is part of the fixation. Under
+                // Dispersion, the end of an ongoing saccade is unknown
+                if (_inSaccade && _confirmed)
+                    emitSaccade(emit_);
+                else if (_inSaccade && _algorithm == DetectionAlgorithm::Velocity)
+                    mergeSaccade();
+                if (_inFixation)
+                    emitFixation(emit_, _fixEnd - _fixStart >= _minFixation);
+
+                _hasLast = _inFixation = _inSaccade = _confirmed = false;
+                _nRecent = 0;
+                _window.clear();
+                _windowStart = 0;
+            }
+
+        private:
+            // I-VT: label each sample by its velocity, taken over the last _velocityWindow
+            // samples (fewer right after the start or lost data). Point-to-point velocity
+            // of fixational noise alone regularly exceeds common thresholds
+            template <typename F>
+            void processVelocity(int64_t ts_, double x_, double y_, F& emit_)
+            {
+                if (!_hasLast)
+                {
+                    startFixation(ts_, x_, y_);
+                    return;
+                }
+
+                const auto& from = _recent[(_nRecent - std::min(_nRecent, _velocityWindow)) % g_maxVelocityWindow];
+                const auto velocity = std::hypot(x_ - from.x, y_ - from.y) / static_cast<double>(ts_ - from.ts);
+                if (velocity > _velocityThreshold)
+                {
+                    if (!_inSaccade)
+                        startSaccade(ts_, x_, y_, emit_);
+                    else
+                        extendSaccade(ts_, x_, y_);
+                    // long enough: the fixation before it is over
+                    if (!_confirmed && _sacEnd - _sacStart >= _minSaccade)
+                    {
+                        _confirmed = true;
+                        if (_inFixation)
+                            emitFixation(emit_, _fixEnd - _fixStart >= _minFixation);
+                    }
+                    return;
+                }
+
+                if (_inSaccade)
+                {
+                    if (_confirmed)
+                    {
+                        emitSaccade(emit_);
+                        startFixation(ts_, x_, y_);
+                        return;
+                    }
+                    mergeSaccade();
+                }
+                if (!_inFixation)
+                    startFixation(ts_, x_, y_);
+                else
+                    extendFixation(ts_, x_, y_);
+            }
+
+            // I-DT: fixation while the dispersion of the samples stays within threshold
+            template <typename F>
+            void processDispersion(int64_t ts_, double x_, double y_, F& emit_)
+            {
+                if (_inFixation)
+                {
+                    const auto dispersion = (std::max(_maxX, x_) - std::min(_minX, x_)) + (std::max(_maxY, y_) - std::min(_minY, y_));
+                    if (dispersion <= _dispersionThreshold)
+                    {
+                        extendFixation(ts_, x_, y_);
+                        return;
+                    }
+                    // fixation over, this sample is the onset of a saccade
+                    emitFixation(emit_, true);
+                    startSaccade(ts_, x_, y_, emit_);
+                }
+                else if (_inSaccade)
+                    extendSaccade(ts_, x_, y_);
+
+                // look for a window of minimum fixation duration with low enough dispersion
+                _window.push_back({ts_, x_, y_});
+                while (_window.back().ts - _window[_windowStart].ts >= _minFixation)
+                {
+                    double minX = x_, maxX = x_, minY = y_, maxY = y_;
+                    for (auto i = _windowStart; i < _window.size(); i++)
+                    {
+                        minX = std::min(minX, _window[i].x);
+                        maxX = std::max(maxX, _window[i].x);
+                        minY = std::min(minY, _window[i].y);
+                        maxY = std::max(maxY, _window[i].y);
+                    }
+                    if ((maxX - minX) + (maxY - minY) <= _dispersionThreshold)
+                    {
+                        // the saccade (if any) lasted till the sample before the window
+                        if (_inSaccade)
+                        {
+                            if (_windowStart)
+                            {
+                                _sacEnd  = _window[_windowStart - 1].ts;
+                                _sacEndX = _window[_windowStart - 1].x;
+                                _sacEndY = _window[_windowStart - 1].y;
+                                emitSaccade(emit_);
+                            }
+                            _inSaccade = false;
+                        }
+                        const auto& first = _window[_windowStart];
+                        startFixation(first.ts, first.x, first.y);
+                        for (auto i = _windowStart + 1; i < _window.size(); i++)
+                            extendFixation(_window[i].ts, _window[i].x, _window[i].y);
+                        _window.clear();
+                        _windowStart = 0;
+                        return;
+                    }
+                    // first sample of the window isn't part of a fixation
+                    if (++_windowStart > _window.size() / 2)
+                    {
+                        _window.erase(_window.begin(), _window.begin() + _windowStart);
+                        _windowStart = 0;
+                    }
+                }
+            }
+
+            void startFixation(int64_t ts_, double x_, double y_)
+            {
+                _inFixation = true;
+                _fixStart = _fixEnd = ts_;
+                _sumX = x_;
+                _sumY = y_;
+                _n = 1;
+                _minX = _maxX = x_;
+                _minY = _maxY = y_;
+            }
+            void extendFixation(int64_t ts_, double x_, double y_)
+            {
+                _fixEnd = ts_;
+                _sumX += x_;
+                _sumY += y_;
+                _n++;
+                _minX = std::min(_minX, x_);
+                _maxX = std::max(_maxX, x_);
+                _minY = std::min(_minY, y_);
+                _maxY = std::max(_maxY, y_);
+            }
+            template <typename F>
+            void emitFixation(F& emit_, bool qualifies_)
+            {
+                _inFixation = false;
+                if (!qualifies_)
+                    return;
+                EventStruct event{};
+                event.eventType = g_fixationEvent;
+                event.eye       = _eye;
+                event.startTime = _fixStart;
+                event.endTime   = _fixEnd;
+                event.duration  = _fixEnd - _fixStart;
+                event.positionX = _sumX / static_cast<double>(_n);
+                event.positionY = _sumY / static_cast<double>(_n);
+                emit_(event);
+            }
+
+            template <typename F>
+            void startSaccade(int64_t ts_, double x_, double y_, F& emit_)
+            {
+                _inSaccade = true;
+                _confirmed = false;
+                _sacStart = _sacEnd = ts_;
+                _sacEndX = x_;
+                _sacEndY = y_;
+                _sacSumX = x_;
+                _sacSumY = y_;
+                _sacN = 1;
+
+                // onset
+                EventStruct event{};
+                event.eventType = g_saccadeEvent;
+                event.eye       = _eye;
+                event.startTime = ts_;
+                event.positionX = x_;
+                event.positionY = y_;
+                emit_(event);
+            }
+            void extendSaccade(int64_t ts_, double x_, double y_)
+            {
+                _sacEnd  = ts_;
+                _sacEndX = x_;
+                _sacEndY = y_;
+                _sacSumX += x_;
+                _sacSumY += y_;
+                _sacN++;
+            }
+            template <typename F>
+            void emitSaccade(F& emit_)
+            {
+                _inSaccade = false;
+                EventStruct event{};
+                event.eventType = g_saccadeEvent;
+                event.eye       = _eye;
+                event.startTime = _sacStart;
+                event.endTime   = _sacEnd;
+                event.duration  = _sacEnd - _sacStart;
+                event.positionX = _sacEndX;
+                event.positionY = _sacEndY;
+                emit_(event);
+            }
+            // saccade too short: its samples become part of the fixation
+            void mergeSaccade()
+            {
+                _inSaccade = false;
+                if (!_inFixation)
+                {
+                    _inFixation = true;
+                    _fixStart = _sacStart;
+                    _sumX = _sumY = 0.;
+                    _n = 0;
+                }
+                _fixEnd = _sacEnd;
+                _sumX += _sacSumX;
+                _sumY += _sacSumY;
+                _n    += _sacN;
+            }
+
+        private:
+            struct Point
+            {
+                int64_t ts;
+                double  x;
+                double  y;
+            };
+
+            const char                  _eye;
+            const DetectionAlgorithm    _algorithm;
+            const double                _velocityThreshold;
+            const size_t                _velocityWindow;
+            const double                _dispersionThreshold;
+            const int64_t               _minFixation;
+            const int64_t               _minSaccade;
+
+            // previous sample, and the last g_maxVelocityWindow samples (ring, _nRecent
+            // counts samples since the last finish)
+            bool                        _hasLast = false;
+            int64_t                     _lastTs  = 0;
+            Point                       _recent[g_maxVelocityWindow];
+            size_t                      _nRecent = 0;
+
+            // current fixation
+            bool                        _inFixation = false;
+            int64_t                     _fixStart = 0;
+            int64_t                     _fixEnd   = 0;
+            double                      _sumX = 0., _sumY = 0.;
+            size_t                      _n = 0;
+            double                      _minX = 0., _maxX = 0., _minY = 0., _maxY = 0.;
+
+            // current saccade. Under Velocity, not confirmed until it lasted minSaccadeDuration
+            bool                        _inSaccade = false;
+            bool                        _confirmed = false;
+            int64_t                     _sacStart = 0;
+            int64_t                     _sacEnd   = 0;
+            double                      _sacEndX = 0., _sacEndY = 0.;
+            double                      _sacSumX = 0., _sacSumY = 0.;
+            size_t                      _sacN = 0;
+
+            // Dispersion: samples since the last fixation, from _windowStart (storage is
+            // reused, so no allocations once it has grown to a window's worth)
+            std::vector<Point>          _window;
+            size_t                      _windowStart = 0;
+        };
+
+    private:
+        DetectorSettings    _settings;
+        Eye                 _left;
+        Eye                 _right;
+    };
+}
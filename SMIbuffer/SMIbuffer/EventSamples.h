@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    // positions [first, end) in the sample buffer (see ChunkedBuffer::writePosition)
+    struct SampleRange
+    {
+        uint64_t first = 0;
+        uint64_t end   = 0;
+    };
+
+    // Cross-index from events to the samples they cover, those with startTime <=
+    // timestamp <= endTime. Events are identified by their position in the event buffer,
+    // and get their sample range in order of arrival: the owner looks up the range of
+    // each new event once (a binary search over the sample timestamps) as soon as all
+    // its samples have arrived, and adds it here. Getting an event's samples then takes
+    // no search, they are read by position. Not thread-safe
+    class EventSampleIndex
+    {
+    public:
+        // position of the first event without a range yet
+        uint64_t nextEvent() const
+        {
+            return _base + _ranges.size();
+        }
+        // add the range of event nextEvent(), or of a later one if the events in between
+        // are no longer stored (they then get empty ranges)
+        void add(uint64_t eventPos_, SampleRange range_)
+        {
+            if (_ranges.empty() && eventPos_ > _base)
+                _base = eventPos_;
+            while (nextEvent() < eventPos_)
+                _ranges.push_back(SampleRange{range_.first, range_.first});
+            _ranges.push_back(range_);
+        }
+        // false if the event has no range (yet)
+        bool find(uint64_t eventPos_, SampleRange& range_) const
+        {
+            if (eventPos_ < _base || eventPos_ >= nextEvent())
+                return false;
+            range_ = _ranges[static_cast<size_t>(eventPos_ - _base)];
+            return true;
+        }
+        // drop the ranges of events before eventPos_, e.g. once they are no longer stored
+        void discardUntil(uint64_t eventPos_)
+        {
+            if (eventPos_ <= _base)
+                return;
+            const auto n = static_cast<size_t>(std::min<uint64_t>(eventPos_ - _base, _ranges.size()));
+            _ranges.erase(_ranges.begin(), _ranges.begin() + n);
+            _base += n;
+            if (_ranges.empty())
+                _base = eventPos_;
+        }
+        // sample storage was recreated, positions start again from 0: the samples of the
+        // events so far are gone
+        void resetSamplePositions()
+        {
+            for (auto& range : _ranges)
+                range = SampleRange{};
+        }
+        void clear()
+        {
+            _ranges.clear();
+            _base = 0;
+        }
+
+    private:
+        uint64_t                 _base = 0;     // event position of _ranges[0]
+        std::vector<SampleRange> _ranges;
+    };
+}
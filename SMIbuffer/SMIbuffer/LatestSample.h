@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace SMIbuff
+{
+    // Holds the most recent item written, for a single writer and any number of
+    // readers, using a seqlock: the writer never waits, a reader retries only if the
+    // writer was busy with the slot during its copy. The item is stored as atomic words
+    // so that racing copies are well-defined; the relaxed loads and stores compile to
+    // plain moves. No allocation, no locks, a read costs a copy of the item
+    template <typename T>
+    class LatestSlot
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "LatestSlot needs a trivially copyable type");
+        static constexpr size_t nWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    public:
+        void store(const T& item_)
+        {
+            std::array<uint64_t, nWords> words{};
+            std::memcpy(words.data(), &item_, sizeof(T));
+
+            const auto seq = _seq.load(std::memory_order_relaxed);
+            _seq.store(seq + 1, std::memory_order_relaxed);     // odd: write in progress
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < nWords; i++)
+                _words[i].store(words[i], std::memory_order_relaxed);
+            _seq.store(seq + 2, std::memory_order_release);
+        }
+        // returns false if nothing was stored yet
+        bool load(T& out_) const
+        {
+            std::array<uint64_t, nWords> words;
+            uint64_t seq;
+            for (;;)
+            {
+                seq = _seq.load(std::memory_order_acquire);
+                if (seq & 1)
+                    continue;
+                for (size_t i = 0; i < nWords; i++)
+                    words[i] = _words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_seq.load(std::memory_order_relaxed) == seq)
+                    break;
+            }
+            if (!seq)
+                return false;
+            std::memcpy(static_cast<void*>(&out_), words.data(), sizeof(T));   // T may have default member initializers
+            return true;
+        }
+
+    private:
+        alignas(64) std::atomic<uint64_t>           _seq{0};    // number of stores times two, odd during a store
+        std::array<std::atomic<uint64_t>, nWords>   _words{};
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    // Lets threads wait for a condition on data that a producer thread (a data source
+    // callback) changes, without polling. The producer calls notify() after each change,
+    // which bumps a generation counter. That costs an atomic increment and a load as long
+    // as nobody waits. Waiters evaluate their condition without holding the mutex, and
+    // only wait on it for the generation to change, so the producer never waits for a
+    // waiter's condition (which may take reader locks on a buffer) to be evaluated
+    class Notifier
+    {
+    public:
+        void notify()
+        {
+            // pairs with the registration in waitFor: either we see the waiter, or the
+            // waiter sees the new generation
+            _generation.fetch_add(1, std::memory_order_seq_cst);
+            if (!_waiters.load(std::memory_order_seq_cst))
+                return;
+            {
+                // waiter is either before checking the generation or waiting, not in between.
+                // Only held by a waiter for that check, so this doesn't block for long
+                std::lock_guard<std::mutex> l(_mutex);
+            }
+            _condition.notify_all();
+        }
+        // wait until pred_() is true, or the timeout expires. Returns the last result
+        // of pred_(), which is called without the notifier's mutex held
+        template <typename Rep, typename Period, typename Pred>
+        bool waitFor(const std::chrono::duration<Rep, Period>& timeout_, Pred&& pred_)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout_;
+            _waiters.fetch_add(1, std::memory_order_seq_cst);
+            bool result;
+            while (true)
+            {
+                // generation before checking, so that a change made after the check is seen
+                const auto generation = _generation.load(std::memory_order_seq_cst);
+                result = pred_();
+                if (result)
+                    break;
+                bool changed;
+                {
+                    std::unique_lock<std::mutex> l(_mutex);
+                    changed = _condition.wait_until(l, deadline, [&]() { return _generation.load(std::memory_order_seq_cst) != generation; });
+                }
+                if (!changed)
+                {
+                    result = pred_();
+                    break;
+                }
+            }
+            _waiters.fetch_sub(1, std::memory_order_relaxed);
+            return result;
+        }
+
+    private:
+        std::atomic<uint64_t>   _generation{0};
+        std::atomic<unsigned>   _waiters{0};
+        std::mutex              _mutex;
+        std::condition_variable _condition;
+    };
+}
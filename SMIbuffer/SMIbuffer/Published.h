@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+
+namespace SMIbuff
+{
+    // Lets objects that a data source callback uses be replaced while the callback keeps
+    // running, so that it never has to be unregistered (which would lose the data that
+    // arrives meanwhile). The callback brackets its work with enter() and leave(), and
+    // gets the objects from Published pointers. After swapping such a pointer, another
+    // thread calls waitForQuiescence(): once that returns, the callback is done with the
+    // old object, which can then be finished and deleted. Costs the callback two atomic
+    // increments, and never makes it wait
+    class CallbackQuiescence
+    {
+    public:
+        void enter()
+        {
+            // pairs with waitForQuiescence: the pointers read after this are either the
+            // new ones, or the swapping thread sees us inside
+            _seq.fetch_add(1, std::memory_order_seq_cst);
+        }
+        void leave()
+        {
+            _seq.fetch_add(1, std::memory_order_release);
+        }
+        // call after swapping pointers, not from within the callback
+        void waitForQuiescence() const
+        {
+            const auto seq = _seq.load(std::memory_order_seq_cst);
+            if (!(seq & 1))
+                return;
+            // callback is running, and may have read the old pointers. It is short, so spin
+            while (_seq.load(std::memory_order_acquire) == seq)
+                std::this_thread::yield();
+        }
+
+    private:
+        std::atomic<uint64_t> _seq{0};  // number of enters and leaves, odd while the callback runs
+    };
+
+    // Owner of an object used by a callback (see CallbackQuiescence). get() is what the
+    // callback uses, the other functions are for the thread that (re)places the object
+    template <typename T>
+    class Published
+    {
+    public:
+        Published() = default;
+        ~Published()
+        {
+            delete _ptr.load(std::memory_order_relaxed);
+        }
+        Published(const Published&) = delete;
+        Published& operator=(const Published&) = delete;
+
+        T* get() const
+        {
+            return _ptr.load(std::memory_order_seq_cst);
+        }
+        explicit operator bool() const
+        {
+            return get() != nullptr;
+        }
+        // publish new_ (may be null). Returns the old object, which the callback may
+        // still be using until quiescence
+        std::unique_ptr<T> exchange(std::unique_ptr<T> new_)
+        {
+            return std::unique_ptr<T>(_ptr.exchange(new_.release(), std::memory_order_seq_cst));
+        }
+
+    private:
+        std::atomic<T*> _ptr{nullptr};
+    };
+}
@@ -1,23 +1,95 @@
 #pragma once
 #include <vector>
-#include <iViewXAPI.h>
-#if _WIN64
-#	pragma comment(lib, "iViewXAPI64.lib")
-#else
-#	pragma comment(lib, "iViewXAPI.lib")
-#endif
+#include <string>
+#include <variant>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include "iViewXTypes.h"
+#include "ChunkedBuffer.h"
+#include "SampleColumns.h"
+#include "SampleProfiles.h"
+#include "Timestamps.h"
+#include "BinaryLog.h"
+#include "Stats.h"
+#include "EventDetector.h"
+#include "Transforms.h"
+#include "LatestSample.h"
+#include "Notifier.h"
+#include "Epochs.h"
+#include "EventSamples.h"
+#include "DataQuality.h"
+#include "SharedRing.h"
+#include "ClockSync.h"
+#include "Published.h"
+#include "DataSource.h"
 
 
 namespace SMIbuff
 {
+    // how samples are stored
+    enum class SampleLayout
+    {
+        Records,        // as SampleStructs (default)
+        Columns         // one array per field. Fast output as columns (consumeSampleColumns,
+                        // used by the MATLAB wrapper), but no zero-copy views (viewSamples)
+    };
+
+    // sample storage: RowLayout (SampleLayout::Records), SampleColumnLayout
+    // (SampleLayout::Columns), then a compact layout per non-full SampleProfile
+    template <typename Seq> struct SampleStorageFor;
+    template <size_t... I>
+    struct SampleStorageFor<std::index_sequence<I...>>
+    {
+        using type = std::variant<
+            ChunkedBuffer<SampleStruct>,
+            ChunkedBuffer<SampleStruct, SampleColumnLayout>,
+            ChunkedBuffer<SampleStruct, CompactSampleLayoutAt<I>>...
+        >;
+    };
+    using SampleStorage = SampleStorageFor<std::make_index_sequence<g_nSampleProfiles - 1>>::type;
+
     // default argument values
     constexpr size_t g_sampleBufDefaultSize = 1 << 22;
 
     constexpr size_t g_eventBufDefaultSize = 1 << 14;
 
+    constexpr OverflowPolicy g_overflowPolicyDefault = OverflowPolicy::Grow;
+    constexpr SampleLayout   g_sampleLayoutDefault   = SampleLayout::Records;
+
+    constexpr unsigned g_logIntervalDefault = 100;  // ms
+
+    // reader used by the log thread (see SMIbuffer::startLogging)
+    constexpr const char* g_logReader = "SMIbuffer_log";
+
+    constexpr unsigned g_transformIntervalDefault = 20; // ms
+
+    // reader used by the transform thread (see SMIbuffer::startTransforms)
+    constexpr const char* g_transformReader = "SMIbuffer_transform";
+
+    // prefix of the temporary readers used by SMIbuffer::waitForEvent
+    constexpr const char* g_waitReaderPrefix = "SMIbuffer_wait";
+    constexpr char g_anyEventType = 0;
+
     constexpr bool   g_stopBufferEmptiesDefault = false;
     constexpr size_t g_consumeDefaultAmount = -1;
     constexpr size_t g_peekDefaultAmount = 1;
+
+    constexpr size_t g_sharedSampleCapacityDefault = 1 << 16;
+    constexpr size_t g_sharedEventCapacityDefault  = 1 << 12;
+    // appended to the name given to SMIbuffer::startSharing to name the shared rings
+    constexpr const char* g_sharedSampleSuffix = "_samples";
+    constexpr const char* g_sharedEventSuffix  = "_events";
+
+    // a sample and when it arrived, in host time (see hostTimeNow)
+    struct ArrivedSample
+    {
+        SampleStruct sample;
+        int64_t      arrivalTime;
+    };
 }
 
 
@@ -25,13 +97,24 @@ namespace SMIbuff
 class SMIbuffer
 {
 public:
-    SMIbuffer(bool needsEyeSwap_ = false);
+    // by default data comes from the iViewX SDK. Without the SDK (SMIBUFFER_NO_IVIEWX),
+    // a source must be provided
+    SMIbuffer(bool needsEyeSwap_ = false, std::shared_ptr<SMIbuff::DataSource> dataSource_ = SMIbuff::defaultDataSource());
     ~SMIbuffer();
 
     void setEyeSwap(const bool& needsEyeSwap_);
+    // switch to another data source. Buffering continues from the new source
+    void setDataSource(std::shared_ptr<SMIbuff::DataSource> dataSource_);
 
-    int startSampleBuffering(size_t initialBufferSize_ = SMIbuff::g_sampleBufDefaultSize);
-    int startEventBuffering (size_t initialBufferSize_ = SMIbuff::g_eventBufDefaultSize);
+    // start buffering data from the data source. Returns the source's return code for
+    // setting the callback (an iViewX SDK return code), 0 if there is no data source.
+    // bufferSize_ is the initial size of the buffer for the Grow overflow policy, and
+    // the fixed capacity of the buffer for the other policies. sampleProfile_ selects
+    // what of each sample is stored, anything but the full profile is stored as columns
+    // (sampleLayout_ is then ignored). Changing the sample layout or profile discards
+    // the buffer's contents and readers
+    int startSampleBuffering(size_t bufferSize_ = SMIbuff::g_sampleBufDefaultSize, SMIbuff::OverflowPolicy overflowPolicy_ = SMIbuff::g_overflowPolicyDefault, SMIbuff::SampleLayout sampleLayout_ = SMIbuff::g_sampleLayoutDefault, const SMIbuff::SampleProfile& sampleProfile_ = SMIbuff::SampleProfile{});
+    int startEventBuffering (size_t bufferSize_ = SMIbuff::g_eventBufDefaultSize,  SMIbuff::OverflowPolicy overflowPolicy_ = SMIbuff::g_overflowPolicyDefault);
     // clear all buffer contents
     void clearSampleBuffer();
     void clearEventBuffer ();
@@ -39,31 +122,310 @@ public:
     void stopSampleBuffering(bool emptyBuffer_ = SMIbuff::g_stopBufferEmptiesDefault);
     void stopEventBuffering (bool emptyBuffer_ = SMIbuff::g_stopBufferEmptiesDefault);
 
-    // consume samples (by default all)
-    std::vector<SampleStruct> consumeSamples(size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    // consume samples (by default all). Each reader consumes independently, by default
+    // the default reader is used
+    std::vector<SampleStruct> consumeSamples(size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader);
     // peek samples (by default only last one, can specify how many from end to peek)
     std::vector<SampleStruct> peekSamples(size_t lastN_ = SMIbuff::g_peekDefaultAmount);
+    // the most recent sample received while buffering samples, for e.g. gaze-contingent
+    // displays that only need the newest sample. Wait-free and allocation-free, unlike
+    // peekSamples(1). Always the full sample whatever the sample profile, and not affected
+    // by clearing the buffer. Returns false if no sample was received yet. arrivalTime_
+    // is when the sample's callback started, in host time (see getClockModel)
+    bool getLatestSample(SampleStruct& sample_) const;
+    bool getLatestSample(SampleStruct& sample_, int64_t& arrivalTime_) const;
+    // same as consumeSamples and peekSamples, but output one array per field. Only the
+    // fields in fields_ (see SMIbuff::SampleField) are output, the other columns are
+    // left empty, which saves copying them out here and converting them in the wrappers
+    SMIbuff::SampleColumns    consumeSampleColumns(size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader, SMIbuff::SampleFieldMask fields_ = SMIbuff::SampleField::All);
+    SMIbuff::SampleColumns    peekSampleColumns(size_t lastN_ = SMIbuff::g_peekDefaultAmount, SMIbuff::SampleFieldMask fields_ = SMIbuff::SampleField::All);
+    // same as consumeSamples and consumeSampleColumns, but write into caller-owned
+    // storage instead of new containers, so that polling allocates nothing once the
+    // storage is large enough: into out_, which has room for capacity_ samples, or into
+    // out_'s columns (for the fields selected in out_.fields), which only grow when more
+    // samples are consumed than before. Return the number of samples written
+    size_t consumeSamplesInto(SampleStruct* out_, size_t capacity_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    size_t consumeSampleColumnsInto(SMIbuff::SampleColumns& out_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader);
     // consume events (by default all)
-    std::vector<EventStruct>  consumeEvents(size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    std::vector<EventStruct>  consumeEvents(size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader);
     // peek events (by default only last one, can specify how many from end to peek)
     std::vector<EventStruct>  peekEvents(size_t lastN_ = SMIbuff::g_peekDefaultAmount);
 
+    // wait without polling, for at most timeout_ ms, until: n_ samples are available to
+    // reader_; a sample with timestamp >= ts_ has arrived; or an event of type type_
+    // (g_anyEventType: any) arrives, from the data source or the event detector. Only
+    // events that arrive after the call count, event_ is set to the first that matches.
+    // Return false on timeout. The callbacks only wake up waiting threads when there are
+    // any, otherwise signalling costs them next to nothing
+    bool waitForSamples(size_t n_, unsigned timeout_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    bool waitForTimestamp(int64_t ts_, unsigned timeout_);
+    bool waitForEvent(char type_, unsigned timeout_, EventStruct& event_);
+    bool waitForDetectedEvent(char type_, unsigned timeout_, EventStruct& event_);
+
+    // time range queries, O(log n + k): peek samples/events with tStart_ <= timestamp <
+    // tEnd_, or consume those with timestamp < ts_. For events, their start time is used
+    std::vector<SampleStruct> peekSamplesRange(int64_t tStart_, int64_t tEnd_);
+    std::vector<SampleStruct> consumeSamplesUntil(int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    SMIbuff::SampleColumns    peekSampleColumnsRange(int64_t tStart_, int64_t tEnd_, SMIbuff::SampleFieldMask fields_ = SMIbuff::SampleField::All);
+    SMIbuff::SampleColumns    consumeSampleColumnsUntil(int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader, SMIbuff::SampleFieldMask fields_ = SMIbuff::SampleField::All);
+    std::vector<EventStruct>  peekEventsRange(int64_t tStart_, int64_t tEnd_);
+    std::vector<EventStruct>  consumeEventsUntil(int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader);
+
+    // epochs (e.g. trials, see SMIbuff::Epoch). markEpoch starts a new epoch at the
+    // current write position of the sample and event buffers, ending the previous one,
+    // and returns its index. endEpoch ends the current epoch without starting another
+    // (e.g. for the time between trials). An epoch's data is retrieved by its index (look
+    // up a label with findEpoch, g_noEpoch if unknown) without searching the buffers, so
+    // independent of how much is stored. consumeEpoch* return what reader_ has not
+    // consumed yet of the epoch, and move reader_ past its end. trimEpochs discards all
+    // data up to the end of epoch index_ for all readers, to release memory, and returns
+    // false if it is not a finished epoch. Changing the sample layout or profile discards
+    // the samples of earlier epochs
+    size_t markEpoch(const std::string& label_);
+    void   endEpoch();
+    size_t findEpoch(const std::string& label_);
+    std::vector<SMIbuff::Epoch> getEpochs();
+    void   clearEpochs();
+    std::vector<SampleStruct> peekEpochSamples(size_t index_);
+    SMIbuff::SampleColumns    peekEpochSampleColumns(size_t index_);
+    std::vector<SampleStruct> consumeEpochSamples(size_t index_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    SMIbuff::SampleColumns    consumeEpochSampleColumns(size_t index_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    std::vector<EventStruct>  peekEpochEvents(size_t index_);
+    std::vector<EventStruct>  consumeEpochEvents(size_t index_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    bool trimEpochs(size_t index_);
+
+    // samples of an event from the data source: those with startTime <= timestamp <=
+    // endTime. Events are identified by their position in the event buffer, the number
+    // of events received before them (as Epoch::eventStart). Each event's range of
+    // sample positions is looked up once, O(log n), as soon as all its samples have
+    // arrived, and kept in a cross-index (SMIbuff::EventSampleIndex), so that getting an
+    // event's samples then needs no search. The index catches up on new events whenever
+    // it is used, the callbacks do no extra work. getEventSampleRange returns false if
+    // the event is no longer stored. getLatestEvent finds the newest event of type type_
+    // (g_anyEventType: any) still stored, e.g. the last completed fixation ('F'), and
+    // returns false if there is none. Changing the sample layout or profile discards the
+    // samples of earlier events
+    bool getEventSampleRange(uint64_t eventPos_, SMIbuff::SampleRange& range_);
+    std::vector<SampleStruct> getEventSamples(uint64_t eventPos_);
+    SMIbuff::SampleColumns    getEventSampleColumns(uint64_t eventPos_, SMIbuff::SampleFieldMask fields_ = SMIbuff::SampleField::All);
+    bool getLatestEvent(char type_, EventStruct& event_, uint64_t& eventPos_);
+
+    // number of elements dropped, spilled to disk or compressed because buffer was full. Reset when buffer is cleared
+    SMIbuff::OverflowCounts getSampleOverflowCounts() const;
+    SMIbuff::OverflowCounts getEventOverflowCounts () const;
+    // runtime statistics of both streams (see SMIbuff::StreamStats), for diagnosing
+    // stutters. Always collected, they accumulate until resetStats(). The buffer part of
+    // the sample statistics also restarts when the sample layout or profile changes
+    SMIbuff::Stats getStats() const;
+    void resetStats();
+
+    // relation between the tracker's clock (sample timestamps) and the host clock
+    // (SMIbuff::hostTimeNow(), std::chrono::steady_clock in us, as Epoch::hostTime). It
+    // is estimated from the samples' arrival times as they come in (see
+    // SMIbuff::ClockSync), so only while samples are buffered, and is read lock-free in
+    // O(1). The delivery latency of each sample relative to the model is collected in
+    // the latency statistics (getStats). Return false if there is no model yet. After a
+    // data source change, the model restarts with the new source's first sample
+    bool getClockModel(SMIbuff::ClockModel& model_) const;
+    bool trackerToHostTime(int64_t trackerTime_, int64_t& hostTime_) const;
+    bool hostToTrackerTime(int64_t hostTime_, int64_t& trackerTime_) const;
+
+    // readers, for multiple consumers of the same stream. Each reader has its own read
+    // position and gets all samples/events, storage is only released once all readers
+    // have consumed it. The default reader exists from the start: remove it (name "")
+    // when only using named readers, else it keeps all data alive. New readers start at
+    // the oldest sample/event still stored. add/remove return false if the reader
+    // already exists/doesn't exist
+    bool addSampleReader   (const std::string& name_);
+    bool addEventReader    (const std::string& name_);
+    bool removeSampleReader(const std::string& name_);
+    bool removeEventReader (const std::string& name_);
+    std::vector<std::string> getSampleReaders();
+    std::vector<std::string> getEventReaders ();
+    // zero-copy access to a reader's unconsumed samples/events (by default all). They
+    // are not consumed, call advanceSamples/advanceEvents with the number processed
+    // when done. See SMIbuff::BufferView for how long the view is valid
+    SMIbuff::BufferView<SampleStruct> viewSamples(const std::string& reader_ = SMIbuff::g_defaultReader, size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    SMIbuff::BufferView<EventStruct>  viewEvents (const std::string& reader_ = SMIbuff::g_defaultReader, size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    bool isValid(const SMIbuff::BufferView<SampleStruct>& view_);
+    bool isValid(const SMIbuff::BufferView<EventStruct>&  view_);
+    // mark samples/events consumed for a reader without copying them out. Returns number skipped
+    size_t advanceSamples(size_t n_, const std::string& reader_ = SMIbuff::g_defaultReader);
+    size_t advanceEvents (size_t n_, const std::string& reader_ = SMIbuff::g_defaultReader);
+
+    // log all samples and events to a binary file while buffering (format: see
+    // SMIbuff::LogWriter, read back with SMIbuff::readLog). A background thread writes
+    // out new data every logInterval_ ms, the SDK's callback thread does no file I/O.
+    // The log thread uses its own reader (SMIbuff::g_logReader) on both buffers, so
+    // consuming or peeking is unaffected. Logging starts with the oldest data still in
+    // the buffers. Returns false if the file can't be created. If writing the file fails
+    // (e.g. disk full), logging stops: isLogging then returns false, with writeFailed_
+    // set, until logging is started again
+    bool startLogging(const std::string& file_, unsigned logInterval_ = SMIbuff::g_logIntervalDefault);
+    // writes out remaining data and closes the file
+    void stopLogging();
+    bool isLogging();
+    bool isLogging(bool& writeFailed_);
+
+    // online fixation and saccade detection (see SMIbuff::EventDetector). Runs on the
+    // data source's thread as samples arrive, so only while samples are buffered. The
+    // detected events are a stream of their own, separate from the data source's events.
+    // bufferSize_ and overflowPolicy_ are as for startEventBuffering. Starting again
+    // restarts detection with the new settings. Ongoing events are ended when detection
+    // stops or restarts, and reported if they qualify
+    void startEventDetection(const SMIbuff::DetectorSettings& settings_ = SMIbuff::DetectorSettings{}, size_t bufferSize_ = SMIbuff::g_eventBufDefaultSize, SMIbuff::OverflowPolicy overflowPolicy_ = SMIbuff::g_overflowPolicyDefault);
+    void stopEventDetection(bool emptyBuffer_ = SMIbuff::g_stopBufferEmptiesDefault);
+    bool isDetectingEvents() const;
+    void clearDetectedEventBuffer();
+    std::vector<EventStruct> consumeDetectedEvents(size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    std::vector<EventStruct> peekDetectedEvents(size_t lastN_ = SMIbuff::g_peekDefaultAmount);
+
+    // data-quality metrics (precision, data loss, offset, see SMIbuff::QualityMonitor)
+    // over a sliding window of the incoming samples. Like event detection, runs on the
+    // data source's thread, so only while samples are buffered. After each sample, the
+    // metrics are published in a slot that getQuality reads without locking, so it can
+    // be called e.g. every frame. The window is allocated here, sized for
+    // QualitySettings::maxSampleRate, so the data source's thread doesn't allocate.
+    // Starting again restarts with an empty window, e.g. for the next validation point.
+    // Returns false if the settings are invalid.
+    // getQuality returns false if monitoring was never started, after stopping it
+    // returns the last metrics
+    bool startQualityMonitor(const SMIbuff::QualitySettings& settings_ = SMIbuff::QualitySettings{});
+    void stopQualityMonitor();
+    bool isMonitoringQuality() const;
+    bool getQuality(SMIbuff::QualityMetrics& metrics_) const;
+
+    // publish samples and events from the data source, as they arrive, in shared-memory
+    // rings named name_ + g_sharedSampleSuffix and name_ + g_sharedEventSuffix, so that
+    // other processes can follow them live with SMIbuff::SharedRingReader (see
+    // SharedRing.h). The rings are written on the data source's thread, while buffering,
+    // which costs a copy of each sample. Readers never slow down the writer: those that
+    // fall behind by more than the ring's capacity (rounded up to a power of two) lose
+    // the oldest data. Starting again replaces the rings. Returns false, with sharing
+    // stopped, if they couldn't be created
+    bool startSharing(const std::string& name_, size_t sampleCapacity_ = SMIbuff::g_sharedSampleCapacityDefault, size_t eventCapacity_ = SMIbuff::g_sharedEventCapacityDefault);
+    void stopSharing();
+    bool isSharing() const;
+
+    // per-sample transforms (see SMIbuff::TransformPipeline), e.g. to correct for a
+    // screen offset, convert to degrees, smooth or average the eyes. A background thread
+    // applies stages_, in order, to new samples in batches every interval_ ms, the data
+    // source's thread does no extra work. The transformed samples are stored in a buffer
+    // of their own next to the raw samples, with the same timestamps, and can be consumed
+    // and peeked like those. The transform thread uses its own reader
+    // (SMIbuff::g_transformReader) on the sample buffer, and starts with the oldest sample
+    // still stored. Starting again transforms the samples not transformed yet with the
+    // new stages. bufferSize_ and overflowPolicy_ are as for startSampleBuffering.
+    // Returns false if a stage is invalid
+    bool startTransforms(const std::vector<SMIbuff::TransformStage>& stages_, unsigned interval_ = SMIbuff::g_transformIntervalDefault, size_t bufferSize_ = SMIbuff::g_sampleBufDefaultSize, SMIbuff::OverflowPolicy overflowPolicy_ = SMIbuff::g_overflowPolicyDefault);
+    // transforms remaining samples
+    void stopTransforms(bool emptyBuffer_ = SMIbuff::g_stopBufferEmptiesDefault);
+    bool isTransforming();
+    void clearTransformedSampleBuffer();
+    // these first transform samples that the transform thread hasn't gotten to yet
+    std::vector<SampleStruct> consumeTransformedSamples(size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    std::vector<SampleStruct> peekTransformedSamples(size_t lastN_ = SMIbuff::g_peekDefaultAmount);
+    SMIbuff::SampleColumns    consumeTransformedSampleColumns(size_t firstN_ = SMIbuff::g_consumeDefaultAmount);
+    SMIbuff::SampleColumns    peekTransformedSampleColumns(size_t lastN_ = SMIbuff::g_peekDefaultAmount);
+
 private:
-    // SMI callbacks needs to be friends
-    friend int __stdcall SMISampleCallback(SampleStruct sampleData_);
-    friend int __stdcall SMIEventCallback (EventStruct   eventData_);
+    // data source callbacks, these run on the source's thread
+    void onSample(SampleStruct sample_);
+    void onEvent (const EventStruct& event_);
+    // (un)register callbacks with data source
+    int  setSampleCallback(bool set_);
+    int  setEventCallback (bool set_);
 
     //// generic functions for internal use
     // helpers
-    template <typename T>  std::vector<T>&  getBuffer();
+    // call f_ with the buffer for T
+    template <typename T, typename F>  decltype(auto) withBuffer(F&& f_);
     // generic implementations
     template <typename T>  void             clearBuffer();
     template <typename T>  void             stopBufferingGenericPart(bool emptyBuffer_);
     template <typename T>  std::vector<T>   peek(size_t lastN_);
-    template <typename T>  std::vector<T>   consume(size_t firstN_);
+    template <typename T>  std::vector<T>   consume(size_t firstN_, const std::string& reader_);
+    // wait for an event in buf_, see waitForEvent
+    bool waitForEventIn(SMIbuff::ChunkedBuffer<EventStruct>& buf_, SMIbuff::Notifier& notifier_, char type_, unsigned timeout_, EventStruct& event_);
+    // copy of epoch index_, false if there is none
+    bool getEpoch(size_t index_, SMIbuff::Epoch& epoch_);
+    // add the sample ranges of the events whose samples have all arrived to the
+    // cross-index. Needs _eventSampleMutex
+    void updateEventSamples();
+    SMIbuff::SampleRange findEventSamples(const EventStruct& event_);
+    // unpublish the detector and end detection, reporting ongoing events
+    void finishEventDetection();
+    // log thread
+    void logThread(unsigned logInterval_);
+    void writeLog();    // needs _logMutex
+    void closeLog();    // idem
+    // transform thread
+    void transformThread(unsigned interval_);
+    void processTransforms();   // needs _transformMutex
 
 private:
-    std::vector<SampleStruct> _sampleData;
-    std::vector<EventStruct>  _eventData;
-    bool                      _doEyeSwap;
+    // sample storage, depending on SampleLayout and SampleProfile
+    SMIbuff::SampleStorage               _sampleData;
+    SMIbuff::ChunkedBuffer<EventStruct>  _eventData;
+    bool                                 _doEyeSwap;
+    std::shared_ptr<SMIbuff::DataSource> _dataSource;
+    bool                                 _bufferingSamples = false;
+    bool                                 _bufferingEvents  = false;
+    SMIbuff::CallbackStats               _sampleStats;
+    SMIbuff::CallbackStats               _eventStats;
+    SMIbuff::LatestSlot<SMIbuff::ArrivedSample> _latestSample;
+    // clock model. _clockSync is only used by the sample callback
+    SMIbuff::ClockSync                   _clockSync;
+    SMIbuff::LatestSlot<SMIbuff::ClockModel> _clockModel;
+    SMIbuff::LatencyCounters             _latency;
+    // wake up threads in waitFor*
+    SMIbuff::Notifier                    _sampleNotifier;
+    SMIbuff::Notifier                    _eventNotifier;
+    SMIbuff::Notifier                    _detectedEventNotifier;
+    std::atomic<unsigned>                _nWaitReaders{0};
+
+    // the detector, quality monitor and rings below are replaced while the callbacks keep
+    // running: the old ones are retired once the callbacks are done with them
+    SMIbuff::CallbackQuiescence          _sampleQuiescence;
+    SMIbuff::CallbackQuiescence          _eventQuiescence;
+
+    // online event detection. While the detector is published, the sample callback is the
+    // only producer of _detectedEventData
+    SMIbuff::Published<SMIbuff::EventDetector> _detector;
+    SMIbuff::ChunkedBuffer<EventStruct>  _detectedEventData;
+
+    // data-quality metrics. Stored by the sample callback while _quality is published
+    SMIbuff::Published<SMIbuff::QualityMonitor> _quality;
+    SMIbuff::LatestSlot<SMIbuff::QualityMetrics> _qualityMetrics;
+
+    // shared-memory rings
+    SMIbuff::Published<SMIbuff::SharedRingWriter<SampleStruct>> _sharedSamples;
+    SMIbuff::Published<SMIbuff::SharedRingWriter<EventStruct>>  _sharedEvents;
+
+    // per-sample transforms. _transformMutex serializes the transform thread with changes
+    // to the sample storage and with consumers of the transformed samples
+    std::unique_ptr<SMIbuff::TransformPipeline> _transforms;
+    SMIbuff::ChunkedBuffer<SampleStruct, SMIbuff::SampleColumnLayout> _transformedData;
+    SMIbuff::SampleColumns               _transformBatch;
+    std::thread                          _transformThread;
+    std::mutex                           _transformMutex;
+    std::condition_variable              _transformCondition;
+    bool                                 _transformStop = false;
+
+    // epochs. Positions of the samples are reset when the sample storage is recreated
+    SMIbuff::EpochIndex                  _epochs;
+    std::mutex                           _epochMutex;
+
+    // cross-index from events to their samples. Positions of the samples are reset when
+    // the sample storage is recreated
+    SMIbuff::EventSampleIndex            _eventSamples;
+    std::mutex                           _eventSampleMutex;
+
+    // binary log. _logMutex serializes the log thread with changes to the sample storage
+    SMIbuff::LogWriter                   _logWriter;
+    std::thread                          _logThread;
+    std::mutex                           _logMutex;
+    std::condition_variable              _logCondition;
+    bool                                 _logStop = false;
+    bool                                 _logWriteFailed = false;
 };
\ No newline at end of file
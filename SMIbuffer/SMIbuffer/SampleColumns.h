@@ -0,0 +1,245 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include "iViewXTypes.h"
+
+#include "ChunkedBuffer.h"
+
+
+namespace SMIbuff
+{
+    // samples as one contiguous array per field (structure of arrays), so that each
+    // field can be handed over (e.g. to MATLAB) with a single memcpy
+    struct EyeDataColumns
+    {
+        std::vector<double> gazeX;
+        std::vector<double> gazeY;
+        std::vector<double> diam;
+        std::vector<double> eyePositionX;
+        std::vector<double> eyePositionY;
+        std::vector<double> eyePositionZ;
+    };
+
+    // calls f_ with an accessor for each field of a sample. As the field names are the
+    // same for SampleStruct, SampleColumns and SampleColumnLayout::Block, the accessor
+    // works on any of them. Keeps the functions below in sync with the field list
+    template <typename F>
+    void forEachSampleField(F&& f_)
+    {
+        f_([](auto& s_) -> auto& { return s_.timestamp; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.gazeX; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.gazeY; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.diam; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.eyePositionX; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.eyePositionY; });
+        f_([](auto& s_) -> auto& { return s_.leftEye.eyePositionZ; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.gazeX; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.gazeY; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.diam; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.eyePositionX; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.eyePositionY; });
+        f_([](auto& s_) -> auto& { return s_.rightEye.eyePositionZ; });
+        f_([](auto& s_) -> auto& { return s_.planeNumber; });
+    }
+
+    // selection of sample fields, one bit per field in the order of forEachSampleField
+    using SampleFieldMask = uint32_t;
+    namespace SampleField
+    {
+        constexpr SampleFieldMask Timestamp         = 1u << 0;
+        constexpr SampleFieldMask LeftGazeX         = 1u << 1;
+        constexpr SampleFieldMask LeftGazeY         = 1u << 2;
+        constexpr SampleFieldMask LeftDiam          = 1u << 3;
+        constexpr SampleFieldMask LeftEyePositionX  = 1u << 4;
+        constexpr SampleFieldMask LeftEyePositionY  = 1u << 5;
+        constexpr SampleFieldMask LeftEyePositionZ  = 1u << 6;
+        constexpr SampleFieldMask RightGazeX        = 1u << 7;
+        constexpr SampleFieldMask RightGazeY        = 1u << 8;
+        constexpr SampleFieldMask RightDiam         = 1u << 9;
+        constexpr SampleFieldMask RightEyePositionX = 1u << 10;
+        constexpr SampleFieldMask RightEyePositionY = 1u << 11;
+        constexpr SampleFieldMask RightEyePositionZ = 1u << 12;
+        constexpr SampleFieldMask PlaneNumber       = 1u << 13;
+        constexpr SampleFieldMask LeftEye           = 0x3Fu << 1;
+        constexpr SampleFieldMask RightEye          = 0x3Fu << 7;
+        constexpr SampleFieldMask All               = (1u << 14) - 1;
+    }
+
+    // as above, only for the fields in fields_
+    template <typename F>
+    void forEachSampleField(SampleFieldMask fields_, F&& f_)
+    {
+        SampleFieldMask bit = 1;
+        forEachSampleField([&](auto field_)
+        {
+            if (fields_ & bit)
+                f_(field_);
+            bit <<= 1;
+        });
+    }
+
+    // field selection from names: "timestamp", "planeNumber", an eye field of one eye
+    // ("leftEye.gazeX") or of both ("gazeX"), or a whole eye ("leftEye"). Returns false
+    // if a name is not recognized
+    inline bool sampleFieldsFromNames(const std::vector<std::string>& names_, SampleFieldMask& fields_)
+    {
+        static const char* eyeFields[] = { "gazeX", "gazeY", "diam", "eyePositionX", "eyePositionY", "eyePositionZ" };
+        fields_ = 0;
+        for (const auto& name : names_)
+        {
+            SampleFieldMask eyes = SampleField::LeftEye | SampleField::RightEye;
+            std::string field = name;
+            if (name == "timestamp")
+            {
+                fields_ |= SampleField::Timestamp;
+                continue;
+            }
+            if (name == "planeNumber")
+            {
+                fields_ |= SampleField::PlaneNumber;
+                continue;
+            }
+            if (name == "leftEye" || name == "rightEye")
+            {
+                fields_ |= name == "leftEye" ? SampleField::LeftEye : SampleField::RightEye;
+                continue;
+            }
+            if (name.compare(0, 8, "leftEye.") == 0)
+            {
+                eyes  = SampleField::LeftEye;
+                field = name.substr(8);
+            }
+            else if (name.compare(0, 9, "rightEye.") == 0)
+            {
+                eyes  = SampleField::RightEye;
+                field = name.substr(9);
+            }
+
+            const auto it = std::find(std::begin(eyeFields), std::end(eyeFields), field);
+            if (it == std::end(eyeFields))
+                return false;
+            // the field's bit in both eyes, masked to the requested eyes
+            const auto k = static_cast<unsigned>(it - std::begin(eyeFields));
+            fields_ |= ((SampleField::LeftGazeX | SampleField::RightGazeX) << k) & eyes;
+        }
+        return true;
+    }
+
+    // Only the columns in fields are filled, the others stay empty. Set fields before
+    // filling, e.g. to skip the conversion and copying of fields that aren't used
+    struct SampleColumns
+    {
+        std::vector<long long>  timestamp;
+        EyeDataColumns          leftEye;
+        EyeDataColumns          rightEye;
+        std::vector<int>        planeNumber;
+        SampleFieldMask         fields = SampleField::All;
+
+        SampleColumns() = default;
+        explicit SampleColumns(SampleFieldMask fields_) : fields(fields_) {}
+
+        size_t size() const
+        {
+            return _size;
+        }
+        void resize(size_t n_)
+        {
+            forEachSampleField(fields, [&](auto field_) { field_(*this).resize(n_); });
+            _size = n_;
+        }
+        // store n_ samples at index at_
+        void put(size_t at_, const SampleStruct* in_, size_t n_)
+        {
+            forEachSampleField(fields, [&](auto field_)
+            {
+                auto out = field_(*this).data() + at_;
+                for (size_t i = 0; i < n_; i++)
+                    out[i] = field_(in_[i]);
+            });
+        }
+        // copy n_ samples starting at index at_ to out_
+        void get(size_t at_, SampleStruct* out_, size_t n_) const
+        {
+            forEachSampleField(fields, [&](auto field_)
+            {
+                const auto in = field_(*this).data() + at_;
+                for (size_t i = 0; i < n_; i++)
+                    field_(out_[i]) = in[i];
+            });
+        }
+        // remove n_ samples starting at index at_
+        void erase(size_t at_, size_t n_)
+        {
+            forEachSampleField(fields, [&](auto field_)
+            {
+                auto& col = field_(*this);
+                col.erase(col.begin() + at_, col.begin() + at_ + n_);
+            });
+            _size -= n_;
+        }
+
+    private:
+        size_t _size = 0;
+    };
+
+    // ChunkedBuffer layout storing samples as columns (see RowLayout). Copying out to
+    // SampleColumns is a memcpy per field, copying out to SampleStructs is a gather
+    template <size_t N>
+    struct EyeDataBlock
+    {
+        double gazeX[N];
+        double gazeY[N];
+        double diam[N];
+        double eyePositionX[N];
+        double eyePositionY[N];
+        double eyePositionZ[N];
+    };
+    struct SampleColumnLayout
+    {
+        static constexpr bool isContiguous = false;
+
+        struct Block
+        {
+            long long                   timestamp[g_chunkSize];
+            EyeDataBlock<g_chunkSize>   leftEye;
+            EyeDataBlock<g_chunkSize>   rightEye;
+            int                         planeNumber[g_chunkSize];
+        };
+
+        static int64_t timestamp(const Block& block_, size_t i_)
+        {
+            return block_.timestamp[i_];
+        }
+        static void store(Block& block_, size_t i_, const SampleStruct& item_)
+        {
+            forEachSampleField([&](auto field_) { field_(block_)[i_] = field_(item_); });
+        }
+        static void store(Block& block_, size_t i_, const SampleColumns& in_, size_t from_, size_t n_)
+        {
+            forEachSampleField(in_.fields, [&](auto field_)
+            {
+                std::copy_n(field_(in_).data() + from_, n_, field_(block_) + i_);
+            });
+        }
+        static void copy(const Block& block_, size_t i_, size_t n_, SampleStruct* out_)
+        {
+            forEachSampleField([&](auto field_)
+            {
+                const auto in = field_(block_) + i_;
+                for (size_t i = 0; i < n_; i++)
+                    field_(out_[i]) = in[i];
+            });
+        }
+        static void copy(const Block& block_, size_t i_, size_t n_, SampleColumns& out_, size_t at_)
+        {
+            forEachSampleField(out_.fields, [&](auto field_)
+            {
+                std::copy_n(field_(block_) + i_, n_, field_(out_).data() + at_);
+            });
+        }
+    };
+}
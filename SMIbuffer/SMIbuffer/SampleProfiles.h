@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include "iViewXTypes.h"
+
+#include "ChunkedBuffer.h"
+#include "SampleColumns.h"
+
+
+namespace SMIbuff
+{
+    // which eyes' data to store
+    enum class SampleEyes
+    {
+        Binocular,
+        Left,
+        Right
+    };
+
+    // what to store of each sample. Anything not stored reads back as 0, so output is
+    // always full SampleStructs or SampleColumns. planeNumber is only stored with the
+    // full profile (the default)
+    struct SampleProfile
+    {
+        SampleEyes  eyes            = SampleEyes::Binocular;
+        bool        singlePrecision = false;    // store gaze, pupil diameter and eye position as float
+        bool        eyePosition     = true;     // store eyePositionX/Y/Z
+
+        bool isFull() const
+        {
+            return eyes == SampleEyes::Binocular && !singlePrecision && eyePosition;
+        }
+        // 0 for full profile, each other combination gets its own number
+        size_t index() const
+        {
+            return static_cast<size_t>(eyes) * 4 + singlePrecision * 2 + !eyePosition;
+        }
+    };
+    constexpr size_t g_nSampleProfiles = 12;
+
+    // like forEachSampleField, for the fields of one eye
+    template <bool EyePosition, typename F>
+    void forEachEyeField(F&& f_)
+    {
+        f_([](auto& e_) -> auto& { return e_.gazeX; });
+        f_([](auto& e_) -> auto& { return e_.gazeY; });
+        f_([](auto& e_) -> auto& { return e_.diam; });
+        if constexpr (EyePosition)
+        {
+            f_([](auto& e_) -> auto& { return e_.eyePositionX; });
+            f_([](auto& e_) -> auto& { return e_.eyePositionY; });
+            f_([](auto& e_) -> auto& { return e_.eyePositionZ; });
+        }
+    }
+
+    // ChunkedBuffer layout storing only the fields of a SampleProfile, as columns (see
+    // SampleColumnLayout). Conversion to the stored precision happens on push, widening
+    // back to SampleStruct or SampleColumns on copy out
+    template <SampleEyes Eyes, typename Real, bool EyePosition>
+    struct CompactSampleLayout
+    {
+        static constexpr bool isContiguous = false;
+
+        static constexpr bool   hasLeft  = Eyes != SampleEyes::Right;
+        static constexpr bool   hasRight = Eyes != SampleEyes::Left;
+        static constexpr size_t nEyes    = hasLeft + hasRight;
+
+        template <size_t N>
+        struct EyeBlock
+        {
+            Real gazeX[N];
+            Real gazeY[N];
+            Real diam[N];
+        };
+        template <size_t N>
+        struct EyePositionBlock : EyeBlock<N>
+        {
+            Real eyePositionX[N];
+            Real eyePositionY[N];
+            Real eyePositionZ[N];
+        };
+        using Eye = std::conditional_t<EyePosition, EyePositionBlock<g_chunkSize>, EyeBlock<g_chunkSize>>;
+
+        struct Block
+        {
+            long long   timestamp[g_chunkSize];
+            Eye         eyes[nEyes];    // left first
+        };
+
+        static int64_t timestamp(const Block& block_, size_t i_)
+        {
+            return block_.timestamp[i_];
+        }
+        static void store(Block& block_, size_t i_, const SampleStruct& item_)
+        {
+            block_.timestamp[i_] = item_.timestamp;
+            forEachEye([&](size_t e_, auto eye_)
+            {
+                forEachEyeField<EyePosition>([&](auto field_) { field_(block_.eyes[e_])[i_] = static_cast<Real>(field_(eye_(item_))); });
+            });
+        }
+        static void copy(const Block& block_, size_t i_, size_t n_, SampleStruct* out_)
+        {
+            for (size_t i = 0; i < n_; i++)
+            {
+                out_[i] = SampleStruct{};
+                out_[i].timestamp = block_.timestamp[i_ + i];
+            }
+            forEachEye([&](size_t e_, auto eye_)
+            {
+                forEachEyeField<EyePosition>([&](auto field_)
+                {
+                    const auto in = field_(block_.eyes[e_]) + i_;
+                    for (size_t i = 0; i < n_; i++)
+                        field_(eye_(out_[i])) = in[i];
+                });
+            });
+        }
+        static void copy(const Block& block_, size_t i_, size_t n_, SampleColumns& out_, size_t at_)
+        {
+            // zero everything not stored, then fill what is. Only the selected fields
+            forEachSampleField(out_.fields, [&](auto field_) { std::fill_n(field_(out_).data() + at_, n_, 0); });
+            if (out_.fields & SampleField::Timestamp)
+                std::copy_n(block_.timestamp + i_, n_, out_.timestamp.data() + at_);
+            forEachEye([&](size_t e_, auto eye_)
+            {
+                // the eye's bits are in the order of forEachEyeField
+                SampleFieldMask bit = &eye_(out_) == &out_.leftEye ? SampleField::LeftGazeX : SampleField::RightGazeX;
+                forEachEyeField<EyePosition>([&](auto field_)
+                {
+                    if (out_.fields & bit)
+                        std::copy_n(field_(block_.eyes[e_]) + i_, n_, field_(eye_(out_)).data() + at_);
+                    bit <<= 1;
+                });
+            });
+        }
+
+    private:
+        // calls f_ with the index in Block::eyes and an accessor for the eye in a sample
+        template <typename F>
+        static void forEachEye(F&& f_)
+        {
+            if constexpr (hasLeft)
+                f_(0, [](auto& s_) -> auto& { return s_.leftEye; });
+            if constexpr (hasRight)
+                f_(hasLeft, [](auto& s_) -> auto& { return s_.rightEye; });
+        }
+    };
+
+    // compact layout for SampleProfile with index I_+1 (0 is the full profile, which
+    // uses RowLayout or SampleColumnLayout)
+    template <size_t I_>
+    using CompactSampleLayoutAt = CompactSampleLayout<
+        static_cast<SampleEyes>((I_ + 1) / 4),
+        std::conditional_t<((I_ + 1) / 2) % 2 != 0, float, double>,
+        (I_ + 1) % 2 == 0>;
+}
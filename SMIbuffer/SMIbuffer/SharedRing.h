@@ -0,0 +1,281 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <new>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace SMIbuff
+{
+    // Named block of memory shared between processes: POSIX shared memory (shm_open),
+    // or a pagefile-backed file mapping on Windows (in the session's Local\ namespace).
+    // The creator removes the name when closing, processes that have the block open
+    // keep their mapping. Implemented in src/SharedMemory.cpp
+    class SharedMemory
+    {
+    public:
+        SharedMemory() = default;
+        ~SharedMemory();
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        // create a zero-filled block of size_ bytes for reading and writing. An existing
+        // block with the same name is replaced for new openers, except on Windows, where
+        // creating fails while a process still has it open. False on failure
+        bool create(const std::string& name_, size_t size_);
+        // open an existing block read-only. False if there is none with that name
+        bool open(const std::string& name_);
+        void close();
+
+        bool isOpen() const
+        {
+            return _data != nullptr;
+        }
+        void* data() const
+        {
+            return _data;
+        }
+        size_t size() const
+        {
+            return _size;
+        }
+
+    private:
+        void*       _data   = nullptr;
+        size_t      _size   = 0;
+        bool        _owner  = false;
+        std::string _name;
+        void*       _handle = nullptr;  // Windows: the file mapping
+    };
+
+
+    constexpr uint32_t g_sharedRingMagic   = 0x524D5353;    // "SSMR"
+    constexpr uint32_t g_sharedRingVersion = 1;
+
+    // Layout of a shared ring: this header, then capacity slots, each a sequence number
+    // and the element. Element n goes in slot n % capacity. The writer marks a slot as
+    // being written (sequence 0) before changing it, and stores n+1 after, so that a
+    // reader can tell whether the copy it made is of element n and wasn't overwritten
+    // while copying (a seqlock per slot). Elements are stored as atomic words so that
+    // racing copies are well-defined, the relaxed loads and stores compile to plain moves
+    struct SharedRingHeader
+    {
+        uint32_t magic       = g_sharedRingMagic;
+        uint32_t version     = g_sharedRingVersion;
+        uint32_t elementSize = 0;       // sizeof the element type, checked by readers
+        uint32_t capacity    = 0;       // number of slots, a power of two
+        alignas(64) std::atomic<uint64_t> writePos{0};  // number of elements written
+    };
+
+    template <typename T>
+    struct SharedRingSlot
+    {
+        static constexpr size_t nWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint64_t>                       seq;    // position+1 of the element held, 0 while being written
+        std::array<std::atomic<uint64_t>, nWords>   words;
+    };
+
+    inline size_t sharedRingSize(size_t capacity_, size_t slotSize_)
+    {
+        return sizeof(SharedRingHeader) + capacity_ * slotSize_;
+    }
+
+
+    // Publishes elements in a shared ring, for a single writer. Writing never waits for
+    // readers, a reader that falls more than the capacity behind loses the oldest
+    // elements. Not thread-safe
+    template <typename T>
+    class SharedRingWriter
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SharedRingWriter needs a trivially copyable type");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared rings need lock-free 64-bit atomics");
+        using Slot = SharedRingSlot<T>;
+
+    public:
+        // capacity_ is rounded up to a power of two. False if the shared memory couldn't
+        // be created
+        bool create(const std::string& name_, size_t capacity_)
+        {
+            size_t capacity = 1;
+            while (capacity < capacity_)
+                capacity <<= 1;
+            if (capacity > UINT32_MAX || !_memory.create(name_, sharedRingSize(capacity, sizeof(Slot))))
+                return false;
+
+            // zero-filled memory is valid for the slots' atomics
+            _header = new (_memory.data()) SharedRingHeader;
+            _header->elementSize = sizeof(T);
+            _header->capacity    = static_cast<uint32_t>(capacity);
+            _slots = reinterpret_cast<Slot*>(static_cast<char*>(_memory.data()) + sizeof(SharedRingHeader));
+            _mask  = capacity - 1;
+            _name  = name_;
+            return true;
+        }
+        void close()
+        {
+            _memory.close();
+            _header = nullptr;
+            _slots  = nullptr;
+            _name.clear();
+        }
+
+        void push(const T& item_)
+        {
+            std::array<uint64_t, Slot::nWords> words{};
+            std::memcpy(words.data(), &item_, sizeof(T));
+
+            const auto pos = _header->writePos.load(std::memory_order_relaxed);
+            Slot& slot = _slots[pos & _mask];
+            slot.seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < Slot::nWords; i++)
+                slot.words[i].store(words[i], std::memory_order_relaxed);
+            slot.seq.store(pos + 1, std::memory_order_release);
+            _header->writePos.store(pos + 1, std::memory_order_release);
+        }
+
+        const std::string& getName() const
+        {
+            return _name;
+        }
+
+    private:
+        SharedMemory        _memory;
+        SharedRingHeader*   _header = nullptr;
+        Slot*               _slots  = nullptr;
+        uint64_t            _mask   = 0;
+        std::string         _name;
+    };
+
+
+    // Follows a shared ring from another process, which it attaches to read-only, so
+    // it can't disturb the writer. Each reader has its own read position. If the writer
+    // closes the ring and creates it anew (e.g. a new session), attach again to follow
+    // the new one. Not thread-safe
+    template <typename T>
+    class SharedRingReader
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SharedRingReader needs a trivially copyable type");
+        using Slot = SharedRingSlot<T>;
+
+    public:
+        // reading starts at the elements written after attaching, or with fromOldest_
+        // at the oldest still in the ring. False if there is no ring with that name, or
+        // it holds another element type
+        bool attach(const std::string& name_, bool fromOldest_ = false)
+        {
+            detach();
+            if (!_memory.open(name_))
+                return false;
+            const auto header = static_cast<const SharedRingHeader*>(_memory.data());
+            if (_memory.size() < sizeof(SharedRingHeader) ||
+                header->magic != g_sharedRingMagic || header->version != g_sharedRingVersion ||
+                header->elementSize != sizeof(T) || !header->capacity ||
+                _memory.size() < sharedRingSize(header->capacity, sizeof(Slot)))
+            {
+                _memory.close();
+                return false;
+            }
+
+            _header   = header;
+            _slots    = reinterpret_cast<const Slot*>(static_cast<const char*>(_memory.data()) + sizeof(SharedRingHeader));
+            _capacity = header->capacity;
+            const auto w = _header->writePos.load(std::memory_order_acquire);
+            _pos  = fromOldest_ ? w - std::min<uint64_t>(w, _capacity) : w;
+            _lost = 0;
+            return true;
+        }
+        void detach()
+        {
+            _memory.close();
+            _header = nullptr;
+            _slots  = nullptr;
+        }
+        bool isAttached() const
+        {
+            return _header != nullptr;
+        }
+
+        // number of elements written that this reader hasn't read yet, including those
+        // already overwritten
+        size_t available() const
+        {
+            return _header ? static_cast<size_t>(_header->writePos.load(std::memory_order_acquire) - _pos) : 0;
+        }
+        // read up to n_ elements into out_, returns the number read. Elements that were
+        // overwritten before they could be read are skipped and counted in getLost()
+        size_t read(T* out_, size_t n_)
+        {
+            if (!_header)
+                return 0;
+            size_t nRead = 0;
+            std::array<uint64_t, Slot::nWords> words;
+            while (nRead < n_)
+            {
+                const auto w = _header->writePos.load(std::memory_order_acquire);
+                if (_pos >= w)
+                    break;
+                if (w - _pos > _capacity)
+                {
+                    _lost += w - _capacity - _pos;
+                    _pos   = w - _capacity;
+                }
+
+                const Slot& slot = _slots[_pos & (_capacity - 1)];
+                const auto seq = slot.seq.load(std::memory_order_acquire);
+                if (seq == _pos + 1)
+                {
+                    for (size_t i = 0; i < Slot::nWords; i++)
+                        words[i] = slot.words[i].load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (slot.seq.load(std::memory_order_relaxed) == seq)
+                    {
+                        std::memcpy(static_cast<void*>(out_ + nRead), words.data(), sizeof(T));
+                        nRead++;
+                        _pos++;
+                        continue;
+                    }
+                }
+                // the writer has lapped us and is overwriting this slot
+                _lost++;
+                _pos++;
+            }
+            return nRead;
+        }
+        // same, appending to out_ (by default all available)
+        size_t read(std::vector<T>& out_, size_t n_ = static_cast<size_t>(-1))
+        {
+            const auto offset = out_.size();
+            out_.resize(offset + std::min({n_, available(), static_cast<size_t>(_capacity)}));
+            const auto nRead = read(out_.data() + offset, out_.size() - offset);
+            out_.resize(offset + nRead);
+            return nRead;
+        }
+
+        // position of the next element to read (number of elements written before it)
+        uint64_t getPosition() const
+        {
+            return _pos;
+        }
+        // elements lost because the writer overwrote them before they were read
+        uint64_t getLost() const
+        {
+            return _lost;
+        }
+
+    private:
+        SharedMemory                _memory;
+        const SharedRingHeader*     _header   = nullptr;
+        const Slot*                 _slots    = nullptr;
+        uint64_t                    _capacity = 0;
+        uint64_t                    _pos      = 0;
+        uint64_t                    _lost     = 0;
+    };
+}
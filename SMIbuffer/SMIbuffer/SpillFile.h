@@ -0,0 +1,112 @@
+#pragma once
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace SMIbuff
+{
+    // Temporary file used by the SpillToDisk overflow policy to hold the oldest part
+    // of a stream. Elements are appended at the end and read by index, as each reader
+    // of the stream has its own read position. Once all readers are done with the
+    // contents, the owner clears the file, which is then rewound and reused.
+    // Not thread safe, caller (ChunkedBuffer) serializes access.
+    template <typename T>
+    class SpillFile
+    {
+    public:
+        SpillFile() = default;
+        ~SpillFile()
+        {
+            if (_file.is_open())
+            {
+                _file.close();
+                std::error_code ec;
+                std::filesystem::remove(_path, ec);
+            }
+        }
+        SpillFile(const SpillFile&) = delete;
+        SpillFile& operator=(const SpillFile&) = delete;
+
+        // number of elements in the file. Safe to call from any thread
+        size_t size() const
+        {
+            return static_cast<size_t>(_writePos.load(std::memory_order_acquire));
+        }
+
+        // returns false if the file couldn't be created or written (e.g. disk full). The
+        // elements are then not in the file, and the next append writes at the same place
+        bool append(const T* data_, size_t n_)
+        {
+            if (!n_)
+                return true;
+            if (!_file.is_open() && !open())
+                return false;
+
+            const auto w = _writePos.load(std::memory_order_relaxed);
+            _file.seekp(static_cast<std::streamoff>(w * sizeof(T)));
+            _file.write(reinterpret_cast<const char*>(data_), n_ * sizeof(T));
+            _file.flush();
+            if (!_file.good())
+            {
+                _file.clear();
+                return false;
+            }
+            _writePos.store(w + n_, std::memory_order_release);
+            return true;
+        }
+
+        // read N elements starting at element index_ (or all till the end if less
+        // available). Returns number read, which is less if reading failed
+        size_t read(uint64_t index_, T* out_, size_t n_)
+        {
+            const auto w = _writePos.load(std::memory_order_relaxed);
+            if (index_ >= w)
+                return 0;
+            n_ = static_cast<size_t>(std::min<uint64_t>(n_, w - index_));
+            if (!n_)
+                return 0;
+            _file.seekg(static_cast<std::streamoff>(index_ * sizeof(T)));
+            _file.read(reinterpret_cast<char*>(out_), n_ * sizeof(T));
+            if (_file.good())
+                return n_;
+            const auto nRead = static_cast<size_t>(_file.gcount()) / sizeof(T);
+            _file.clear();
+            return nRead;
+        }
+
+        void clear()
+        {
+            _writePos.store(0, std::memory_order_release);
+        }
+
+    private:
+        bool open()
+        {
+            // called on the spill thread: no exceptions
+            std::error_code ec;
+            const auto dir = std::filesystem::temp_directory_path(ec);
+            if (ec)
+                return false;
+            // unique name per buffer instance
+            _path = dir / ("SMIbuffer_spill_" +
+                std::to_string(reinterpret_cast<uintptr_t>(this)) + "_" +
+                std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".bin");
+            _file.open(_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            if (_file.is_open())
+                return true;
+            _file.clear();
+            return false;
+        }
+
+    private:
+        std::filesystem::path   _path;
+        std::fstream            _file;
+        std::atomic<uint64_t>   _writePos{0};   // in elements
+    };
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "ChunkedBuffer.h"
+
+
+namespace SMIbuff
+{
+    // number of bins of the inter-callback interval histogram. Bin 0 counts intervals
+    // below 1 us, bin i intervals of [2^(i-1), 2^i) us, the last bin all longer ones
+    // (>= ~4.2 s)
+    constexpr size_t g_nIntervalBins = 24;
+
+    inline size_t intervalBin(uint64_t us_)
+    {
+        size_t bin = 0;
+        while (us_ && bin < g_nIntervalBins - 1)
+        {
+            us_ >>= 1;
+            bin++;
+        }
+        return bin;
+    }
+
+    // runtime statistics of a stream (samples or events): how the data source's callback
+    // was called and how long it took, and the statistics of the stream's buffer
+    struct StreamStats : BufferStats
+    {
+        uint64_t received              = 0;     // number of callbacks
+        uint64_t maxCallbackDuration   = 0;     // longest time spent storing an item (ns)
+        uint64_t totalCallbackDuration = 0;     // total time spent storing items (ns)
+        std::array<uint64_t, g_nIntervalBins> intervalHistogram{};  // time between the start of successive callbacks, see g_nIntervalBins
+    };
+
+    // delivery latency of samples: host arrival time minus the sample's timestamp in
+    // host time according to the clock model (see ClockSync). As the model's offset
+    // includes the fastest delivery, this is the delay on top of that
+    struct LatencyStats
+    {
+        uint64_t n     = 0;     // samples measured (all once there is a clock model)
+        uint64_t total = 0;     // sum of latencies (us)
+        uint64_t max   = 0;     // longest latency (us)
+        std::array<uint64_t, g_nIntervalBins> histogram{};  // bins as for StreamStats::intervalHistogram
+    };
+
+    struct Stats
+    {
+        StreamStats  samples;
+        StreamStats  events;
+        LatencyStats latency;
+    };
+
+    // callback counters of a stream. Only the callback thread records, so updates need
+    // no atomic read-modify-write, anyone can read them
+    class CallbackStats
+    {
+    public:
+        using clock_type = std::chrono::steady_clock;
+
+        void record(clock_type::time_point start_, clock_type::time_point end_)
+        {
+            const auto duration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end_ - start_).count());
+            increment(_received, 1);
+            increment(_totalDuration, duration);
+            if (duration > _maxDuration.load(std::memory_order_relaxed))
+                _maxDuration.store(duration, std::memory_order_relaxed);
+
+            const auto startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start_.time_since_epoch()).count();
+            const auto last = _lastStart.load(std::memory_order_relaxed);
+            _lastStart.store(startNs, std::memory_order_relaxed);
+            if (last == std::numeric_limits<int64_t>::min())
+                return;
+            increment(_histogram[intervalBin(static_cast<uint64_t>(std::max<int64_t>(startNs - last, 0)) / 1000)], 1);
+        }
+
+        void getStats(StreamStats& out_) const
+        {
+            out_.received              = _received.load(std::memory_order_relaxed);
+            out_.maxCallbackDuration   = _maxDuration.load(std::memory_order_relaxed);
+            out_.totalCallbackDuration = _totalDuration.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < g_nIntervalBins; i++)
+                out_.intervalHistogram[i] = _histogram[i].load(std::memory_order_relaxed);
+        }
+        // NB: racing with a callback, its update may get lost
+        void resetStats()
+        {
+            _received.store(0, std::memory_order_relaxed);
+            _maxDuration.store(0, std::memory_order_relaxed);
+            _totalDuration.store(0, std::memory_order_relaxed);
+            for (auto& bin : _histogram)
+                bin.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static void increment(std::atomic<uint64_t>& counter_, uint64_t amount_)
+        {
+            counter_.store(counter_.load(std::memory_order_relaxed) + amount_, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t>                              _received{0};
+        std::atomic<uint64_t>                              _maxDuration{0};
+        std::atomic<uint64_t>                              _totalDuration{0};
+        std::array<std::atomic<uint64_t>, g_nIntervalBins> _histogram{};
+        std::atomic<int64_t>                               _lastStart{std::numeric_limits<int64_t>::min()};   // ns, min: no callback yet
+    };
+    // latency counters, recorded by the sample callback like CallbackStats
+    class LatencyCounters
+    {
+    public:
+        void record(int64_t latency_)
+        {
+            const auto us = static_cast<uint64_t>(std::max<int64_t>(latency_, 0));
+            increment(_n, 1);
+            increment(_total, us);
+            if (us > _max.load(std::memory_order_relaxed))
+                _max.store(us, std::memory_order_relaxed);
+            increment(_histogram[intervalBin(us)], 1);
+        }
+
+        void getStats(LatencyStats& out_) const
+        {
+            out_.n     = _n.load(std::memory_order_relaxed);
+            out_.total = _total.load(std::memory_order_relaxed);
+            out_.max   = _max.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < g_nIntervalBins; i++)
+                out_.histogram[i] = _histogram[i].load(std::memory_order_relaxed);
+        }
+        // NB: racing with a callback, its update may get lost
+        void resetStats()
+        {
+            _n.store(0, std::memory_order_relaxed);
+            _total.store(0, std::memory_order_relaxed);
+            _max.store(0, std::memory_order_relaxed);
+            for (auto& bin : _histogram)
+                bin.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static void increment(std::atomic<uint64_t>& counter_, uint64_t amount_)
+        {
+            counter_.store(counter_.load(std::memory_order_relaxed) + amount_, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t>                              _n{0};
+        std::atomic<uint64_t>                              _total{0};
+        std::atomic<uint64_t>                              _max{0};
+        std::array<std::atomic<uint64_t>, g_nIntervalBins> _histogram{};
+    };
+}
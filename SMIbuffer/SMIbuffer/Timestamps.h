@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include "iViewXTypes.h"
+
+#include "ChunkedBuffer.h"
+
+
+namespace SMIbuff
+{
+    // timestamps used for the time range queries. For events, that is the start time
+    template <>
+    struct TimestampOf<SampleStruct>
+    {
+        static int64_t get(const SampleStruct& item_)
+        {
+            return item_.timestamp;
+        }
+    };
+    template <>
+    struct TimestampOf<EventStruct>
+    {
+        static int64_t get(const EventStruct& item_)
+        {
+            return item_.startTime;
+        }
+    };
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <cstddef>
+#include "iViewXTypes.h"
+
+#include "SampleColumns.h"
+
+
+namespace SMIbuff
+{
+    // per-sample transform, applied to the gaze position of both eyes
+    enum class TransformType
+    {
+        Offset,             // subtract (x, y), e.g. to correct for a screen offset
+        PixelsToDegrees,    // (gaze - (x, y)) / pixelsPerDegree, (x, y) being e.g. the screen centre
+        Smooth,             // causal moving average over the last window samples
+        AverageEyes         // both eyes get the mean of the two, or the one eye with data
+    };
+
+    struct TransformStage
+    {
+        TransformType type      = TransformType::Offset;
+        double  x               = 0.;       // pixels (Offset, PixelsToDegrees)
+        double  y               = 0.;
+        double  pixelsPerDegree = 40.;      // (PixelsToDegrees)
+        size_t  window          = 3;        // samples (Smooth)
+
+        bool isValid() const
+        {
+            switch (type)
+            {
+            case TransformType::PixelsToDegrees:
+                return pixelsPerDegree > 0.;
+            case TransformType::Smooth:
+                return window > 0;
+            default:
+                return true;
+            }
+        }
+    };
+
+    // Applies a list of stages, in order, to batches of samples stored as columns.
+    // Each stage is a loop over contiguous gaze columns without dependencies between
+    // iterations, so that the compiler can vectorize it. State is carried over between
+    // batches (the smoothing history), so successive batches must be successive samples.
+    // Lost data (both gaze coordinates 0 in the raw samples) is NaN after transforming,
+    // as (0, 0) is a valid position once offset or converted to degrees. Smoothing skips
+    // lost samples, and doesn't fill them in
+    class TransformPipeline
+    {
+    public:
+        explicit TransformPipeline(std::vector<TransformStage> stages_) :
+            _stages(std::move(stages_)),
+            _history(_stages.size())
+        {}
+
+        void apply(SampleColumns& samples_)
+        {
+            const size_t n = samples_.size();
+            markLost(samples_.leftEye.gazeX.data(),  samples_.leftEye.gazeY.data(),  n);
+            markLost(samples_.rightEye.gazeX.data(), samples_.rightEye.gazeY.data(), n);
+
+            for (size_t s = 0; s < _stages.size(); s++)
+            {
+                const auto& stage = _stages[s];
+                switch (stage.type)
+                {
+                case TransformType::Offset:
+                    for (auto* eye : { &samples_.leftEye, &samples_.rightEye })
+                    {
+                        affine(eye->gazeX.data(), n, 1., -stage.x);
+                        affine(eye->gazeY.data(), n, 1., -stage.y);
+                    }
+                    break;
+                case TransformType::PixelsToDegrees:
+                    for (auto* eye : { &samples_.leftEye, &samples_.rightEye })
+                    {
+                        const double scale = 1. / stage.pixelsPerDegree;
+                        affine(eye->gazeX.data(), n, scale, -stage.x * scale);
+                        affine(eye->gazeY.data(), n, scale, -stage.y * scale);
+                    }
+                    break;
+                case TransformType::Smooth:
+                    smooth(samples_.leftEye.gazeX,  _history[s][0], stage.window);
+                    smooth(samples_.leftEye.gazeY,  _history[s][1], stage.window);
+                    smooth(samples_.rightEye.gazeX, _history[s][2], stage.window);
+                    smooth(samples_.rightEye.gazeY, _history[s][3], stage.window);
+                    break;
+                case TransformType::AverageEyes:
+                    average(samples_.leftEye.gazeX.data(), samples_.rightEye.gazeX.data(), n);
+                    average(samples_.leftEye.gazeY.data(), samples_.rightEye.gazeY.data(), n);
+                    break;
+                }
+            }
+        }
+
+        const std::vector<TransformStage>& getStages() const
+        {
+            return _stages;
+        }
+
+    private:
+        static constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+        // NB: the kernels below are written such that GCC and MSVC vectorize them: selects
+        // instead of branches, NaN tested as x != x, and no conditional division
+        static void markLost(double* __restrict x_, double* __restrict y_, size_t n_)
+        {
+            for (size_t i = 0; i < n_; i++)
+            {
+                const bool lost = (x_[i] == 0.) & (y_[i] == 0.);
+                x_[i] = lost ? nan : x_[i];
+                y_[i] = lost ? nan : y_[i];
+            }
+        }
+
+        static void affine(double* __restrict v_, size_t n_, double scale_, double offset_)
+        {
+            for (size_t i = 0; i < n_; i++)
+                v_[i] = v_[i] * scale_ + offset_;
+        }
+
+        static void average(double* __restrict l_, double* __restrict r_, size_t n_)
+        {
+            for (size_t i = 0; i < n_; i++)
+            {
+                const double l = l_[i], r = r_[i];
+                const double m = ((l == l ? l : r) + (r == r ? r : l)) * .5;
+                l_[i] = m;
+                r_[i] = m;
+            }
+        }
+
+        // history_ holds the last window_-1 raw values of the previous batch
+        static void smooth(std::vector<double>& v_, std::vector<double>& history_, size_t window_)
+        {
+            const size_t n = v_.size();
+            if (!n || window_ < 2)
+                return;
+            const size_t nHist = window_ - 1;
+            if (history_.size() != nHist)
+                history_.assign(nHist, nan);
+
+            // input as one contiguous run: history, then this batch. The last window_-1
+            // values become the history for the next batch. Lost samples contribute 0 to
+            // the sum and the count
+            std::vector<double> val(nHist + n), valid(nHist + n);
+            std::copy(history_.begin(), history_.end(), val.begin());
+            std::copy(v_.begin(), v_.end(), val.begin() + nHist);
+            std::copy(val.end() - nHist, val.end(), history_.begin());
+            for (size_t i = 0; i < val.size(); i++)
+            {
+                const double v = val[i];
+                valid[i] = v == v ? 1. : 0.;
+                val[i]   = v == v ? v : 0.;
+            }
+
+            // window sums, accumulated one offset at a time so that each pass runs over
+            // the whole batch
+            std::vector<double> sum(n, 0.), count(n, 0.);
+            for (size_t k = 0; k < window_; k++)
+            {
+                const double* __restrict in  = val.data() + k;
+                const double* __restrict inV = valid.data() + k;
+                double* __restrict s = sum.data();
+                double* __restrict c = count.data();
+                for (size_t i = 0; i < n; i++)
+                {
+                    s[i] += in[i];
+                    c[i] += inV[i];
+                }
+            }
+            double* __restrict out = v_.data();
+            const double* __restrict self = valid.data() + nHist;
+            for (size_t i = 0; i < n; i++)
+                out[i] = sum[i] / count[i] + (self[i] != 0. ? 0. : nan);
+        }
+
+    private:
+        std::vector<TransformStage>                     _stages;
+        std::vector<std::array<std::vector<double>, 4>> _history;   // per stage: smoothing history of left x, y, right x, y
+    };
+}
@@ -0,0 +1,38 @@
+#pragma once
+// sample and event types. These come from the iViewX SDK, unless building without it
+// (SMIBUFFER_NO_IVIEWX, e.g. on Linux), in which case they are defined here with the
+// same layout as the SDK's
+#ifdef SMIBUFFER_NO_IVIEWX
+
+struct EyeDataStruct
+{
+    double gazeX;
+    double gazeY;
+    double diam;
+    double eyePositionX;
+    double eyePositionY;
+    double eyePositionZ;
+};
+
+struct SampleStruct
+{
+    long long timestamp;
+    EyeDataStruct leftEye;
+    EyeDataStruct rightEye;
+    int planeNumber;
+};
+
+struct EventStruct
+{
+    char eventType;
+    char eye;
+    long long startTime;
+    long long endTime;
+    long long duration;
+    double positionX;
+    double positionY;
+};
+
+#else
+#   include <iViewXAPI.h>
+#endif
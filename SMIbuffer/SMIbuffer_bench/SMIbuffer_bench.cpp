@@ -0,0 +1,556 @@
+// benchmarks for the SMIbuffer storage engine
+// 1. push contention: a producer thread stands in for the SDK callback thread and
+//    pushes samples at a fixed rate, while reader threads hammer the buffer with
+//    peek(1) and consume(), like a stimulus loop polling every frame would (only much
+//    harder). Reports the distribution of the time the producer spends per push, for
+//    the lock-free ChunkedBuffer and for the previous mutex-protected std::vector
+//    storage.
+// 2. end-to-end: the same, but driving a whole SMIbuffer through its data source
+//    callbacks. Reports, for every sample, the time from the callback being called
+//    until a polling thread first got it from the buffer (and how many of the produced
+//    samples were measured), and how long peekSamples(1) and getLatestSample() take
+//    under this load. Latencies are only meaningful with a core for each thread
+//    (producer, poller and nReaders-1 other readers).
+// 3. consume throughput of SMIbuffer::consumeSamples() in batches of various sizes.
+// 4. the cost of exporting a large number of samples: to one array per field (what
+//    the MATLAB wrapper does) for the record and column sample layouts and some of the
+//    compact sample profiles, and to a single record array (what the Python wrapper's
+//    ...Array functions do).
+// 5. the compressed tier of the Compress overflow policy: compression ratio, and the
+//    cost of compressing samples and of reading them back.
+// If a results file is given, all results are also written there as JSON, for
+// comparison between builds.
+//
+// usage: SMIbuffer_bench [durationSeconds=5] [sampleRateHz=2000] [nReaders=3] [nExportSamples=1000000] [resultsFile]
+#include "SMIbuffer/SMIbuffer.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock clock_type;
+
+    // previous storage engine: vector guarded by a reader/writer lock
+    template <typename T>
+    class LockedVector
+    {
+    public:
+        void reserve(size_t capacity_)
+        {
+            std::unique_lock<std::shared_timed_mutex> l(_m);
+            _buf.reserve(capacity_);
+        }
+        void push(const T& item_)
+        {
+            std::unique_lock<std::shared_timed_mutex> l(_m);
+            _buf.push_back(item_);
+        }
+        std::vector<T> peek(size_t lastN_)
+        {
+            std::shared_lock<std::shared_timed_mutex> l(_m);
+            return std::vector<T>(_buf.end() - std::min(_buf.size(), lastN_), _buf.end());
+        }
+        std::vector<T> consume(size_t firstN_)
+        {
+            std::unique_lock<std::shared_timed_mutex> l(_m);
+            if (firstN_ >= _buf.size())
+                return std::vector<T>(std::move(_buf));
+            std::vector<T> out(_buf.begin(), _buf.begin() + firstN_);
+            _buf.erase(_buf.begin(), _buf.begin() + firstN_);
+            return out;
+        }
+
+    private:
+        std::vector<T>          _buf;
+        std::shared_timed_mutex _m;
+    };
+
+    struct Settings
+    {
+        double      duration    = 5.;
+        double      sampleRate  = 2000.;
+        int         nReaders    = 3;
+        size_t      nExport     = 1000000;
+        std::string resultsFile;
+    };
+
+    // collects results for machine-readable output
+    class Results
+    {
+    public:
+        void add(const std::string& name_, const std::string& metric_, double value_, const char* unit_)
+        {
+            _entries.push_back({name_, metric_, value_, unit_});
+        }
+        bool write(const std::string& file_, const Settings& settings_) const
+        {
+            auto f = std::fopen(file_.c_str(), "w");
+            if (!f)
+                return false;
+            std::fprintf(f, "{\n  \"settings\": {\"durationSeconds\": %g, \"sampleRateHz\": %g, \"nReaders\": %d, \"nExportSamples\": %zu},\n  \"results\": [",
+                settings_.duration, settings_.sampleRate, settings_.nReaders, settings_.nExport);
+            for (size_t i = 0; i < _entries.size(); i++)
+                std::fprintf(f, "%s\n    {\"name\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}",
+                    i ? "," : "", _entries[i].name.c_str(), _entries[i].metric.c_str(), _entries[i].value, _entries[i].unit);
+            std::fprintf(f, "\n  ]\n}\n");
+            return std::fclose(f) == 0;
+        }
+
+    private:
+        struct Entry
+        {
+            std::string name;
+            std::string metric;
+            double      value;
+            const char* unit;
+        };
+        std::vector<Entry> _entries;
+    };
+
+    // busy wait till next sample is due, sleep isn't accurate enough
+    void waitUntil(clock_type::time_point t_)
+    {
+        while (clock_type::now() < t_)
+            ;
+    }
+    clock_type::duration sampleInterval(double sampleRate_)
+    {
+        return std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1. / sampleRate_));
+    }
+
+    template <typename Buffer>
+    std::vector<double> run(const Settings& settings_)
+    {
+        Buffer buf;
+        buf.reserve(SMIbuff::g_sampleBufDefaultSize);
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < settings_.nReaders; r++)
+        {
+            // first reader consumes every now and then, the others only peek
+            readers.emplace_back([&buf, &stop, r]()
+            {
+                size_t i = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    if (r == 0 && ++i % 64 == 0)
+                        buf.consume(SMIbuff::g_consumeDefaultAmount);
+                    else
+                        buf.peek(SMIbuff::g_peekDefaultAmount);
+                }
+            });
+        }
+
+        const auto nSamples = static_cast<size_t>(settings_.duration * settings_.sampleRate);
+        const auto interval = sampleInterval(settings_.sampleRate);
+        std::vector<double> pushDurations;
+        pushDurations.reserve(nSamples);
+
+        SampleStruct samp{};
+        auto next = clock_type::now();
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            waitUntil(next);
+            next += interval;
+
+            samp.timestamp = static_cast<long long>(i);
+            const auto t0 = clock_type::now();
+            buf.push(samp);
+            const auto t1 = clock_type::now();
+            pushDurations.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        }
+
+        stop = true;
+        for (auto& t : readers)
+            t.join();
+        return pushDurations;
+    }
+
+    // stands in for the SDK: calls SMIbuffer's sample callback from the thread calling
+    // emit(). Callbacks must only be changed while nothing is being emitted
+    class BenchSource : public SMIbuff::DataSource
+    {
+    public:
+        int setSampleCallback(SampleCallback callback_) override
+        {
+            _sampleCallback = std::move(callback_);
+            return SMIbuff::g_sourceSuccess;
+        }
+        int setEventCallback(EventCallback) override
+        {
+            return SMIbuff::g_sourceSuccess;
+        }
+
+        void emit(const SampleStruct& sample_)
+        {
+            _sampleCallback(sample_);
+        }
+
+    private:
+        SampleCallback _sampleCallback;
+    };
+
+    struct EndToEndResult
+    {
+        std::vector<double> visibility;     // us from callback till first returned to the poller, per sample
+        size_t              nProduced = 0;
+        std::vector<double> peek;           // us per peekSamples(1) call
+        std::vector<double> latest;         // us per getLatestSample() call
+    };
+
+    // drives a SMIbuffer through its sample callback at the set rate. Timestamps are
+    // the time of the callback (ns since start), so a polling thread can see how long
+    // it took for each sample to become visible: every poll it consumes all new samples
+    // through its own reader, so each sample is matched to the first poll that got it.
+    // Other readers add load like in run()
+    EndToEndResult runEndToEnd(const Settings& settings_)
+    {
+        auto source = std::make_shared<BenchSource>();
+        SMIbuffer smib(false, source);
+        smib.startSampleBuffering();
+        constexpr const char* visibilityReader = "bench_visibility";
+        smib.addSampleReader(visibilityReader);
+
+        const auto nSamples = static_cast<size_t>(settings_.duration * settings_.sampleRate);
+
+        const auto start = clock_type::now();
+        auto sinceStart = [start]() { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count(); };
+
+        std::atomic<bool> stop{false};
+        EndToEndResult result;
+        result.visibility.reserve(nSamples);
+        std::thread poller([&]()
+        {
+            std::vector<SampleStruct> seen(4096);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                const auto t0 = clock_type::now();
+                const auto samp = smib.peekSamples(1);
+                const auto t1 = clock_type::now();
+                result.peek.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                SampleStruct latest;
+                const auto t2 = clock_type::now();
+                smib.getLatestSample(latest);
+                result.latest.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - t2).count());
+
+                // everything that arrived since the last poll became visible between then
+                // and now. Now is when the consume returns, so this is an upper bound
+                size_t n;
+                while ((n = smib.consumeSamplesInto(seen.data(), seen.size(), visibilityReader)) > 0)
+                {
+                    const auto seenAt = sinceStart();
+                    for (size_t i = 0; i < n; i++)
+                        result.visibility.push_back((seenAt - seen[i].timestamp) / 1000.);
+                }
+            }
+        });
+        std::vector<std::thread> readers;
+        for (int r = 1; r < settings_.nReaders; r++)
+        {
+            readers.emplace_back([&smib, &stop, r]()
+            {
+                size_t i = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    if (r == 1 && ++i % 64 == 0)
+                        smib.consumeSamples();
+                    else
+                        smib.peekSamples();
+                }
+            });
+        }
+
+        const auto interval = sampleInterval(settings_.sampleRate);
+        SampleStruct samp{};
+        auto next = clock_type::now();
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            waitUntil(next);
+            next += interval;
+
+            samp.timestamp = sinceStart();
+            source->emit(samp);
+        }
+        result.nProduced = nSamples;
+
+        // give the poller a chance to see the last sample
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stop = true;
+        poller.join();
+        for (auto& t : readers)
+            t.join();
+        smib.stopSampleBuffering(true);
+        return result;
+    }
+
+    // returns consumed samples per second when consuming nSamples_ in batches of batchSize_
+    double runConsume(size_t nSamples_, size_t batchSize_)
+    {
+        auto source = std::make_shared<BenchSource>();
+        SMIbuffer smib(false, source);
+        smib.startSampleBuffering(nSamples_);
+        SampleStruct samp{};
+        for (size_t i = 0; i < nSamples_; i++)
+        {
+            samp.timestamp = static_cast<long long>(i);
+            source->emit(samp);
+        }
+
+        size_t n = 0;
+        const auto t0 = clock_type::now();
+        while (n < nSamples_)
+            n += smib.consumeSamples(batchSize_).size();
+        const auto dur = std::chrono::duration<double>(clock_type::now() - t0).count();
+        smib.stopSampleBuffering(true);
+        return static_cast<double>(n) / dur;
+    }
+
+    // export benchmark. Output arrays stand in for mxCreateUninitNumericMatrix
+    template <typename T>
+    std::unique_ptr<T[]> newColumn(size_t n_)
+    {
+        return std::unique_ptr<T[]>(new T[n_]);
+    }
+    template <typename T>
+    void exportColumn(const std::vector<T>& col_)
+    {
+        auto out = newColumn<T>(col_.size());
+        std::memcpy(out.get(), col_.data(), col_.size() * sizeof(T));
+    }
+    // previous export path: gather each field from a by-value copy of the samples
+    template <typename O, typename T>
+    void exportFieldByValue(std::vector<SampleStruct> data_, T O::*field_)
+    {
+        auto out = newColumn<T>(data_.size());
+        size_t i = 0;
+        for (auto& samp : data_)
+            out[i++] = samp.*field_;
+    }
+    template <typename T>
+    void exportEyeFieldByValue(std::vector<SampleStruct> data_, EyeDataStruct SampleStruct::*eye_, T EyeDataStruct::*field_)
+    {
+        auto out = newColumn<T>(data_.size());
+        size_t i = 0;
+        for (auto& samp : data_)
+            out[i++] = samp.*eye_.*field_;
+    }
+
+    enum class ExportPath
+    {
+        RecordsByValue,     // consume SampleStructs, gather fields from by-value copies (previous MATLAB export)
+        Columns,            // consume to SampleColumns, memcpy each column
+        ColumnsGaze,        // as Columns, but only timestamp and gaze position (field projection)
+        RecordArray         // consume SampleStructs, memcpy into one record array (Python wrapper's numpy export)
+    };
+
+    // returns duration in ms of consuming and exporting n samples (best of a few runs)
+    template <typename Layout>
+    double runExport(size_t nSamples_, ExportPath path_)
+    {
+        double best = 0.;
+        for (int rep = 0; rep < 5; rep++)
+        {
+            SMIbuff::ChunkedBuffer<SampleStruct, Layout> buf;
+            buf.reserve(nSamples_);
+            SampleStruct samp{};
+            for (size_t i = 0; i < nSamples_; i++)
+            {
+                samp.timestamp = static_cast<long long>(i);
+                samp.leftEye.gazeX = samp.rightEye.gazeX = static_cast<double>(i);
+                buf.push(samp);
+            }
+
+            const auto t0 = clock_type::now();
+            if (path_ == ExportPath::RecordsByValue)
+            {
+                const auto data = buf.consume(nSamples_);
+                exportFieldByValue(data, &SampleStruct::timestamp);
+                for (auto eye : {&SampleStruct::leftEye, &SampleStruct::rightEye})
+                    for (auto field : {&EyeDataStruct::gazeX, &EyeDataStruct::gazeY, &EyeDataStruct::diam, &EyeDataStruct::eyePositionX, &EyeDataStruct::eyePositionY, &EyeDataStruct::eyePositionZ})
+                        exportEyeFieldByValue(data, eye, field);
+            }
+            else if (path_ == ExportPath::RecordArray)
+                exportColumn(buf.consume(nSamples_));
+            else
+            {
+                const SMIbuff::SampleFieldMask fields = path_ == ExportPath::ColumnsGaze ?
+                    SMIbuff::SampleField::Timestamp | SMIbuff::SampleField::LeftGazeX | SMIbuff::SampleField::LeftGazeY | SMIbuff::SampleField::RightGazeX | SMIbuff::SampleField::RightGazeY :
+                    SMIbuff::SampleField::All;
+                const auto data = buf.consumeColumns(nSamples_, SMIbuff::g_defaultReader, SMIbuff::SampleColumns(fields));
+                exportColumn(data.timestamp);
+                for (auto eye : {&data.leftEye, &data.rightEye})
+                    for (auto field : {&SMIbuff::EyeDataColumns::gazeX, &SMIbuff::EyeDataColumns::gazeY, &SMIbuff::EyeDataColumns::diam, &SMIbuff::EyeDataColumns::eyePositionX, &SMIbuff::EyeDataColumns::eyePositionY, &SMIbuff::EyeDataColumns::eyePositionZ})
+                        if (!(eye->*field).empty())     // not selected
+                            exportColumn(eye->*field);
+            }
+            const auto dur = std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+            if (!rep || dur < best)
+                best = dur;
+        }
+        return best;
+    }
+
+    // compressed tier. Samples resemble a recording at 2 kHz: fixations with noise,
+    // jumps between them and stretches of lost tracking. They are compressed in batches,
+    // as the spill thread would, and then all read back at once
+    struct CompressResult
+    {
+        double ratio;       // uncompressed / compressed size
+        double encode;      // ms
+        double decode;      // ms
+    };
+    CompressResult runCompress(size_t nSamples_)
+    {
+        std::mt19937 rng(1);
+        std::normal_distribution<double> noise(0., .3);
+        std::vector<SampleStruct> data(nSamples_);
+        double x = 0., y = 0.;
+        for (size_t i = 0; i < nSamples_; i++)
+        {
+            auto& samp = data[i];
+            samp = SampleStruct{};
+            samp.timestamp = static_cast<long long>(i) * 500;
+            if (i % 400 == 0)
+            {
+                x = 200. + rng() % 1500;
+                y = 100. + rng() % 900;
+            }
+            if (i % 10000 >= 9800)
+                continue;
+            for (auto eye : {&samp.leftEye, &samp.rightEye})
+            {
+                eye->gazeX = x + noise(rng);
+                eye->gazeY = y + noise(rng);
+                eye->diam  = 4. + noise(rng) / 100.;
+                eye->eyePositionX = 30. + noise(rng);
+                eye->eyePositionY = 10. + noise(rng);
+                eye->eyePositionZ = 600. + noise(rng);
+            }
+        }
+
+        SMIbuff::CompressedStore<SampleStruct> store;
+        auto t0 = clock_type::now();
+        for (size_t i = 0; i < nSamples_; i += SMIbuff::g_chunkSize)
+            store.append(data.data() + i, std::min(SMIbuff::g_chunkSize, nSamples_ - i));
+        CompressResult result;
+        result.encode = std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+        result.ratio  = static_cast<double>(nSamples_ * sizeof(SampleStruct)) / static_cast<double>(std::max<size_t>(store.memoryUsage(), 1));
+
+        std::vector<SampleStruct> out(nSamples_);
+        t0 = clock_type::now();
+        store.read(0, out.data(), out.size());
+        result.decode = std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+        return result;
+    }
+
+    double percentile(const std::vector<double>& sorted_, double p_)
+    {
+        if (sorted_.empty())
+            return 0.;
+        const auto idx = static_cast<size_t>(p_ / 100. * (sorted_.size() - 1) + .5);
+        return sorted_[std::min(idx, sorted_.size() - 1)];
+    }
+
+    void report(Results& results_, const std::string& name_, std::vector<double> durations_, const char* what_)
+    {
+        std::sort(durations_.begin(), durations_.end());
+        const double p[] = {50., 90., 99., 99.9};
+        const char*  metric[] = {"p50", "p90", "p99", "p99.9"};
+        std::printf("%-24s n=%-8zu", name_.c_str(), durations_.size());
+        for (size_t i = 0; i < 4; i++)
+        {
+            std::printf(" %s=%8.3f", metric[i], percentile(durations_, p[i]));
+            results_.add(name_, metric[i], percentile(durations_, p[i]), "us");
+        }
+        const auto max = durations_.empty() ? 0. : durations_.back();
+        std::printf(" max=%9.3f (us %s)\n", max, what_);
+        results_.add(name_, "max", max, "us");
+        results_.add(name_, "n", static_cast<double>(durations_.size()), "count");
+    }
+
+    template <typename Layout>
+    void reportExport(Results& results_, const Settings& settings_, const char* name_, ExportPath path_)
+    {
+        const auto dur = runExport<Layout>(settings_.nExport, path_);
+        const auto perMillion = dur * 1e6 / static_cast<double>(settings_.nExport);
+        std::printf("%-30s %9.3f ms (%9.3f ms per million)\n", name_, dur, perMillion);
+        results_.add(std::string("export/") + name_, "perMillion", perMillion, "ms");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    if (argc > 1)
+        settings.duration   = std::atof(argv[1]);
+    if (argc > 2)
+        settings.sampleRate = std::atof(argv[2]);
+    if (argc > 3)
+        settings.nReaders   = std::atoi(argv[3]);
+    if (argc > 4)
+        settings.nExport    = static_cast<size_t>(std::atof(argv[4]));
+    if (argc > 5)
+        settings.resultsFile = argv[5];
+    Results results;
+
+    std::printf("%.1f s at %.0f Hz, %d reader threads\n", settings.duration, settings.sampleRate, settings.nReaders);
+    report(results, "push/LockedVector",  run<LockedVector<SampleStruct>>(settings), "per push");
+    report(results, "push/ChunkedBuffer", run<SMIbuff::ChunkedBuffer<SampleStruct>>(settings), "per push");
+
+    std::printf("\nSMIbuffer driven through its sample callback\n");
+    auto endToEnd = runEndToEnd(settings);
+    std::printf("%zu of %zu samples measured\n", endToEnd.visibility.size(), endToEnd.nProduced);
+    results.add("callbackToVisible", "produced", static_cast<double>(endToEnd.nProduced), "count");
+    report(results, "callbackToVisible", std::move(endToEnd.visibility), "till visible");
+    report(results, "peekSamples(1)",    std::move(endToEnd.peek), "per call");
+    report(results, "getLatestSample",   std::move(endToEnd.latest), "per call");
+
+    std::printf("\nconsumeSamples of %zu samples in batches\n", settings.nExport);
+    for (size_t batch : {size_t(1), size_t(64), size_t(4096), size_t(65536), SMIbuff::g_consumeDefaultAmount})
+    {
+        const auto rate = runConsume(settings.nExport, batch);
+        const auto name = "consume/" + (batch == SMIbuff::g_consumeDefaultAmount ? std::string("all") : std::to_string(batch));
+        std::printf("%-24s %9.3f Msamples/s\n", name.c_str(), rate / 1e6);
+        results.add(name, "throughput", rate / 1e6, "Msamples/s");
+    }
+
+    std::printf("\nconsume and export of %zu samples (best of 5)\n", settings.nExport);
+    reportExport<SMIbuff::RowLayout<SampleStruct>>(results, settings, "records, by-value gather", ExportPath::RecordsByValue);
+    reportExport<SMIbuff::RowLayout<SampleStruct>>(results, settings, "records, to columns",      ExportPath::Columns);
+    reportExport<SMIbuff::SampleColumnLayout>     (results, settings, "columns, to columns",      ExportPath::Columns);
+    reportExport<SMIbuff::CompactSampleLayout<SMIbuff::SampleEyes::Binocular, float, true>>(results, settings, "binocular float, to columns", ExportPath::Columns);
+    reportExport<SMIbuff::CompactSampleLayout<SMIbuff::SampleEyes::Left, float, false>>    (results, settings, "monocular float, to columns", ExportPath::Columns);
+    reportExport<SMIbuff::SampleColumnLayout>     (results, settings, "columns, gaze only",       ExportPath::ColumnsGaze);
+    reportExport<SMIbuff::CompactSampleLayout<SMIbuff::SampleEyes::Binocular, float, true>>(results, settings, "binocular float, gaze only", ExportPath::ColumnsGaze);
+    reportExport<SMIbuff::RowLayout<SampleStruct>>(results, settings, "records, to record array",  ExportPath::RecordArray);
+
+    std::printf("\ncompressed tier, %zu samples\n", settings.nExport);
+    const auto compress = runCompress(settings.nExport);
+    const auto million  = 1e6 / static_cast<double>(settings.nExport);
+    std::printf("%-30s %9.3f\n", "compression ratio", compress.ratio);
+    std::printf("%-30s %9.3f ms (%9.3f ms per million)\n", "compress", compress.encode, compress.encode * million);
+    std::printf("%-30s %9.3f ms (%9.3f ms per million)\n", "decompress", compress.decode, compress.decode * million);
+    results.add("compress", "ratio", compress.ratio, "x");
+    results.add("compress", "encodePerMillion", compress.encode * million, "ms");
+    results.add("compress", "decodePerMillion", compress.decode * million, "ms");
+
+    if (!settings.resultsFile.empty() && !results.write(settings.resultsFile, settings))
+    {
+        std::fprintf(stderr, "could not write results to %s\n", settings.resultsFile.c_str());
+        return 1;
+    }
+    return 0;
+}
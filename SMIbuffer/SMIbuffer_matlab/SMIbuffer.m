@@ -62,10 +62,40 @@ classdef SMIbuffer < handle
         end
 
         %% methods
-        function success = startSampleBuffering(this,initialBufferSize)
-            % optional buffer size input
-            if nargin>1
-                success = this.mexHndl('startSampleBuffering',uint64(initialBufferSize));
+        function success = startSampleBuffering(this,bufferSize,overflowPolicy,sampleLayout,sampleProfile)
+            % optional buffer size input. Optional overflow policy input
+            % determines what happens when the buffer is full:
+            % 'grow' (default): buffer grows, bufferSize is initial size
+            % 'dropOldest', 'dropNewest': buffer has fixed capacity
+            %   bufferSize, oldest or newest data is discarded
+            % 'spillToDisk': buffer has fixed capacity bufferSize, oldest
+            %   data is moved to a temporary file. It is returned first
+            %   when consuming
+            % 'compress': as 'spillToDisk', but oldest data is compressed
+            %   (losslessly) and kept in memory. bufferSize recent items
+            %   are kept uncompressed. Noisy samples only compress to
+            %   about 3/4 of their size
+            % Optional sample layout input determines how samples are
+            % stored: 'records' (default) or 'columns'. 'columns' makes
+            % consumeSamples and peekSamples faster for large numbers of
+            % samples. Changing the layout empties the buffer.
+            % Optional sample profile input selects what of each sample
+            % is stored, to save memory. Struct with optional fields:
+            % eyes: 'binocular' (default), 'left' or 'right'
+            % precision: 'double' (default) or 'single', for gaze, pupil
+            %   diameter and eye position
+            % eyePosition: true (default) or false
+            % Data not stored is returned as 0. Anything but the default
+            % profile is stored as 'columns'. Changing the profile
+            % empties the buffer
+            if nargin>4
+                success = this.mexHndl('startSampleBuffering',uint64(bufferSize),char(overflowPolicy),char(sampleLayout),sampleProfile);
+            elseif nargin>3
+                success = this.mexHndl('startSampleBuffering',uint64(bufferSize),char(overflowPolicy),char(sampleLayout));
+            elseif nargin>2
+                success = this.mexHndl('startSampleBuffering',uint64(bufferSize),char(overflowPolicy));
+            elseif nargin>1
+                success = this.mexHndl('startSampleBuffering',uint64(bufferSize));
             else
                 success = this.mexHndl('startSampleBuffering');
             end
@@ -82,29 +112,137 @@ classdef SMIbuffer < handle
                 this.mexHndl('stopSampleBuffering');
             end
         end
-        function data = consumeSamples(this,firstN)
+        function data = consumeSamples(this,firstN,reader,fields)
             % optional input indicating how many samples to read from the
-            % beginning of buffer. Default: all
-            if nargin>1
+            % beginning of buffer. Default: all (also when empty).
+            % Optional input indicating which reader consumes, see
+            % addSampleReader. Default: the default reader.
+            % Optional input selecting the fields to output, only those
+            % are copied and converted: cell array of field names, e.g.
+            % {'timestamp','gazeX','gazeY'} ('gazeX' is that field for
+            % both eyes, 'leftEye.gazeX' only for the left eye,
+            % 'leftEye' all fields of the left eye), or a uint32
+            % bitmask. Default: all. Pass [] to skip an input
+            if nargin>3
+                data = this.mexHndl('consumeSamples',uint64(firstN),char(reader),fields);
+            elseif nargin>2
+                data = this.mexHndl('consumeSamples',uint64(firstN),char(reader));
+            elseif nargin>1
                 data = this.mexHndl('consumeSamples',uint64(firstN));
             else
                 data = this.mexHndl('consumeSamples');
             end
         end
-        function data = peekSamples(this,lastN)
+        function data = peekSamples(this,lastN,fields)
             % optional input indicating how many samples to read from the
-            % end of buffer. Default: 1
-            if nargin>1
+            % end of buffer. Default: 1. Optional fields input as for
+            % consumeSamples
+            if nargin>2
+                data = this.mexHndl('peekSamples',uint64(lastN),fields);
+            elseif nargin>1
                 data = this.mexHndl('peekSamples',uint64(lastN));
             else
                 data = this.mexHndl('peekSamples');
             end
         end
-        
-        function success = startEventBuffering(this,initialBufferSize)
-            % optional buffer size input
+        function [sample,arrivalTime] = getLatestSample(this)
+            % newest sample, as [timestamp leftGazeX leftGazeY rightGazeX
+            % rightGazeY] (empty if no sample received yet). Much cheaper
+            % than peekSamples, for use on each frame of e.g. a
+            % gaze-contingent display. Available while buffering samples,
+            % whatever the sample profile, and not affected by clearing
+            % the buffer. Optional second output: when the sample arrived,
+            % in host time (int64, us, see getHostTime)
+            if nargout>1
+                [sample,arrivalTime] = this.mexHndl('getLatestSample');
+            else
+                sample = this.mexHndl('getLatestSample');
+            end
+        end
+        function success = waitForSamples(this,n,timeout,reader)
+            % wait, without polling, until n samples are available
+            % (optional reader input as for consumeSamples), for at most
+            % timeout ms. Returns false on timeout. NB: MATLAB is
+            % unresponsive while waiting, so keep timeouts short
+            if nargin>3
+                success = this.mexHndl('waitForSamples',uint64(n),uint32(timeout),char(reader));
+            else
+                success = this.mexHndl('waitForSamples',uint64(n),uint32(timeout));
+            end
+        end
+        function success = waitForTimestamp(this,t,timeout)
+            % wait until a sample with timestamp >= t arrives, for at
+            % most timeout ms. Returns false on timeout
+            success = this.mexHndl('waitForTimestamp',int64(t),uint32(timeout));
+        end
+        function data = peekSamplesRange(this,tStart,tEnd,fields)
+            % samples with tStart <= timestamp < tEnd. Does not
+            % scan the whole buffer, so fast also for a large buffer.
+            % Optional fields input as for consumeSamples
+            if nargin>3
+                data = this.mexHndl('peekSamplesRange',int64(tStart),int64(tEnd),fields);
+            else
+                data = this.mexHndl('peekSamplesRange',int64(tStart),int64(tEnd));
+            end
+        end
+        function data = consumeSamplesUntil(this,t,reader,fields)
+            % consume all samples with timestamp < t. Optional
+            % reader and fields inputs as for consumeSamples
+            if nargin>3
+                data = this.mexHndl('consumeSamplesUntil',int64(t),char(reader),fields);
+            elseif nargin>2
+                data = this.mexHndl('consumeSamplesUntil',int64(t),char(reader));
+            else
+                data = this.mexHndl('consumeSamplesUntil',int64(t));
+            end
+        end
+        function counts = getSampleOverflowCounts(this)
+            % number of samples dropped, spilled to disk or compressed
+            % because the buffer was full. Reset when buffer is cleared
+            counts = this.mexHndl('getSampleOverflowCounts');
+        end
+        function success = addSampleReader(this,name)
+            % add a named reader. Each reader consumes samples independently
+            % and gets all of them; samples are only removed from the buffer
+            % once all readers have consumed them. A new reader starts at
+            % the oldest samples in the buffer. Returns false if a reader
+            % with this name already exists
+            success = this.mexHndl('addSampleReader',char(name));
+        end
+        function success = removeSampleReader(this,name)
+            % remove a reader. Without name input, the default reader
+            % (used when consuming without specifying a reader) is
+            % removed. Do this when only using named readers, else the
+            % default reader keeps all samples in the buffer
             if nargin>1
-                success = this.mexHndl('startEventBuffering',uint64(initialBufferSize));
+                success = this.mexHndl('removeSampleReader',char(name));
+            else
+                success = this.mexHndl('removeSampleReader');
+            end
+        end
+        function names = getSampleReaders(this)
+            % cell array with names of all readers, '' is the default
+            % reader
+            names = this.mexHndl('getSampleReaders');
+        end
+        
+        function success = startEventBuffering(this,bufferSize,overflowPolicy)
+            % optional buffer size input. Optional overflow policy input
+            % determines what happens when the buffer is full:
+            % 'grow' (default): buffer grows, bufferSize is initial size
+            % 'dropOldest', 'dropNewest': buffer has fixed capacity
+            %   bufferSize, oldest or newest data is discarded
+            % 'spillToDisk': buffer has fixed capacity bufferSize, oldest
+            %   data is moved to a temporary file. It is returned first
+            %   when consuming
+            % 'compress': as 'spillToDisk', but oldest data is compressed
+            %   (losslessly) and kept in memory. bufferSize recent items
+            %   are kept uncompressed. Noisy samples only compress to
+            %   about 3/4 of their size
+            if nargin>2
+                success = this.mexHndl('startEventBuffering',uint64(bufferSize),char(overflowPolicy));
+            elseif nargin>1
+                success = this.mexHndl('startEventBuffering',uint64(bufferSize));
             else
                 success = this.mexHndl('startEventBuffering');
             end
@@ -121,10 +259,14 @@ classdef SMIbuffer < handle
                 this.mexHndl('stopEventBuffering');
             end
         end
-        function data = consumeEvents(this,firstN)
+        function data = consumeEvents(this,firstN,reader)
             % optional input indicating how many events to read from the
-            % beginning of buffer. Default: all
-            if nargin>1
+            % beginning of buffer. Default: all (also when empty).
+            % Optional input indicating which reader consumes, see
+            % addEventReader. Default: the default reader
+            if nargin>2
+                data = this.mexHndl('consumeEvents',uint64(firstN),char(reader));
+            elseif nargin>1
                 data = this.mexHndl('consumeEvents',uint64(firstN));
             else
                 data = this.mexHndl('consumeEvents');
@@ -139,5 +281,454 @@ classdef SMIbuffer < handle
                 data = this.mexHndl('peekEvents');
             end
         end
+        function data = peekEventsRange(this,tStart,tEnd)
+            % events with tStart <= timestamp < tEnd (start time). Does not
+            % scan the whole buffer, so fast also for a large buffer
+            data = this.mexHndl('peekEventsRange',int64(tStart),int64(tEnd));
+        end
+        function data = consumeEventsUntil(this,t,reader)
+            % consume all events with timestamp < t (start time). Optional
+            % reader input as for consumeEvents
+            if nargin>2
+                data = this.mexHndl('consumeEventsUntil',int64(t),char(reader));
+            else
+                data = this.mexHndl('consumeEventsUntil',int64(t));
+            end
+        end
+        function counts = getEventOverflowCounts(this)
+            % number of events dropped, spilled to disk or compressed
+            % because the buffer was full. Reset when buffer is cleared
+            counts = this.mexHndl('getEventOverflowCounts');
+        end
+        function success = addEventReader(this,name)
+            % add a named reader. Each reader consumes events independently
+            % and gets all of them; events are only removed from the buffer
+            % once all readers have consumed them. A new reader starts at
+            % the oldest events in the buffer. Returns false if a reader
+            % with this name already exists
+            success = this.mexHndl('addEventReader',char(name));
+        end
+        function success = removeEventReader(this,name)
+            % remove a reader. Without name input, the default reader
+            % (used when consuming without specifying a reader) is
+            % removed. Do this when only using named readers, else the
+            % default reader keeps all events in the buffer
+            if nargin>1
+                success = this.mexHndl('removeEventReader',char(name));
+            else
+                success = this.mexHndl('removeEventReader');
+            end
+        end
+        function names = getEventReaders(this)
+            % cell array with names of all readers, '' is the default
+            % reader
+            names = this.mexHndl('getEventReaders');
+        end
+        
+        function success = startLogging(this,fileName,interval)
+            % write all samples and events to a binary log file while
+            % buffering, so that data is not lost if MATLAB crashes. A
+            % background thread writes new data every interval ms
+            % (optional, default 100). Logging starts with the oldest
+            % data still in the buffers, and is not affected by
+            % consuming. Uses a reader of its own ('SMIbuffer_log').
+            % Read the file with SMIbuffer.readLog. If writing the file
+            % fails (e.g. disk full), logging stops, see isLogging
+            if nargin>2
+                success = this.mexHndl('startLogging',char(fileName),uint32(interval));
+            else
+                success = this.mexHndl('startLogging',char(fileName));
+            end
+        end
+        function stopLogging(this)
+            % writes out remaining data and closes the log file
+            this.mexHndl('stopLogging');
+        end
+        function [logging,writeFailed] = isLogging(this)
+            % Optional second output: true if logging stopped because
+            % writing the log file failed (until logging is started again)
+            if nargout>1
+                [logging,writeFailed] = this.mexHndl('isLogging');
+            else
+                logging = this.mexHndl('isLogging');
+            end
+        end
+        function stats = getStats(this)
+            % runtime statistics, for diagnosing stutters. Struct with
+            % fields samples and events, each with:
+            % received: number of data source callbacks
+            % maxCallbackDuration, totalCallbackDuration: time spent
+            %   storing data in the callbacks (ns)
+            % intervalHistogram: time between successive callbacks.
+            %   Element 1 counts intervals below 1 us, element i those
+            %   of [2^(i-2), 2^(i-1)) us, the last element all longer
+            % dropped, spilled, compressed: as getSampleOverflowCounts
+            % compressedBytes: memory used by compressed data
+            % peakSize: most items held in memory at once
+            % chunkAllocations: number of times the buffer had to grow
+            % lockWaits, lockWaitTime, maxLockWait: how often and how
+            %   long (ns) reading had to wait for access to the buffer
+            % Field latency: delivery latency of the samples, relative to
+            % the fastest delivery (see getClockModel), with fields n
+            % (samples measured), total and max (us), and histogram (bins
+            % as intervalHistogram).
+            % All counters accumulate until resetStats is called.
+            stats = this.mexHndl('getStats');
+        end
+        function resetStats(this)
+            this.mexHndl('resetStats');
+        end
+        function model = getClockModel(this)
+            % relation between the tracker's clock (sample timestamps)
+            % and host time (see getHostTime), estimated as samples arrive
+            % (only while buffering samples). Struct with fields
+            % refTracker (int64), offset (us) and drift (host us gained
+            % per tracker us), such that host = tracker + offset +
+            % drift*(tracker-refTracker), and nWindows: number of 1 s
+            % windows the model is fit on (0: first second of data).
+            % The offset includes the fastest delivery of a sample. Empty
+            % if no sample was received yet
+            model = this.mexHndl('getClockModel');
+        end
+        function hostTime = trackerToHostTime(this,trackerTime)
+            % convert (an array of) tracker times to host time, using the
+            % current clock model. Empty if there is none yet
+            hostTime = this.mexHndl('trackerToHostTime',int64(trackerTime));
+        end
+        function trackerTime = hostToTrackerTime(this,hostTime)
+            % convert (an array of) host times, e.g. of a screen flip, to
+            % tracker time, using the current clock model. Empty if there
+            % is none yet
+            trackerTime = this.mexHndl('hostToTrackerTime',int64(hostTime));
+        end
+        function time = getHostTime(this)
+            % current host time (int64, us): the steady clock of the C++
+            % runtime. On Windows that is QueryPerformanceCounter, which
+            % Psychtoolbox's GetSecs is also based on
+            time = this.mexHndl('getHostTime');
+        end
+        function startEventDetection(this,settings,bufferSize,overflowPolicy)
+            % detect fixations and saccades online as samples arrive (only
+            % while buffering samples). Detected events are kept in their
+            % own buffer, read with consumeDetectedEvents and
+            % peekDetectedEvents. They have the same format as the output
+            % of consumeEvents, with eventType 'F' (fixation, reported
+            % once ended) or 'S' (saccade). A saccade is reported at its
+            % onset with endTime and duration 0, and again once ended
+            % (an onset that turns out too short has no follow-up).
+            % Optional settings struct, all fields optional:
+            % algorithm: 'velocity' (default, I-VT) or 'dispersion' (I-DT)
+            % eyes: 'binocular' (default, each eye separately), 'left' or
+            %   'right'
+            % pixelsPerDegree: gaze is in pixels, thresholds in degrees.
+            %   Default 40
+            % velocityThreshold: deg/s, default 30 (velocity)
+            % velocityWindow: samples, velocity is the displacement over
+            %   this many sample intervals, so that noise doesn't cross
+            %   the threshold. Default 4, at most 16 (velocity)
+            % dispersionThreshold: deg, horizontal + vertical extent,
+            %   default 1 (dispersion)
+            % minFixationDuration: ms, default 60
+            % minSaccadeDuration: ms, default 10 (velocity)
+            % Optional buffer size and overflow policy inputs as for
+            % startEventBuffering.
+            if nargin<2
+                settings = [];
+            end
+            if nargin>3
+                this.mexHndl('startEventDetection',settings,uint64(bufferSize),char(overflowPolicy));
+            elseif nargin>2
+                this.mexHndl('startEventDetection',settings,uint64(bufferSize));
+            else
+                this.mexHndl('startEventDetection',settings);
+            end
+        end
+        function stopEventDetection(this,doDeleteBuffer)
+            % ongoing events are ended and reported if they qualify.
+            % Optional boolean input indicating whether buffer should be
+            % deleted
+            if nargin>1
+                this.mexHndl('stopEventDetection',logical(doDeleteBuffer));
+            else
+                this.mexHndl('stopEventDetection');
+            end
+        end
+        function detecting = isDetectingEvents(this)
+            detecting = this.mexHndl('isDetectingEvents');
+        end
+        function clearDetectedEventBuffer(this)
+            this.mexHndl('clearDetectedEventBuffer');
+        end
+        function data = consumeDetectedEvents(this,firstN)
+            % optional input indicating how many events to read from the
+            % beginning of buffer. Default: all (also when empty).
+            if nargin>1
+                data = this.mexHndl('consumeDetectedEvents',uint64(firstN));
+            else
+                data = this.mexHndl('consumeDetectedEvents');
+            end
+        end
+        function [found,event] = waitForEvent(this,type,timeout)
+            % wait until an event of the given type (e.g. 'F', or '' for
+            % any) arrives, for at most timeout ms. Only events that
+            % arrive after the call count. event (same format as output
+            % of consumeEvents) is the first one that matched. found is
+            % false on timeout
+            [found,event] = this.mexHndl('waitForEvent',char(type),uint32(timeout));
+        end
+        function [found,event] = waitForDetectedEvent(this,type,timeout)
+            % as waitForEvent, for the events of startEventDetection
+            [found,event] = this.mexHndl('waitForDetectedEvent',char(type),uint32(timeout));
+        end
+        function data = peekDetectedEvents(this,lastN)
+            % optional input indicating how many events to read from the
+            % end of buffer. Default: 1
+            if nargin>1
+                data = this.mexHndl('peekDetectedEvents',uint64(lastN));
+            else
+                data = this.mexHndl('peekDetectedEvents');
+            end
+        end
+        function success = startQualityMonitor(this,settings)
+            % data-quality metrics over a sliding window of the incoming
+            % samples, updated as samples arrive (only while samples are
+            % buffered). Optional settings struct, all fields optional:
+            % windowType: 'time' (default) or 'count'
+            % windowLength: ms or samples, default 500
+            % targetX, targetY: position (pixels) offset is computed
+            %       relative to, e.g. a validation point. Default 0
+            % maxSampleRate: Hz, bound on the sampling rate, from which
+            %       room for a time window is allocated. Default 2000.
+            %       If samples come faster, the window holds fewer
+            % Starting again restarts with an empty window. Returns
+            % false if the settings are invalid
+            if nargin>1
+                success = this.mexHndl('startQualityMonitor',settings);
+            else
+                success = this.mexHndl('startQualityMonitor');
+            end
+        end
+        function stopQualityMonitor(this)
+            this.mexHndl('stopQualityMonitor');
+        end
+        function monitoring = isMonitoringQuality(this)
+            monitoring = this.mexHndl('isMonitoringQuality');
+        end
+        function quality = getQuality(this)
+            % cheap, can be called every frame. Struct with fields
+            % windowStart and windowEnd (timestamps of first and last
+            % sample in the window), and left and right, each with
+            % fields nSamples, nLost, dataLoss (fraction), rms
+            % (sample-to-sample), stdev, meanX, meanY, offsetX, offsetY
+            % and offset (mean relative to target), in pixels. Metrics
+            % without data are NaN. Empty if the monitor was never
+            % started, last metrics after it was stopped
+            quality = this.mexHndl('getQuality');
+        end
+        function success = startSharing(this,name,sampleCapacity,eventCapacity)
+            % publish samples and events, as they arrive (only while
+            % buffering), in shared-memory rings named [name '_samples']
+            % and [name '_events'], so that other processes (e.g. online
+            % analysis) can follow them live with SMIbuff::SharedRingReader
+            % or the Python wrapper's sharedSampleReader and
+            % sharedEventReader. Optional ring capacities (samples,
+            % events), default 65536 and 4096, rounded up to a power of
+            % two. Readers that fall behind by more lose the oldest data,
+            % they never slow down buffering. Starting again replaces the
+            % rings. Returns false if they couldn't be created
+            if nargin>3
+                success = this.mexHndl('startSharing',char(name),uint64(sampleCapacity),uint64(eventCapacity));
+            elseif nargin>2
+                success = this.mexHndl('startSharing',char(name),uint64(sampleCapacity));
+            else
+                success = this.mexHndl('startSharing',char(name));
+            end
+        end
+        function stopSharing(this)
+            this.mexHndl('stopSharing');
+        end
+        function sharing = isSharing(this)
+            sharing = this.mexHndl('isSharing');
+        end
+        function success = startTransforms(this,stages,interval,bufferSize,overflowPolicy)
+            % transform samples, e.g. to correct for a screen offset,
+            % convert to degrees, smooth or average the eyes. A
+            % background thread transforms new samples every interval ms
+            % (optional, default 20). Transformed samples are kept in
+            % their own buffer next to the raw samples, read with
+            % consumeTransformedSamples and peekTransformedSamples (same
+            % format as consumeSamples). Transforming starts with the
+            % oldest sample still in the buffer, and uses a reader of its
+            % own ('SMIbuffer_transform'). Lost data (gaze at (0,0)) is
+            % NaN in the transformed samples.
+            % stages is a struct array, applied in order, with fields:
+            % type: 'offset': subtract (x,y) from gaze
+            %       'toDegrees': (gaze-(x,y))/pixelsPerDegree, (x,y) e.g.
+            %           the screen center
+            %       'smooth': causal moving average over window samples
+            %       'averageEyes': both eyes get the mean of the two, or
+            %           the one eye with data
+            % x, y: pixels, default 0
+            % pixelsPerDegree: default 40
+            % window: default 3
+            % Optional buffer size and overflow policy inputs as for
+            % startSampleBuffering. Returns false if a stage is invalid
+            if nargin>4
+                success = this.mexHndl('startTransforms',stages,uint32(interval),uint64(bufferSize),char(overflowPolicy));
+            elseif nargin>3
+                success = this.mexHndl('startTransforms',stages,uint32(interval),uint64(bufferSize));
+            elseif nargin>2
+                success = this.mexHndl('startTransforms',stages,uint32(interval));
+            else
+                success = this.mexHndl('startTransforms',stages);
+            end
+        end
+        function stopTransforms(this,doDeleteBuffer)
+            % transforms remaining samples. Optional boolean input
+            % indicating whether buffer should be deleted
+            if nargin>1
+                this.mexHndl('stopTransforms',logical(doDeleteBuffer));
+            else
+                this.mexHndl('stopTransforms');
+            end
+        end
+        function transforming = isTransforming(this)
+            transforming = this.mexHndl('isTransforming');
+        end
+        function clearTransformedSampleBuffer(this)
+            this.mexHndl('clearTransformedSampleBuffer');
+        end
+        function data = consumeTransformedSamples(this,firstN)
+            % optional input indicating how many samples to read from the
+            % beginning of buffer. Default: all (also when empty).
+            if nargin>1
+                data = this.mexHndl('consumeTransformedSamples',uint64(firstN));
+            else
+                data = this.mexHndl('consumeTransformedSamples');
+            end
+        end
+        function data = peekTransformedSamples(this,lastN)
+            % optional input indicating how many samples to read from the
+            % end of buffer. Default: 1
+            if nargin>1
+                data = this.mexHndl('peekTransformedSamples',uint64(lastN));
+            else
+                data = this.mexHndl('peekTransformedSamples');
+            end
+        end
+        function index = markEpoch(this,label)
+            % start an epoch (e.g. a trial) with the given label, ending
+            % the current one. The samples and events that arrive from
+            % now on until the next markEpoch or endEpoch belong to it,
+            % and can be retrieved directly, without searching the
+            % buffers. Returns the index of the epoch. Below, epochs are
+            % identified by index or by label (the last epoch with that
+            % label)
+            index = this.mexHndl('markEpoch',char(label));
+        end
+        function endEpoch(this)
+            this.mexHndl('endEpoch');
+        end
+        function epochs = getEpochs(this)
+            % struct with fields label (cell array), trackerTime
+            % (timestamp of latest sample when the epoch was marked),
+            % hostTime (steady clock, us) and isOpen
+            epochs = this.mexHndl('getEpochs');
+        end
+        function clearEpochs(this)
+            % forget all epochs. Does not touch the buffers
+            this.mexHndl('clearEpochs');
+        end
+        function data = peekEpochSamples(this,epoch)
+            % samples of the epoch still in the buffer (same format as
+            % consumeSamples)
+            data = this.mexHndl('peekEpochSamples',epoch);
+        end
+        function data = consumeEpochSamples(this,epoch,reader)
+            % samples of the epoch not yet consumed by the reader
+            % (optional, default: the default reader), which is moved
+            % past the end of the epoch
+            if nargin>2
+                data = this.mexHndl('consumeEpochSamples',epoch,char(reader));
+            else
+                data = this.mexHndl('consumeEpochSamples',epoch);
+            end
+        end
+        function data = peekEpochEvents(this,epoch)
+            data = this.mexHndl('peekEpochEvents',epoch);
+        end
+        function data = consumeEpochEvents(this,epoch,reader)
+            if nargin>2
+                data = this.mexHndl('consumeEpochEvents',epoch,char(reader));
+            else
+                data = this.mexHndl('consumeEpochEvents',epoch);
+            end
+        end
+        function success = trimEpochs(this,epoch)
+            % discard all samples and events up to the end of the epoch,
+            % for all readers. Returns false if the epoch is unknown or
+            % still open
+            success = this.mexHndl('trimEpochs',epoch);
+        end
+        function data = getEventSamples(this,index,fields)
+            % samples covered by an event (startTime <= timestamp <=
+            % endTime), same format as consumeSamples. Events are
+            % identified by index, the order in which they arrived (1 is
+            % the first event received), whether or not they were
+            % consumed. Each event's samples are looked up only once,
+            % after that they are retrieved directly. Optional fields
+            % input as for consumeSamples
+            if nargin>2
+                data = this.mexHndl('getEventSamples',index,fields);
+            else
+                data = this.mexHndl('getEventSamples',index);
+            end
+        end
+        function [event,data,index] = getLatestEvent(this,type,fields)
+            % newest event still in the buffer of the given type (e.g.
+            % 'F' for the last completed fixation, or '' for any), same
+            % format as consumeEvents, empty if there is none. Optional
+            % outputs: its samples (as getEventSamples, with the
+            % optional fields input) and its index
+            if nargin>2
+                [event,data,index] = this.mexHndl('getLatestEvent',char(type),fields);
+            else
+                [event,data,index] = this.mexHndl('getLatestEvent',char(type));
+            end
+        end
+        function [ids,mexHndl] = getActionIds(this)
+            % id of each action (struct with per method name, e.g.
+            % consumeEvents, a uint32), and the handle of the mex file.
+            % Calling mexHndl(ids.peekSamples,...) with the same inputs as
+            % passed to the mex file by the method of that name skips
+            % both the method call and looking up the action by name,
+            % for when many calls are made per frame. The ids are only
+            % valid for this version of the mex file
+            ids     = this.mexHndl('getActionIds');
+            mexHndl = this.mexHndl;
+        end
+        function results = batch(this,commands)
+            % run several actions in one call to the mex file. commands
+            % is a cell array of commands, each a cell array with an
+            % action name or id (see getActionIds) and the inputs as
+            % passed to the mex file by the method of that name, e.g.
+            % {{'consumeEvents'},{'peekSamples',uint64(1)},{'getStats'}}.
+            % Output is a cell array with the first output of each
+            % command ([] if it has none). The actions run in order, an
+            % error in one stops the batch
+            results = this.mexHndl('batch',commands);
+        end
+    end
+    
+    methods (Static)
+        function data = readLog(fileName)
+            % read a log file written by startLogging. Output struct
+            % has fields samples and events (same format as
+            % consumeSamples and consumeEvents), and complete, which is
+            % false if the end of the file was damaged (e.g. because
+            % MATLAB crashed while writing), in which case all data
+            % before the damage is returned
+            data = SMIbuffer_matlab('readLog',char(fileName));
+        end
     end
 end
@@ -1,10 +1,90 @@
-% testing SMIbuffer mex file
+% testing SMIbuffer mex file: calls each method once, with its required
+% inputs and with optional inputs, to check that the inputs arrive where the
+% mex file expects them. Needs a running eye tracker that sends data
 
 sampEvtBuffers = SMIbuffer();
 
-success = sampEvtBuffers.startSampleBuffering()
+success = sampEvtBuffers.startSampleBuffering(uint64(10000),'dropOldest','columns',struct('eyes','binocular'))
+success = sampEvtBuffers.startEventBuffering(uint64(1000),'grow')
+success = sampEvtBuffers.addSampleReader('test')
+success = sampEvtBuffers.addEventReader('test')
+names = sampEvtBuffers.getSampleReaders()
+names = sampEvtBuffers.getEventReaders()
+logFile = [tempname '.bin'];
+success = sampEvtBuffers.startLogging(logFile,uint32(50))
+logging = sampEvtBuffers.isLogging()
+[logging,writeFailed] = sampEvtBuffers.isLogging()
+sampEvtBuffers.startEventDetection(struct('algorithm','velocity'),uint64(1000),'dropOldest');
+detecting = sampEvtBuffers.isDetectingEvents()
+success = sampEvtBuffers.startQualityMonitor(struct('windowType','time','windowLength',500,'maxSampleRate',1250))
+monitoring = sampEvtBuffers.isMonitoringQuality()
+success = sampEvtBuffers.startSharing('SMIbufferTest',uint64(1024),uint64(256))
+sharing = sampEvtBuffers.isSharing()
+success = sampEvtBuffers.startTransforms(struct('type',{'offset','smooth'},'x',{10,0},'y',{10,0},'window',{3,3}),uint32(20),uint64(10000),'grow')
+transforming = sampEvtBuffers.isTransforming()
+index = sampEvtBuffers.markEpoch('trial1')
 
-WaitSecs(4);
-samples = sampEvtBuffers.getSamples();
+success = sampEvtBuffers.waitForSamples(uint64(10),uint32(2000),'test')
+[sample,arrivalTime] = sampEvtBuffers.getLatestSample()
+success = sampEvtBuffers.waitForTimestamp(sample(1)+1000,uint32(2000))
+[found,event] = sampEvtBuffers.waitForEvent('',uint32(2000))
+[found,event] = sampEvtBuffers.waitForDetectedEvent('F',uint32(2000))
+WaitSecs(2);
+sampEvtBuffers.endEpoch();
 
+data = sampEvtBuffers.peekSamples(uint64(5),{'timestamp','gazeX'})
+data = sampEvtBuffers.peekSamplesRange(int64(sample(1)),int64(sample(1)+1000),{'timestamp'})
+data = sampEvtBuffers.consumeSamplesUntil(int64(sample(1)+1000),'test',{'timestamp'})
+data = sampEvtBuffers.consumeSamples(uint64(10),'test',{'timestamp','leftEye'})
+data = sampEvtBuffers.peekEvents(uint64(2))
+data = sampEvtBuffers.peekEventsRange(int64(sample(1)),int64(sample(1)+1000))
+data = sampEvtBuffers.consumeEventsUntil(int64(sample(1)+1000),'test')
+data = sampEvtBuffers.consumeEvents(uint64(2),'test')
+counts = sampEvtBuffers.getSampleOverflowCounts()
+counts = sampEvtBuffers.getEventOverflowCounts()
+data = sampEvtBuffers.peekDetectedEvents(uint64(2))
+data = sampEvtBuffers.consumeDetectedEvents(uint64(2))
+quality = sampEvtBuffers.getQuality()
+data = sampEvtBuffers.peekTransformedSamples(uint64(2))
+data = sampEvtBuffers.consumeTransformedSamples(uint64(2))
+
+model = sampEvtBuffers.getClockModel()
+time = sampEvtBuffers.getHostTime()
+hostTime = sampEvtBuffers.trackerToHostTime(int64(sample(1)))
+trackerTime = sampEvtBuffers.hostToTrackerTime(time)
+stats = sampEvtBuffers.getStats()
+sampEvtBuffers.resetStats();
+
+epochs = sampEvtBuffers.getEpochs()
+data = sampEvtBuffers.peekEpochSamples(index)
+data = sampEvtBuffers.peekEpochEvents('trial1')
+data = sampEvtBuffers.consumeEpochSamples(index,'test')
+data = sampEvtBuffers.consumeEpochEvents(index,'test')
+success = sampEvtBuffers.trimEpochs(index)
+sampEvtBuffers.clearEpochs();
+
+[event,data,eventIndex] = sampEvtBuffers.getLatestEvent('',{'timestamp'})
+if ~isempty(eventIndex)
+    data = sampEvtBuffers.getEventSamples(eventIndex,{'timestamp'})
+end
+
+[ids,mexHndl] = sampEvtBuffers.getActionIds();
+logging = mexHndl(ids.isLogging)
+data = mexHndl(ids.peekSamples,uint64(2))
+results = sampEvtBuffers.batch({{'consumeEvents',uint64(2),'test'},{ids.peekSamples,uint64(1),{'timestamp'}},{'getStats'}})
+
+sampEvtBuffers.stopTransforms(true);
+sampEvtBuffers.clearTransformedSampleBuffer();
+sampEvtBuffers.stopSharing();
+sampEvtBuffers.stopQualityMonitor();
+sampEvtBuffers.stopEventDetection(true);
+sampEvtBuffers.clearDetectedEventBuffer();
+sampEvtBuffers.stopLogging();
+data = SMIbuffer.readLog(logFile)
+delete(logFile);
+success = sampEvtBuffers.removeSampleReader('test')
+success = sampEvtBuffers.removeEventReader('test')
+sampEvtBuffers.clearEventBuffer();
+sampEvtBuffers.stopEventBuffering(true);
+sampEvtBuffers.clearSampleBuffer();
 sampEvtBuffers.stopSampleBuffering(true);   % optional input indicating whether to also destroy buffer (delete samples) or not
\ No newline at end of file
@@ -1,14 +1,20 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <cstring>
 
 #include "SMIbuffer/SMIbuffer.h"
 
 #include "include_matlab.h"
 
 namespace {
-    SMIbuffer* SMIbufferClassInstance = nullptr;  // as there can only be one instance (it gets reused), we can just store a ref to it in a global pointer
-    // C++ object is of minimal size and does not have to be destroyed once created other than at mex unload
+    SMIbuffer* SMIbufferClassInstance = nullptr;  // as there can only be one instance, we can just store a ref to it in a global pointer
+    // destroyed by delete and at mex unload, and re-created by new (see DeleteInstance)
+
+    // consumeSamples consumes into this, so that polling doesn't allocate intermediate
+    // storage on top of the output arrays. Freed again after consuming many samples at once
+    SMIbuff::SampleColumns sampleScratch;
+    constexpr size_t g_sampleScratchKeep = 1 << 16;
 
     // List actions
     enum class Action
@@ -21,12 +27,84 @@ namespace {
         StopSampleBuffering,
         ConsumeSamples,
         PeekSamples,
+        PeekSamplesRange,
+        ConsumeSamplesUntil,
+        GetSampleOverflowCounts,
+        AddSampleReader,
+        RemoveSampleReader,
+        GetSampleReaders,
 
         StartEventBuffering,
         ClearEventBuffer,
         StopEventBuffering,
         ConsumeEvents,
-        PeekEvents
+        PeekEvents,
+        PeekEventsRange,
+        ConsumeEventsUntil,
+        GetEventOverflowCounts,
+        AddEventReader,
+        RemoveEventReader,
+        GetEventReaders,
+
+        StartLogging,
+        StopLogging,
+        IsLogging,
+        ReadLog,
+
+        GetStats,
+        ResetStats,
+
+        StartEventDetection,
+        StopEventDetection,
+        IsDetectingEvents,
+        ClearDetectedEventBuffer,
+        ConsumeDetectedEvents,
+        PeekDetectedEvents,
+
+        StartQualityMonitor,
+        StopQualityMonitor,
+        IsMonitoringQuality,
+        GetQuality,
+
+        StartSharing,
+        StopSharing,
+        IsSharing,
+
+        GetClockModel,
+        TrackerToHostTime,
+        HostToTrackerTime,
+        GetHostTime,
+
+        StartTransforms,
+        StopTransforms,
+        IsTransforming,
+        ClearTransformedSampleBuffer,
+        ConsumeTransformedSamples,
+        PeekTransformedSamples,
+
+        WaitForSamples,
+        WaitForTimestamp,
+        WaitForEvent,
+        WaitForDetectedEvent,
+
+        MarkEpoch,
+        EndEpoch,
+        GetEpochs,
+        ClearEpochs,
+        PeekEpochSamples,
+        ConsumeEpochSamples,
+        PeekEpochEvents,
+        ConsumeEpochEvents,
+        TrimEpochs,
+
+        GetEventSamples,
+        GetLatestEvent,
+
+        GetLatestSample,
+        GetActionIds,
+        Batch,
+
+        NumActions      // not an action: number of actions
     };
 
     // Map string (first input argument to mexFunction) to an Action
@@ -40,34 +118,186 @@ namespace {
         { "stopSampleBuffering",	Action::StopSampleBuffering },
         { "consumeSamples",			Action::ConsumeSamples },
         { "peekSamples",			Action::PeekSamples },
+        { "peekSamplesRange",		Action::PeekSamplesRange },
+        { "consumeSamplesUntil",	Action::ConsumeSamplesUntil },
+        { "getSampleOverflowCounts",Action::GetSampleOverflowCounts },
+        { "addSampleReader",		Action::AddSampleReader },
+        { "removeSampleReader",		Action::RemoveSampleReader },
+        { "getSampleReaders",		Action::GetSampleReaders },
 
         { "startEventBuffering",	Action::StartEventBuffering },
         { "clearEventBuffer",	    Action::ClearEventBuffer },
         { "stopEventBuffering",		Action::StopEventBuffering },
         { "consumeEvents",		    Action::ConsumeEvents },
         { "peekEvents",				Action::PeekEvents },
+        { "peekEventsRange",		Action::PeekEventsRange },
+        { "consumeEventsUntil",		Action::ConsumeEventsUntil },
+        { "getEventOverflowCounts",	Action::GetEventOverflowCounts },
+        { "addEventReader",			Action::AddEventReader },
+        { "removeEventReader",		Action::RemoveEventReader },
+        { "getEventReaders",		Action::GetEventReaders },
+
+        { "startLogging",			Action::StartLogging },
+        { "stopLogging",			Action::StopLogging },
+        { "isLogging",				Action::IsLogging },
+        { "readLog",				Action::ReadLog },
+
+        { "getStats",				Action::GetStats },
+        { "resetStats",				Action::ResetStats },
+
+        { "startEventDetection",	Action::StartEventDetection },
+        { "stopEventDetection",		Action::StopEventDetection },
+        { "isDetectingEvents",		Action::IsDetectingEvents },
+        { "clearDetectedEventBuffer",Action::ClearDetectedEventBuffer },
+        { "consumeDetectedEvents",	Action::ConsumeDetectedEvents },
+        { "peekDetectedEvents",		Action::PeekDetectedEvents },
+
+        { "startQualityMonitor",	Action::StartQualityMonitor },
+        { "stopQualityMonitor",		Action::StopQualityMonitor },
+        { "isMonitoringQuality",	Action::IsMonitoringQuality },
+        { "getQuality",				Action::GetQuality },
+
+        { "startSharing",			Action::StartSharing },
+        { "stopSharing",			Action::StopSharing },
+        { "isSharing",				Action::IsSharing },
+
+        { "getClockModel",			Action::GetClockModel },
+        { "trackerToHostTime",		Action::TrackerToHostTime },
+        { "hostToTrackerTime",		Action::HostToTrackerTime },
+        { "getHostTime",			Action::GetHostTime },
+
+        { "startTransforms",		Action::StartTransforms },
+        { "stopTransforms",			Action::StopTransforms },
+        { "isTransforming",			Action::IsTransforming },
+        { "clearTransformedSampleBuffer",Action::ClearTransformedSampleBuffer },
+        { "consumeTransformedSamples",Action::ConsumeTransformedSamples },
+        { "peekTransformedSamples",	Action::PeekTransformedSamples },
+
+        { "waitForSamples",			Action::WaitForSamples },
+        { "waitForTimestamp",		Action::WaitForTimestamp },
+        { "waitForEvent",			Action::WaitForEvent },
+        { "waitForDetectedEvent",	Action::WaitForDetectedEvent },
+
+        { "markEpoch",				Action::MarkEpoch },
+        { "endEpoch",				Action::EndEpoch },
+        { "getEpochs",				Action::GetEpochs },
+        { "clearEpochs",			Action::ClearEpochs },
+        { "peekEpochSamples",		Action::PeekEpochSamples },
+        { "consumeEpochSamples",	Action::ConsumeEpochSamples },
+        { "peekEpochEvents",		Action::PeekEpochEvents },
+        { "consumeEpochEvents",		Action::ConsumeEpochEvents },
+        { "trimEpochs",				Action::TrimEpochs },
+
+        { "getEventSamples",		Action::GetEventSamples },
+        { "getLatestEvent",			Action::GetLatestEvent },
+
+        { "getLatestSample",		Action::GetLatestSample },
+        { "getActionIds",			Action::GetActionIds },
+        { "batch",					Action::Batch },
+    };
+
+    // Map string to buffer overflow policy
+    const std::map<std::string, SMIbuff::OverflowPolicy> overflowPolicyMap =
+    {
+        { "grow",					SMIbuff::OverflowPolicy::Grow },
+        { "dropOldest",				SMIbuff::OverflowPolicy::DropOldest },
+        { "dropNewest",				SMIbuff::OverflowPolicy::DropNewest },
+        { "spillToDisk",			SMIbuff::OverflowPolicy::SpillToDisk },
+        { "compress",				SMIbuff::OverflowPolicy::Compress },
+    };
+
+    // Map string to sample storage layout
+    const std::map<std::string, SMIbuff::SampleLayout> sampleLayoutMap =
+    {
+        { "records",				SMIbuff::SampleLayout::Records },
+        { "columns",				SMIbuff::SampleLayout::Columns },
+    };
+
+    // Map string to eyes stored by a sample profile
+    const std::map<std::string, SMIbuff::SampleEyes> sampleEyesMap =
+    {
+        { "binocular",				SMIbuff::SampleEyes::Binocular },
+        { "left",					SMIbuff::SampleEyes::Left },
+        { "right",					SMIbuff::SampleEyes::Right },
+    };
+
+    // Map string to event detection algorithm
+    const std::map<std::string, SMIbuff::DetectionAlgorithm> detectionAlgorithmMap =
+    {
+        { "velocity",				SMIbuff::DetectionAlgorithm::Velocity },
+        { "dispersion",				SMIbuff::DetectionAlgorithm::Dispersion },
+    };
+
+    // Map string to data-quality window type
+    const std::map<std::string, SMIbuff::QualityWindowType> qualityWindowTypeMap =
+    {
+        { "time",					SMIbuff::QualityWindowType::Time },
+        { "count",					SMIbuff::QualityWindowType::Count },
+    };
+
+    // Map string to sample transform
+    const std::map<std::string, SMIbuff::TransformType> transformTypeMap =
+    {
+        { "offset",					SMIbuff::TransformType::Offset },
+        { "toDegrees",				SMIbuff::TransformType::PixelsToDegrees },
+        { "smooth",					SMIbuff::TransformType::Smooth },
+        { "averageEyes",			SMIbuff::TransformType::AverageEyes },
     };
 
     // forward declare
-    mxArray* SampleVectorToMatlab(std::vector<SampleStruct> data_);
-    mxArray* EventVectorToMatlab(std::vector<EventStruct> data_);
+    SMIbuff::OverflowPolicy OverflowPolicyFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    std::string ReaderNameFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    SMIbuff::SampleFieldMask SampleFieldsFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    int64_t TimestampFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    unsigned TimeoutFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    char EventTypeFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    size_t EpochFromMatlab(SMIbuffer& instance_, const mxArray* arr_, const std::string& actionStr_);
+    SMIbuff::SampleLayout SampleLayoutFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    SMIbuff::SampleProfile SampleProfileFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    SMIbuff::DetectorSettings DetectorSettingsFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    SMIbuff::QualitySettings QualitySettingsFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    std::vector<SMIbuff::TransformStage> TransformStagesFromMatlab(const mxArray* arr_, const std::string& actionStr_);
+    mxArray* SampleColumnsToMatlab(const SMIbuff::SampleColumns& data_);
+    mxArray* EventVectorToMatlab(const std::vector<EventStruct>& data_);
+    mxArray* OverflowCountsToMatlab(SMIbuff::OverflowCounts counts_);
+    mxArray* StringVectorToMatlab(const std::vector<std::string>& data_);
+    mxArray* LogContentsToMatlab(const SMIbuff::LogContents& data_);
+    mxArray* StatsToMatlab(const SMIbuff::Stats& stats_);
+    mxArray* QualityToMatlab(const SMIbuff::QualityMetrics& metrics_);
+    mxArray* ClockModelToMatlab(const SMIbuff::ClockModel& model_);
+    mxArray* EpochsToMatlab(const std::vector<SMIbuff::Epoch>& epochs_);
+    bool IsAction(const mxArray* arr_, const char* action_);
+    bool IsAction(const mxArray* arr_, Action action_);
+    Action ActionFromMatlab(const mxArray* arr_);
+    const std::string& ActionName(Action action_);
+    mxArray* RunBatch(const mxArray* commands_);
+    mxArray* ActionIdsToMatlab();
+    void LatestSampleToMatlab(const SMIbuffer& instance_, int nlhs_, mxArray* plhs_[]);
+    void ResetInstance(SMIbuffer& instance_);
+    void DeleteInstance();
 }
 
+void RunAction(Action action, const std::string& actionStr, int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
-    // get action string
-    char *actionCstr = mxArrayToString(prhs[0]);
-    std::string actionStr(actionCstr);
-    mxFree(actionCstr);
+    // fast path for getting the newest sample, e.g. on every frame of a gaze-contingent
+    // display: skips the action lookup below and outputs a flat vector
+    if (SMIbufferClassInstance && (IsAction(prhs[0], "getLatestSample") || IsAction(prhs[0], Action::GetLatestSample)))
+    {
+        LatestSampleToMatlab(*SMIbufferClassInstance, nlhs, plhs);
+        return;
+    }
 
-    // get corresponding action
-    auto it = actionTypeMap.find(actionStr);
-    if (it==actionTypeMap.end())
-        mexErrMsgTxt(("Unrecognized action (not in actionTypeMap): " + actionStr).c_str());
-    Action action = it->second;
+    const Action action = ActionFromMatlab(prhs[0]);
+    RunAction(action, ActionName(action), nlhs, plhs, nrhs, prhs);
+}
 
+// also run for each command of a batch
+void RunAction(Action action, const std::string& actionStr, int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
     // Check we have a valid handle, if needed
-    if (!SMIbufferClassInstance && action != Action::New)
+    if (!SMIbufferClassInstance && action != Action::New && action != Action::ReadLog && action != Action::GetActionIds)
     {
         mexErrMsgTxt(("Called action: " + actionStr + ", but no SMIbuffer class.").c_str());    // it seems this can happen when loading a workspace including this object from file.
     }
@@ -83,21 +313,16 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
                 mexErrMsgTxt("new: Expected argument to be a logical scalar.");
             bool needsEyeSwap = mxIsLogicalScalarTrue(prhs[1]);
 
-            if (!SMIbufferClassInstance)
-                SMIbufferClassInstance = new SMIbuffer(needsEyeSwap);
-            else
-            {
-                // reset instance (clears buffers, clears registered callbacks)
-                SMIbufferClassInstance->stopEventBuffering(true);
-                SMIbufferClassInstance->stopSampleBuffering(true);
-                SMIbufferClassInstance->setEyeSwap(needsEyeSwap);
-            }
+            // always a fresh instance, so that nothing (readers, epochs, statistics, ...)
+            // carries over from a previous one
+            DeleteInstance();
+            SMIbufferClassInstance = new SMIbuffer(needsEyeSwap);
+            // clear mex or matlab exit: stop the threads and callbacks before the code they run is unloaded
+            mexAtExit(DeleteInstance);
             return;
         }
         case Action::Delete:
-            // reset instance (clears buffers, clears registered callbacks)
-            SMIbufferClassInstance->stopEventBuffering(true);
-            SMIbufferClassInstance->stopSampleBuffering(true);
+            DeleteInstance();
             // Warn if other commands were ignored
             if (nrhs != 1)
                 mexWarnMsgTxt("Delete: Unexpected arguments ignored.");
@@ -105,14 +330,23 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         case Action::StartSampleBuffering:
         {
             uint64_t bufSize = SMIbuff::g_sampleBufDefaultSize;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("startSampleBuffering: Expected argument to be a uint64 scalar.");
-                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
-            
-            plhs[0] = mxCreateDoubleScalar(SMIbufferClassInstance->startSampleBuffering(bufSize));
+            auto policy = SMIbuff::g_overflowPolicyDefault;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                policy = OverflowPolicyFromMatlab(prhs[2], actionStr);
+            auto layout = SMIbuff::g_sampleLayoutDefault;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                layout = SampleLayoutFromMatlab(prhs[3], actionStr);
+            SMIbuff::SampleProfile profile;
+            if (nrhs > 4 && !mxIsEmpty(prhs[4]))
+                profile = SampleProfileFromMatlab(prhs[4], actionStr);
+
+            plhs[0] = mxCreateDoubleScalar(SMIbufferClassInstance->startSampleBuffering(bufSize, policy, layout, profile));
             return;
         }
         case Action::ClearSampleBuffer:
@@ -121,11 +355,11 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         case Action::StopSampleBuffering:
         {
             bool deleteBuffer = SMIbuff::g_stopBufferEmptiesDefault;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!(mxIsDouble(prhs[2]) && !mxIsComplex(prhs[2]) && mxIsScalar(prhs[2])) && !mxIsLogicalScalar(prhs[2]))
+                if (!(mxIsDouble(prhs[1]) && !mxIsComplex(prhs[1]) && mxIsScalar(prhs[1])) && !mxIsLogicalScalar(prhs[1]))
                     mexErrMsgTxt("stopSampleBuffering: Expected argument to be a logical scalar.");
-                deleteBuffer = mxIsLogicalScalarTrue(prhs[2]);
+                deleteBuffer = mxIsLogicalScalarTrue(prhs[1]);
             }
 
             SMIbufferClassInstance->stopSampleBuffering(deleteBuffer);
@@ -134,39 +368,100 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         case Action::ConsumeSamples:
         {
             uint64_t nSamp = SMIbuff::g_consumeDefaultAmount;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("consumeSamples: Expected argument to be a uint64 scalar.");
-                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
-            plhs[0] = SampleVectorToMatlab(SMIbufferClassInstance->consumeSamples(nSamp));
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                reader = ReaderNameFromMatlab(prhs[2], actionStr);
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                fields = SampleFieldsFromMatlab(prhs[3], actionStr);
+
+            sampleScratch.fields = fields;
+            SMIbufferClassInstance->consumeSampleColumnsInto(sampleScratch, nSamp, reader);
+            plhs[0] = SampleColumnsToMatlab(sampleScratch);
+            if (sampleScratch.size() > g_sampleScratchKeep)
+                sampleScratch = SMIbuff::SampleColumns{};
             return;
         }
         case Action::PeekSamples:
         {
             uint64_t nSamp = SMIbuff::g_peekDefaultAmount;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("peekSamples: Expected argument to be a uint64 scalar.");
-                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
-            plhs[0] = SampleVectorToMatlab(SMIbufferClassInstance->peekSamples(nSamp));
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                fields = SampleFieldsFromMatlab(prhs[2], actionStr);
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->peekSampleColumns(nSamp, fields));
+            return;
+        }
+        case Action::PeekSamplesRange:
+        {
+            if (nrhs < 3 || mxIsEmpty(prhs[1]) || mxIsEmpty(prhs[2]))
+                mexErrMsgTxt("peekSamplesRange: Expected start and end time arguments.");
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                fields = SampleFieldsFromMatlab(prhs[3], actionStr);
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->peekSampleColumnsRange(TimestampFromMatlab(prhs[1], actionStr), TimestampFromMatlab(prhs[2], actionStr), fields));
             return;
         }
+        case Action::ConsumeSamplesUntil:
+        {
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("consumeSamplesUntil: Expected time argument.");
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                reader = ReaderNameFromMatlab(prhs[2], actionStr);
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                fields = SampleFieldsFromMatlab(prhs[3], actionStr);
+
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->consumeSampleColumnsUntil(TimestampFromMatlab(prhs[1], actionStr), reader, fields));
+            return;
+        }
+        case Action::GetSampleOverflowCounts:
+            plhs[0] = OverflowCountsToMatlab(SMIbufferClassInstance->getSampleOverflowCounts());
+            return;
+        case Action::AddSampleReader:
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("addSampleReader: Expected reader name argument.");
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->addSampleReader(ReaderNameFromMatlab(prhs[1], actionStr)));
+            return;
+        case Action::RemoveSampleReader:
+        {
+            // empty name removes the default reader
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+                reader = ReaderNameFromMatlab(prhs[1], actionStr);
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->removeSampleReader(reader));
+            return;
+        }
+        case Action::GetSampleReaders:
+            plhs[0] = StringVectorToMatlab(SMIbufferClassInstance->getSampleReaders());
+            return;
 
         case Action::StartEventBuffering:
         {
             uint64_t bufSize = SMIbuff::g_eventBufDefaultSize;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("startEventBuffering: Expected argument to be a uint64 scalar.");
-                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
+            auto policy = SMIbuff::g_overflowPolicyDefault;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                policy = OverflowPolicyFromMatlab(prhs[2], actionStr);
 
-            plhs[0] = mxCreateDoubleScalar(SMIbufferClassInstance->startEventBuffering(bufSize));
+            plhs[0] = mxCreateDoubleScalar(SMIbufferClassInstance->startEventBuffering(bufSize, policy));
             return;
         }
         case Action::ClearEventBuffer:
@@ -176,11 +471,11 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         case Action::StopEventBuffering:
         {
             bool deleteBuffer = SMIbuff::g_stopBufferEmptiesDefault;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!(mxIsDouble(prhs[2]) && !mxIsComplex(prhs[2]) && mxIsScalar(prhs[2])) && !mxIsLogicalScalar(prhs[2]))
+                if (!(mxIsDouble(prhs[1]) && !mxIsComplex(prhs[1]) && mxIsScalar(prhs[1])) && !mxIsLogicalScalar(prhs[1]))
                     mexErrMsgTxt("stopEventBuffering: Expected argument to be a logical scalar.");
-                deleteBuffer = mxIsLogicalScalarTrue(prhs[2]);
+                deleteBuffer = mxIsLogicalScalarTrue(prhs[1]);
             }
 
             SMIbufferClassInstance->stopEventBuffering(deleteBuffer);
@@ -189,27 +484,484 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         case Action::ConsumeEvents:
         {
             uint64_t nSamp = SMIbuff::g_consumeDefaultAmount;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("consumeEvents: Expected argument to be a uint64 scalar.");
-                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
-            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->consumeEvents(nSamp));
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                reader = ReaderNameFromMatlab(prhs[2], actionStr);
+
+            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->consumeEvents(nSamp, reader));
             return;
         }
         case Action::PeekEvents:
         {
             uint64_t nSamp = SMIbuff::g_peekDefaultAmount;
-            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
             {
-                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
                     mexErrMsgTxt("peekEvents: Expected argument to be a uint64 scalar.");
-                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
             }
             plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->peekEvents(nSamp));
             return;
         }
+        case Action::PeekEventsRange:
+        {
+            if (nrhs < 3 || mxIsEmpty(prhs[1]) || mxIsEmpty(prhs[2]))
+                mexErrMsgTxt("peekEventsRange: Expected start and end time arguments.");
+            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->peekEventsRange(TimestampFromMatlab(prhs[1], actionStr), TimestampFromMatlab(prhs[2], actionStr)));
+            return;
+        }
+        case Action::ConsumeEventsUntil:
+        {
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("consumeEventsUntil: Expected time argument.");
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                reader = ReaderNameFromMatlab(prhs[2], actionStr);
+
+            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->consumeEventsUntil(TimestampFromMatlab(prhs[1], actionStr), reader));
+            return;
+        }
+        case Action::GetEventOverflowCounts:
+            plhs[0] = OverflowCountsToMatlab(SMIbufferClassInstance->getEventOverflowCounts());
+            return;
+        case Action::AddEventReader:
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("addEventReader: Expected reader name argument.");
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->addEventReader(ReaderNameFromMatlab(prhs[1], actionStr)));
+            return;
+        case Action::RemoveEventReader:
+        {
+            // empty name removes the default reader
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+                reader = ReaderNameFromMatlab(prhs[1], actionStr);
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->removeEventReader(reader));
+            return;
+        }
+        case Action::GetEventReaders:
+            plhs[0] = StringVectorToMatlab(SMIbufferClassInstance->getEventReaders());
+            return;
+
+        case Action::StartLogging:
+        {
+            if (nrhs < 2 || !mxIsChar(prhs[1]))
+                mexErrMsgTxt("startLogging: Expected file name argument to be a string.");
+            char *fileCstr = mxArrayToString(prhs[1]);
+            std::string file(fileCstr);
+            mxFree(fileCstr);
+
+            unsigned interval = SMIbuff::g_logIntervalDefault;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            {
+                if (!mxIsUint32(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                    mexErrMsgTxt("startLogging: Expected interval argument to be a uint32 scalar.");
+                interval = *static_cast<uint32_t*>(mxGetData(prhs[2]));
+            }
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->startLogging(file, interval));
+            return;
+        }
+        case Action::StopLogging:
+            SMIbufferClassInstance->stopLogging();
+            return;
+        case Action::IsLogging:
+        {
+            bool writeFailed;
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->isLogging(writeFailed));
+            if (nlhs > 1)
+                plhs[1] = mxCreateLogicalScalar(writeFailed);
+            return;
+        }
+        case Action::ReadLog:
+        {
+            // doesn't need an instance
+            if (nrhs < 2 || !mxIsChar(prhs[1]))
+                mexErrMsgTxt("readLog: Expected file name argument to be a string.");
+            char *fileCstr = mxArrayToString(prhs[1]);
+            std::string file(fileCstr);
+            mxFree(fileCstr);
+
+            SMIbuff::LogContents data;
+            if (!SMIbuff::readLog(file, data))
+                mexErrMsgTxt(("readLog: Cannot read file, or not an SMIbuffer log: " + file).c_str());
+            plhs[0] = LogContentsToMatlab(data);
+            return;
+        }
+        case Action::GetStats:
+            plhs[0] = StatsToMatlab(SMIbufferClassInstance->getStats());
+            return;
+        case Action::ResetStats:
+            SMIbufferClassInstance->resetStats();
+            return;
+
+        case Action::StartEventDetection:
+        {
+            SMIbuff::DetectorSettings settings;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+                settings = DetectorSettingsFromMatlab(prhs[1], actionStr);
+            uint64_t bufSize = SMIbuff::g_eventBufDefaultSize;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            {
+                if (!mxIsUint64(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                    mexErrMsgTxt("startEventDetection: Expected buffer size argument to be a uint64 scalar.");
+                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[2]));
+            }
+            auto policy = SMIbuff::g_overflowPolicyDefault;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                policy = OverflowPolicyFromMatlab(prhs[3], actionStr);
+
+            SMIbufferClassInstance->startEventDetection(settings, bufSize, policy);
+            return;
+        }
+        case Action::StopEventDetection:
+        {
+            bool deleteBuffer = SMIbuff::g_stopBufferEmptiesDefault;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!(mxIsDouble(prhs[1]) && !mxIsComplex(prhs[1]) && mxIsScalar(prhs[1])) && !mxIsLogicalScalar(prhs[1]))
+                    mexErrMsgTxt("stopEventDetection: Expected argument to be a logical scalar.");
+                deleteBuffer = mxIsLogicalScalarTrue(prhs[1]);
+            }
+
+            SMIbufferClassInstance->stopEventDetection(deleteBuffer);
+            return;
+        }
+        case Action::IsDetectingEvents:
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->isDetectingEvents());
+            return;
+        case Action::ClearDetectedEventBuffer:
+            SMIbufferClassInstance->clearDetectedEventBuffer();
+            return;
+        case Action::ConsumeDetectedEvents:
+        {
+            uint64_t nSamp = SMIbuff::g_consumeDefaultAmount;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
+                    mexErrMsgTxt("consumeDetectedEvents: Expected argument to be a uint64 scalar.");
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
+            }
+            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->consumeDetectedEvents(nSamp));
+            return;
+        }
+        case Action::PeekDetectedEvents:
+        {
+            uint64_t nSamp = SMIbuff::g_peekDefaultAmount;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
+                    mexErrMsgTxt("peekDetectedEvents: Expected argument to be a uint64 scalar.");
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
+            }
+            plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->peekDetectedEvents(nSamp));
+            return;
+        }
+
+        case Action::StartQualityMonitor:
+        {
+            SMIbuff::QualitySettings settings;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+                settings = QualitySettingsFromMatlab(prhs[1], actionStr);
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->startQualityMonitor(settings));
+            return;
+        }
+        case Action::StopQualityMonitor:
+            SMIbufferClassInstance->stopQualityMonitor();
+            return;
+        case Action::IsMonitoringQuality:
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->isMonitoringQuality());
+            return;
+        case Action::GetQuality:
+        {
+            SMIbuff::QualityMetrics metrics;
+            if (SMIbufferClassInstance->getQuality(metrics))
+                plhs[0] = QualityToMatlab(metrics);
+            else
+                plhs[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+            return;
+        }
+
+        case Action::StartSharing:
+        {
+            if (nrhs < 2 || !mxIsChar(prhs[1]))
+                mexErrMsgTxt("startSharing: Expected name argument to be a string.");
+            char *nameCstr = mxArrayToString(prhs[1]);
+            std::string name(nameCstr);
+            mxFree(nameCstr);
+
+            uint64_t capacities[] = {SMIbuff::g_sharedSampleCapacityDefault, SMIbuff::g_sharedEventCapacityDefault};
+            for (int i = 0; i < 2; i++)
+                if (nrhs > 2 + i && !mxIsEmpty(prhs[2 + i]))
+                {
+                    if (!mxIsUint64(prhs[2 + i]) || mxIsComplex(prhs[2 + i]) || !mxIsScalar(prhs[2 + i]))
+                        mexErrMsgTxt("startSharing: Expected capacity argument to be a uint64 scalar.");
+                    capacities[i] = *static_cast<uint64_t*>(mxGetData(prhs[2 + i]));
+                }
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->startSharing(name, capacities[0], capacities[1]));
+            return;
+        }
+        case Action::StopSharing:
+            SMIbufferClassInstance->stopSharing();
+            return;
+        case Action::IsSharing:
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->isSharing());
+            return;
+
+        case Action::GetClockModel:
+        {
+            SMIbuff::ClockModel model;
+            if (SMIbufferClassInstance->getClockModel(model))
+                plhs[0] = ClockModelToMatlab(model);
+            else
+                plhs[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+            return;
+        }
+        case Action::TrackerToHostTime:
+        case Action::HostToTrackerTime:
+        {
+            if (nrhs < 2 || !mxIsInt64(prhs[1]) || mxIsComplex(prhs[1]))
+                mexErrMsgTxt((actionStr + ": Expected time argument to be an int64 array.").c_str());
+            SMIbuff::ClockModel model;
+            if (!SMIbufferClassInstance->getClockModel(model))
+            {
+                plhs[0] = mxCreateNumericMatrix(0, 0, mxINT64_CLASS, mxREAL);
+                return;
+            }
+            // convert all with the same model
+            const auto n = mxGetNumberOfElements(prhs[1]);
+            const auto in = static_cast<const int64_t*>(mxGetData(prhs[1]));
+            plhs[0] = mxCreateUninitNumericArray(mxGetNumberOfDimensions(prhs[1]), mxGetDimensions(prhs[1]), mxINT64_CLASS, mxREAL);
+            auto out = static_cast<int64_t*>(mxGetData(plhs[0]));
+            for (size_t i = 0; i < n; i++)
+                out[i] = action == Action::TrackerToHostTime ? model.toHost(in[i]) : model.toTracker(in[i]);
+            return;
+        }
+        case Action::GetHostTime:
+        {
+            plhs[0] = mxCreateUninitNumericMatrix(1, 1, mxINT64_CLASS, mxREAL);
+            *static_cast<int64_t*>(mxGetData(plhs[0])) = SMIbuff::hostTimeNow();
+            return;
+        }
+
+        case Action::StartTransforms:
+        {
+            if (nrhs < 2)
+                mexErrMsgTxt("startTransforms: Expected transform stages argument.");
+            auto stages = TransformStagesFromMatlab(prhs[1], actionStr);
+            unsigned interval = SMIbuff::g_transformIntervalDefault;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+            {
+                if (!mxIsUint32(prhs[2]) || mxIsComplex(prhs[2]) || !mxIsScalar(prhs[2]))
+                    mexErrMsgTxt("startTransforms: Expected interval argument to be a uint32 scalar.");
+                interval = *static_cast<uint32_t*>(mxGetData(prhs[2]));
+            }
+            uint64_t bufSize = SMIbuff::g_sampleBufDefaultSize;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+            {
+                if (!mxIsUint64(prhs[3]) || mxIsComplex(prhs[3]) || !mxIsScalar(prhs[3]))
+                    mexErrMsgTxt("startTransforms: Expected buffer size argument to be a uint64 scalar.");
+                bufSize = *static_cast<uint64_t*>(mxGetData(prhs[3]));
+            }
+            auto policy = SMIbuff::g_overflowPolicyDefault;
+            if (nrhs > 4 && !mxIsEmpty(prhs[4]))
+                policy = OverflowPolicyFromMatlab(prhs[4], actionStr);
+
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->startTransforms(stages, interval, bufSize, policy));
+            return;
+        }
+        case Action::StopTransforms:
+        {
+            bool deleteBuffer = SMIbuff::g_stopBufferEmptiesDefault;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!(mxIsDouble(prhs[1]) && !mxIsComplex(prhs[1]) && mxIsScalar(prhs[1])) && !mxIsLogicalScalar(prhs[1]))
+                    mexErrMsgTxt("stopTransforms: Expected argument to be a logical scalar.");
+                deleteBuffer = mxIsLogicalScalarTrue(prhs[1]);
+            }
+
+            SMIbufferClassInstance->stopTransforms(deleteBuffer);
+            return;
+        }
+        case Action::IsTransforming:
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->isTransforming());
+            return;
+        case Action::ClearTransformedSampleBuffer:
+            SMIbufferClassInstance->clearTransformedSampleBuffer();
+            return;
+        case Action::ConsumeTransformedSamples:
+        {
+            uint64_t nSamp = SMIbuff::g_consumeDefaultAmount;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
+                    mexErrMsgTxt("consumeTransformedSamples: Expected argument to be a uint64 scalar.");
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
+            }
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->consumeTransformedSampleColumns(nSamp));
+            return;
+        }
+        case Action::PeekTransformedSamples:
+        {
+            uint64_t nSamp = SMIbuff::g_peekDefaultAmount;
+            if (nrhs > 1 && !mxIsEmpty(prhs[1]))
+            {
+                if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
+                    mexErrMsgTxt("peekTransformedSamples: Expected argument to be a uint64 scalar.");
+                nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
+            }
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->peekTransformedSampleColumns(nSamp));
+            return;
+        }
+
+        case Action::WaitForSamples:
+        {
+            if (nrhs < 3 || mxIsEmpty(prhs[1]) || mxIsEmpty(prhs[2]))
+                mexErrMsgTxt("waitForSamples: Expected number of samples and timeout arguments.");
+            if (!mxIsUint64(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]))
+                mexErrMsgTxt("waitForSamples: Expected number of samples argument to be a uint64 scalar.");
+            const uint64_t nSamp = *static_cast<uint64_t*>(mxGetData(prhs[1]));
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+                reader = ReaderNameFromMatlab(prhs[3], actionStr);
+
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->waitForSamples(nSamp, TimeoutFromMatlab(prhs[2], actionStr), reader));
+            return;
+        }
+        case Action::WaitForTimestamp:
+        {
+            if (nrhs < 3 || mxIsEmpty(prhs[1]) || mxIsEmpty(prhs[2]))
+                mexErrMsgTxt("waitForTimestamp: Expected time and timeout arguments.");
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->waitForTimestamp(TimestampFromMatlab(prhs[1], actionStr), TimeoutFromMatlab(prhs[2], actionStr)));
+            return;
+        }
+        case Action::WaitForEvent:
+        case Action::WaitForDetectedEvent:
+        {
+            if (nrhs < 3 || mxIsEmpty(prhs[2]))
+                mexErrMsgTxt((actionStr + ": Expected event type and timeout arguments.").c_str());
+            const char type = EventTypeFromMatlab(prhs[1], actionStr);
+            const unsigned timeout = TimeoutFromMatlab(prhs[2], actionStr);
+
+            EventStruct event;
+            const bool found = action == Action::WaitForEvent ?
+                SMIbufferClassInstance->waitForEvent(type, timeout, event) :
+                SMIbufferClassInstance->waitForDetectedEvent(type, timeout, event);
+            plhs[0] = mxCreateLogicalScalar(found);
+            if (nlhs > 1)
+                plhs[1] = EventVectorToMatlab(found ? std::vector<EventStruct>{event} : std::vector<EventStruct>{});
+            return;
+        }
+
+        case Action::MarkEpoch:
+        {
+            if (nrhs < 2 || !mxIsChar(prhs[1]))
+                mexErrMsgTxt("markEpoch: Expected label argument to be a string.");
+            char* labelCstr = mxArrayToString(prhs[1]);
+            const std::string label(labelCstr);
+            mxFree(labelCstr);
+            // 1-based index for MATLAB
+            plhs[0] = mxCreateDoubleScalar(static_cast<double>(SMIbufferClassInstance->markEpoch(label) + 1));
+            return;
+        }
+        case Action::EndEpoch:
+            SMIbufferClassInstance->endEpoch();
+            return;
+        case Action::GetEpochs:
+            plhs[0] = EpochsToMatlab(SMIbufferClassInstance->getEpochs());
+            return;
+        case Action::ClearEpochs:
+            SMIbufferClassInstance->clearEpochs();
+            return;
+        case Action::PeekEpochSamples:
+        case Action::ConsumeEpochSamples:
+        case Action::PeekEpochEvents:
+        case Action::ConsumeEpochEvents:
+        {
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt((actionStr + ": Expected epoch argument.").c_str());
+            const size_t epoch = EpochFromMatlab(*SMIbufferClassInstance, prhs[1], actionStr);
+            std::string reader = SMIbuff::g_defaultReader;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                reader = ReaderNameFromMatlab(prhs[2], actionStr);
+
+            switch (action)
+            {
+            case Action::PeekEpochSamples:
+                plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->peekEpochSampleColumns(epoch));
+                break;
+            case Action::ConsumeEpochSamples:
+                plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->consumeEpochSampleColumns(epoch, reader));
+                break;
+            case Action::PeekEpochEvents:
+                plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->peekEpochEvents(epoch));
+                break;
+            default:
+                plhs[0] = EventVectorToMatlab(SMIbufferClassInstance->consumeEpochEvents(epoch, reader));
+                break;
+            }
+            return;
+        }
+        case Action::TrimEpochs:
+        {
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("trimEpochs: Expected epoch argument.");
+            plhs[0] = mxCreateLogicalScalar(SMIbufferClassInstance->trimEpochs(EpochFromMatlab(*SMIbufferClassInstance, prhs[1], actionStr)));
+            return;
+        }
+
+        case Action::GetEventSamples:
+        {
+            if (nrhs < 2 || mxIsEmpty(prhs[1]))
+                mexErrMsgTxt("getEventSamples: Expected event index argument.");
+            if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsScalar(prhs[1]) || mxGetScalar(prhs[1]) < 1.)
+                mexErrMsgTxt("getEventSamples: Expected event index argument to be a positive double scalar.");
+            // 1-based index for MATLAB
+            const auto eventPos = static_cast<uint64_t>(mxGetScalar(prhs[1])) - 1;
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                fields = SampleFieldsFromMatlab(prhs[2], actionStr);
+            plhs[0] = SampleColumnsToMatlab(SMIbufferClassInstance->getEventSampleColumns(eventPos, fields));
+            return;
+        }
+        case Action::GetLatestEvent:
+        {
+            if (nrhs < 2)
+                mexErrMsgTxt("getLatestEvent: Expected event type argument.");
+            const char type = EventTypeFromMatlab(prhs[1], actionStr);
+            auto fields = SMIbuff::SampleField::All;
+            if (nrhs > 2 && !mxIsEmpty(prhs[2]))
+                fields = SampleFieldsFromMatlab(prhs[2], actionStr);
+
+            EventStruct event;
+            uint64_t eventPos = 0;
+            const bool found = SMIbufferClassInstance->getLatestEvent(type, event, eventPos);
+            plhs[0] = EventVectorToMatlab(found ? std::vector<EventStruct>{event} : std::vector<EventStruct>{});
+            if (nlhs > 1)
+                plhs[1] = SampleColumnsToMatlab(found ? SMIbufferClassInstance->getEventSampleColumns(eventPos, fields) : SMIbuff::SampleColumns(fields));
+            if (nlhs > 2)
+                plhs[2] = found ? mxCreateDoubleScalar(static_cast<double>(eventPos + 1)) : mxCreateDoubleMatrix(0, 0, mxREAL);
+            return;
+        }
+
+        case Action::GetLatestSample:
+            // only reached from a batch, mexFunction handles this action itself
+            LatestSampleToMatlab(*SMIbufferClassInstance, nlhs, plhs);
+            return;
+        case Action::GetActionIds:
+            plhs[0] = ActionIdsToMatlab();
+            return;
+        case Action::Batch:
+        {
+            if (nrhs < 2 || !mxIsCell(prhs[1]))
+                mexErrMsgTxt("batch: Expected argument to be a cell array of commands.");
+            plhs[0] = RunBatch(prhs[1]);
+            return;
+        }
 
         default:
             mexErrMsgTxt(("Unhandled action: " + actionStr).c_str());
@@ -221,8 +973,437 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 // helpers
 namespace
 {
+    SMIbuff::OverflowPolicy OverflowPolicyFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsChar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected overflow policy argument to be a string.").c_str());
+
+        char *policyCstr = mxArrayToString(arr_);
+        std::string policyStr(policyCstr);
+        mxFree(policyCstr);
+
+        auto it = overflowPolicyMap.find(policyStr);
+        if (it == overflowPolicyMap.end())
+            mexErrMsgTxt((actionStr_ + ": Unrecognized overflow policy (not in overflowPolicyMap): " + policyStr).c_str());
+        return it->second;
+    }
+
+    SMIbuff::SampleLayout SampleLayoutFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsChar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected sample layout argument to be a string.").c_str());
+
+        char *layoutCstr = mxArrayToString(arr_);
+        std::string layoutStr(layoutCstr);
+        mxFree(layoutCstr);
+
+        auto it = sampleLayoutMap.find(layoutStr);
+        if (it == sampleLayoutMap.end())
+            mexErrMsgTxt((actionStr_ + ": Unrecognized sample layout (not in sampleLayoutMap): " + layoutStr).c_str());
+        return it->second;
+    }
+
+    SMIbuff::SampleProfile SampleProfileFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsStruct(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected sample profile argument to be a scalar struct.").c_str());
+
+        // all fields optional, defaults as SMIbuff::SampleProfile
+        SMIbuff::SampleProfile profile;
+        if (const mxArray* eyes = mxGetField(arr_, 0, "eyes"))
+        {
+            if (!mxIsChar(eyes))
+                mexErrMsgTxt((actionStr_ + ": Expected sample profile field eyes to be a string.").c_str());
+            char *eyesCstr = mxArrayToString(eyes);
+            std::string eyesStr(eyesCstr);
+            mxFree(eyesCstr);
+
+            auto it = sampleEyesMap.find(eyesStr);
+            if (it == sampleEyesMap.end())
+                mexErrMsgTxt((actionStr_ + ": Unrecognized sample profile eyes (not in sampleEyesMap): " + eyesStr).c_str());
+            profile.eyes = it->second;
+        }
+        if (const mxArray* precision = mxGetField(arr_, 0, "precision"))
+        {
+            if (!mxIsChar(precision))
+                mexErrMsgTxt((actionStr_ + ": Expected sample profile field precision to be a string.").c_str());
+            char *precisionCstr = mxArrayToString(precision);
+            std::string precisionStr(precisionCstr);
+            mxFree(precisionCstr);
+
+            if (precisionStr == "single")
+                profile.singlePrecision = true;
+            else if (precisionStr != "double")
+                mexErrMsgTxt((actionStr_ + ": Expected sample profile field precision to be 'double' or 'single', not: " + precisionStr).c_str());
+        }
+        if (const mxArray* eyePosition = mxGetField(arr_, 0, "eyePosition"))
+        {
+            if (!mxIsLogicalScalar(eyePosition))
+                mexErrMsgTxt((actionStr_ + ": Expected sample profile field eyePosition to be a logical scalar.").c_str());
+            profile.eyePosition = mxIsLogicalScalarTrue(eyePosition);
+        }
+        return profile;
+    }
+
+    SMIbuff::DetectorSettings DetectorSettingsFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsStruct(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected detector settings argument to be a scalar struct.").c_str());
+
+        // all fields optional, defaults as SMIbuff::DetectorSettings
+        SMIbuff::DetectorSettings settings;
+        if (const mxArray* algorithm = mxGetField(arr_, 0, "algorithm"))
+        {
+            if (!mxIsChar(algorithm))
+                mexErrMsgTxt((actionStr_ + ": Expected detector settings field algorithm to be a string.").c_str());
+            char *algorithmCstr = mxArrayToString(algorithm);
+            std::string algorithmStr(algorithmCstr);
+            mxFree(algorithmCstr);
+
+            auto it = detectionAlgorithmMap.find(algorithmStr);
+            if (it == detectionAlgorithmMap.end())
+                mexErrMsgTxt((actionStr_ + ": Unrecognized detection algorithm (not in detectionAlgorithmMap): " + algorithmStr).c_str());
+            settings.algorithm = it->second;
+        }
+        if (const mxArray* eyes = mxGetField(arr_, 0, "eyes"))
+        {
+            if (!mxIsChar(eyes))
+                mexErrMsgTxt((actionStr_ + ": Expected detector settings field eyes to be a string.").c_str());
+            char *eyesCstr = mxArrayToString(eyes);
+            std::string eyesStr(eyesCstr);
+            mxFree(eyesCstr);
+
+            auto it = sampleEyesMap.find(eyesStr);
+            if (it == sampleEyesMap.end())
+                mexErrMsgTxt((actionStr_ + ": Unrecognized detector settings eyes (not in sampleEyesMap): " + eyesStr).c_str());
+            settings.eyes = it->second;
+        }
+        const std::pair<const char*, double SMIbuff::DetectorSettings::*> numericFields[] =
+        {
+            { "pixelsPerDegree",		&SMIbuff::DetectorSettings::pixelsPerDegree },
+            { "velocityThreshold",		&SMIbuff::DetectorSettings::velocityThreshold },
+            { "dispersionThreshold",	&SMIbuff::DetectorSettings::dispersionThreshold },
+            { "minFixationDuration",	&SMIbuff::DetectorSettings::minFixationDuration },
+            { "minSaccadeDuration",		&SMIbuff::DetectorSettings::minSaccadeDuration },
+        };
+        for (const auto& field : numericFields)
+        {
+            if (const mxArray* value = mxGetField(arr_, 0, field.first))
+            {
+                if (!mxIsDouble(value) || mxIsComplex(value) || !mxIsScalar(value))
+                    mexErrMsgTxt((actionStr_ + ": Expected detector settings field " + field.first + " to be a double scalar.").c_str());
+                settings.*field.second = mxGetScalar(value);
+            }
+        }
+        if (const mxArray* velocityWindow = mxGetField(arr_, 0, "velocityWindow"))
+        {
+            if (!mxIsDouble(velocityWindow) || mxIsComplex(velocityWindow) || !mxIsScalar(velocityWindow) || mxGetScalar(velocityWindow) < 1)
+                mexErrMsgTxt((actionStr_ + ": Expected detector settings field velocityWindow to be a positive double scalar.").c_str());
+            settings.velocityWindow = static_cast<size_t>(mxGetScalar(velocityWindow));
+        }
+        return settings;
+    }
+
+    SMIbuff::QualitySettings QualitySettingsFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsStruct(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected quality settings argument to be a scalar struct.").c_str());
+
+        // all fields optional, defaults as SMIbuff::QualitySettings
+        SMIbuff::QualitySettings settings;
+        if (const mxArray* windowType = mxGetField(arr_, 0, "windowType"))
+        {
+            if (!mxIsChar(windowType))
+                mexErrMsgTxt((actionStr_ + ": Expected quality settings field windowType to be a string.").c_str());
+            char *windowTypeCstr = mxArrayToString(windowType);
+            std::string windowTypeStr(windowTypeCstr);
+            mxFree(windowTypeCstr);
+
+            auto it = qualityWindowTypeMap.find(windowTypeStr);
+            if (it == qualityWindowTypeMap.end())
+                mexErrMsgTxt((actionStr_ + ": Unrecognized quality window type (not in qualityWindowTypeMap): " + windowTypeStr).c_str());
+            settings.windowType = it->second;
+        }
+        const std::pair<const char*, double SMIbuff::QualitySettings::*> numericFields[] =
+        {
+            { "windowLength",			&SMIbuff::QualitySettings::windowLength },
+            { "targetX",				&SMIbuff::QualitySettings::targetX },
+            { "targetY",				&SMIbuff::QualitySettings::targetY },
+            { "maxSampleRate",			&SMIbuff::QualitySettings::maxSampleRate },
+        };
+        for (const auto& field : numericFields)
+        {
+            if (const mxArray* value = mxGetField(arr_, 0, field.first))
+            {
+                if (!mxIsDouble(value) || mxIsComplex(value) || !mxIsScalar(value))
+                    mexErrMsgTxt((actionStr_ + ": Expected quality settings field " + field.first + " to be a double scalar.").c_str());
+                settings.*field.second = mxGetScalar(value);
+            }
+        }
+        return settings;
+    }
+
+    std::vector<SMIbuff::TransformStage> TransformStagesFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsStruct(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected transform stages argument to be a struct array.").c_str());
+
+        // one stage per element. type is required, other fields optional, defaults as
+        // SMIbuff::TransformStage
+        std::vector<SMIbuff::TransformStage> stages(mxGetNumberOfElements(arr_));
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            const mxArray* type = mxGetField(arr_, i, "type");
+            if (!type || !mxIsChar(type))
+                mexErrMsgTxt((actionStr_ + ": Expected transform stage field type to be a string.").c_str());
+            char *typeCstr = mxArrayToString(type);
+            std::string typeStr(typeCstr);
+            mxFree(typeCstr);
+
+            auto it = transformTypeMap.find(typeStr);
+            if (it == transformTypeMap.end())
+                mexErrMsgTxt((actionStr_ + ": Unrecognized transform type (not in transformTypeMap): " + typeStr).c_str());
+            stages[i].type = it->second;
+
+            const std::pair<const char*, double SMIbuff::TransformStage::*> numericFields[] =
+            {
+                { "x",					&SMIbuff::TransformStage::x },
+                { "y",					&SMIbuff::TransformStage::y },
+                { "pixelsPerDegree",	&SMIbuff::TransformStage::pixelsPerDegree },
+            };
+            for (const auto& field : numericFields)
+            {
+                if (const mxArray* value = mxGetField(arr_, i, field.first))
+                {
+                    if (!mxIsDouble(value) || mxIsComplex(value) || !mxIsScalar(value))
+                        mexErrMsgTxt((actionStr_ + ": Expected transform stage field " + field.first + " to be a double scalar.").c_str());
+                    stages[i].*field.second = mxGetScalar(value);
+                }
+            }
+            if (const mxArray* window = mxGetField(arr_, i, "window"))
+            {
+                if (!mxIsDouble(window) || mxIsComplex(window) || !mxIsScalar(window) || mxGetScalar(window) < 0)
+                    mexErrMsgTxt((actionStr_ + ": Expected transform stage field window to be a non-negative double scalar.").c_str());
+                stages[i].window = static_cast<size_t>(mxGetScalar(window));
+            }
+        }
+        return stages;
+    }
+
+    // compare action string without converting (and allocating)
+    bool IsAction(const mxArray* arr_, const char* action_)
+    {
+        if (!mxIsChar(arr_))
+            return false;
+        const size_t len = mxGetNumberOfElements(arr_);
+        if (len != std::strlen(action_))
+            return false;
+        const mxChar* chars = mxGetChars(arr_);
+        for (size_t i = 0; i < len; i++)
+            if (chars[i] != static_cast<mxChar>(action_[i]))
+                return false;
+        return true;
+    }
+
+    // action id, as output by getActionIds
+    bool IsAction(const mxArray* arr_, Action action_)
+    {
+        return mxIsNumeric(arr_) && !mxIsComplex(arr_) && mxIsScalar(arr_) && mxGetScalar(arr_) == static_cast<double>(action_);
+    }
+
+    // action name, or action id as output by getActionIds (skips converting the string
+    // and looking it up)
+    Action ActionFromMatlab(const mxArray* arr_)
+    {
+        if (mxIsNumeric(arr_) && !mxIsComplex(arr_) && mxIsScalar(arr_))
+        {
+            const double id = mxGetScalar(arr_);
+            if (!(id >= 0. && id < static_cast<double>(Action::NumActions)) || id != static_cast<double>(static_cast<int>(id)))
+                mexErrMsgTxt(("Unrecognized action id: " + std::to_string(id)).c_str());
+            return static_cast<Action>(static_cast<int>(id));
+        }
+        if (!mxIsChar(arr_))
+            mexErrMsgTxt("Expected action argument to be a string or an action id.");
+
+        char *actionCstr = mxArrayToString(arr_);
+        std::string actionStr(actionCstr);
+        mxFree(actionCstr);
+
+        auto it = actionTypeMap.find(actionStr);
+        if (it == actionTypeMap.end())
+            mexErrMsgTxt(("Unrecognized action (not in actionTypeMap): " + actionStr).c_str());
+        return it->second;
+    }
+
+    const std::string& ActionName(Action action_)
+    {
+        static const std::vector<std::string> names = []()
+        {
+            std::vector<std::string> out(static_cast<size_t>(Action::NumActions));
+            for (const auto& item : actionTypeMap)
+                out[static_cast<size_t>(item.second)] = item.first;
+            return out;
+        }();
+        return names[static_cast<size_t>(action_)];
+    }
+
+    // struct with for each action name its id (uint32)
+    mxArray* ActionIdsToMatlab()
+    {
+        std::vector<const char*> fieldNames;
+        for (const auto& item : actionTypeMap)
+            fieldNames.push_back(item.first.c_str());
+        mxArray* out = mxCreateStructMatrix(1, 1, static_cast<int>(fieldNames.size()), fieldNames.data());
+        int i = 0;
+        for (const auto& item : actionTypeMap)
+        {
+            mxArray* id = mxCreateUninitNumericMatrix(1, 1, mxUINT32_CLASS, mxREAL);
+            *static_cast<uint32_t*>(mxGetData(id)) = static_cast<uint32_t>(item.second);
+            mxSetFieldByNumber(out, 0, i++, id);
+        }
+        return out;
+    }
+
+    // commands_: cell array of commands, each a cell array {action, inputs...} that is run
+    // as a separate call mexFunction(action, inputs...) would be. Output: cell array with
+    // the first output of each command, [] if it has none. An error in any command aborts
+    // the batch
+    mxArray* RunBatch(const mxArray* commands_)
+    {
+        const size_t nCommands = mxGetNumberOfElements(commands_);
+        mxArray* out = mxCreateCellMatrix(1, nCommands);
+        std::vector<const mxArray*> inputs;
+        for (size_t c = 0; c < nCommands; c++)
+        {
+            const mxArray* command = mxGetCell(commands_, c);
+            if (!command || !mxIsCell(command) || mxIsEmpty(command))
+                mexErrMsgTxt(("batch: Expected command " + std::to_string(c + 1) + " to be a non-empty cell array.").c_str());
+            inputs.resize(mxGetNumberOfElements(command));
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                inputs[i] = mxGetCell(command, i);
+                if (!inputs[i])
+                    mexErrMsgTxt(("batch: Unset input in command " + std::to_string(c + 1) + ".").c_str());
+            }
+
+            const Action action = ActionFromMatlab(inputs[0]);
+            if (action == Action::New || action == Action::Delete || action == Action::Batch)
+                mexErrMsgTxt(("batch: Action " + ActionName(action) + " cannot be batched.").c_str());
+            mxArray* output = nullptr;
+            RunAction(action, ActionName(action), 1, &output, static_cast<int>(inputs.size()), inputs.data());
+            if (output)
+                mxSetCell(out, c, output);
+        }
+        return out;
+    }
+
+    // [timestamp leftGazeX leftGazeY rightGazeX rightGazeY], empty if there is no sample yet
+    // sample as flat vector, and if requested its arrival time (int64)
+    void LatestSampleToMatlab(const SMIbuffer& instance_, int nlhs_, mxArray* plhs_[])
+    {
+        SampleStruct sample;
+        int64_t arrivalTime;
+        if (!instance_.getLatestSample(sample, arrivalTime))
+        {
+            plhs_[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+            if (nlhs_ > 1)
+                plhs_[1] = mxCreateNumericMatrix(0, 0, mxINT64_CLASS, mxREAL);
+            return;
+        }
+        plhs_[0] = mxCreateUninitNumericMatrix(1, 5, mxDOUBLE_CLASS, mxREAL);
+        auto storage = static_cast<double*>(mxGetData(plhs_[0]));
+        storage[0] = static_cast<double>(sample.timestamp);
+        storage[1] = sample.leftEye.gazeX;
+        storage[2] = sample.leftEye.gazeY;
+        storage[3] = sample.rightEye.gazeX;
+        storage[4] = sample.rightEye.gazeY;
+        if (nlhs_ > 1)
+        {
+            plhs_[1] = mxCreateUninitNumericMatrix(1, 1, mxINT64_CLASS, mxREAL);
+            *static_cast<int64_t*>(mxGetData(plhs_[1])) = arrivalTime;
+        }
+    }
+
+    unsigned TimeoutFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsUint32(arr_) || mxIsComplex(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected timeout argument to be a uint32 scalar.").c_str());
+        return *static_cast<uint32_t*>(mxGetData(arr_));
+    }
+
+    // single character, or empty for any event type
+    char EventTypeFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (mxIsEmpty(arr_))
+            return SMIbuff::g_anyEventType;
+        if (!mxIsChar(arr_) || mxGetNumberOfElements(arr_) != 1)
+            mexErrMsgTxt((actionStr_ + ": Expected event type argument to be a single character.").c_str());
+        return static_cast<char>(mxGetChars(arr_)[0]);
+    }
+
+    std::string ReaderNameFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsChar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected reader name argument to be a string.").c_str());
+
+        char *nameCstr = mxArrayToString(arr_);
+        std::string name(nameCstr);
+        mxFree(nameCstr);
+        return name;
+    }
+
+    // field selection, as a string or cell array of strings with field names (see
+    // SMIbuff::sampleFieldsFromNames), or a uint32 bitmask (see SMIbuff::SampleField)
+    SMIbuff::SampleFieldMask SampleFieldsFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (mxIsUint32(arr_) && !mxIsComplex(arr_) && mxIsScalar(arr_))
+            return *static_cast<uint32_t*>(mxGetData(arr_)) & SMIbuff::SampleField::All;
+
+        if (!mxIsChar(arr_) && !mxIsCell(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected fields argument to be a string, a cell array of strings or a uint32 scalar.").c_str());
+        const bool isCell = mxIsCell(arr_);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < (isCell ? mxGetNumberOfElements(arr_) : 1); i++)
+        {
+            const mxArray* name = isCell ? mxGetCell(arr_, i) : arr_;
+            if (!name || !mxIsChar(name))
+                mexErrMsgTxt((actionStr_ + ": Expected fields argument to be a cell array of strings.").c_str());
+            char* nameCstr = mxArrayToString(name);
+            names.emplace_back(nameCstr);
+            mxFree(nameCstr);
+        }
+
+        SMIbuff::SampleFieldMask fields;
+        if (!SMIbuff::sampleFieldsFromNames(names, fields))
+            mexErrMsgTxt((actionStr_ + ": Unrecognized sample field name in fields argument.").c_str());
+        return fields;
+    }
+
+    int64_t TimestampFromMatlab(const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (!mxIsInt64(arr_) || mxIsComplex(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected time argument to be an int64 scalar.").c_str());
+        return *static_cast<int64_t*>(mxGetData(arr_));
+    }
+
+    // epoch is given as its label (the last epoch with that label) or its 1-based index
+    size_t EpochFromMatlab(SMIbuffer& instance_, const mxArray* arr_, const std::string& actionStr_)
+    {
+        if (mxIsChar(arr_))
+        {
+            char* labelCstr = mxArrayToString(arr_);
+            const std::string label(labelCstr);
+            mxFree(labelCstr);
+            return instance_.findEpoch(label);
+        }
+        if (!mxIsDouble(arr_) || mxIsComplex(arr_) || !mxIsScalar(arr_))
+            mexErrMsgTxt((actionStr_ + ": Expected epoch argument to be a string or a double scalar.").c_str());
+        const double index = mxGetScalar(arr_);
+        return index >= 1. ? static_cast<size_t>(index) - 1 : SMIbuff::g_noEpoch;
+    }
+
     template <typename D, typename O, typename T, typename U=T>
-    mxArray* FieldToMatlab(std::vector<D> data_, mxClassID type_, T O::*field1, U = U{})
+    mxArray* FieldToMatlab(const std::vector<D>& data_, mxClassID type_, T O::*field1, U = U{})
     {
         mxArray* temp;
         auto storage = static_cast<U*>(mxGetData(temp = mxCreateUninitNumericMatrix(1, data_.size(), type_, mxREAL)));
@@ -233,19 +1414,17 @@ namespace
         return temp;
     }
 
-    template <typename D, typename O, typename T, typename O2, typename T2>
-    mxArray* FieldToMatlab(std::vector<D> data_, mxClassID type_, T O::*field1, T2 O2::* field2)
+    // column is already contiguous and of the right type, so just memcpy
+    template <typename T>
+    mxArray* ColumnToMatlab(const std::vector<T>& data_, mxClassID type_)
     {
-        mxArray* temp;
-        auto storage = static_cast<T2*>(mxGetData(temp = mxCreateUninitNumericMatrix(1, data_.size(), type_, mxREAL)));
-        size_t i = 0;
-        for (auto &samp : data_)
-            storage[i++] = samp.*field1.*field2;
-
+        mxArray* temp = mxCreateUninitNumericMatrix(1, data_.size(), type_, mxREAL);
+        if (!data_.empty())
+            std::memcpy(mxGetData(temp), data_.data(), data_.size() * sizeof(T));
         return temp;
     }
 
-    mxArray* EventVectorToMatlab(std::vector<EventStruct> data_)
+    mxArray* EventVectorToMatlab(const std::vector<EventStruct>& data_)
     {
         const char* fieldNames[] = {"eventType","eye","startTime","endTime","duration","positionX","positionY"};
         mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
@@ -259,28 +1438,200 @@ namespace
         return out;
     }
 
-    mxArray* EyeDataStructToMatlab(std::vector<SampleStruct> data_, EyeDataStruct SampleStruct::*whichEye)
+    // fields_: the eye's bits of a SMIbuff::SampleFieldMask, gazeX in bit 0. Only the
+    // selected fields are output
+    mxArray* EyeDataColumnsToMatlab(const SMIbuff::EyeDataColumns& data_, SMIbuff::SampleFieldMask fields_)
     {
-        const char* fieldNames[] = {"gazeX","gazeY","diam","eyePositionX","eyePositionY","eyePositionZ"};
-        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
-        mxSetFieldByNumber(out, 0, 0, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::gazeX));
-        mxSetFieldByNumber(out, 0, 1, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::gazeY));
-        mxSetFieldByNumber(out, 0, 2, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::diam));
-        mxSetFieldByNumber(out, 0, 3, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::eyePositionX));
-        mxSetFieldByNumber(out, 0, 4, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::eyePositionY));
-        mxSetFieldByNumber(out, 0, 5, FieldToMatlab(data_, mxDOUBLE_CLASS, whichEye, &EyeDataStruct::eyePositionZ));
+        const char* allFieldNames[] = {"gazeX","gazeY","diam","eyePositionX","eyePositionY","eyePositionZ"};
+        const std::vector<double>* allColumns[] = {&data_.gazeX, &data_.gazeY, &data_.diam, &data_.eyePositionX, &data_.eyePositionY, &data_.eyePositionZ};
+        std::vector<const char*> fieldNames;
+        std::vector<const std::vector<double>*> columns;
+        for (size_t i = 0; i < sizeof(allFieldNames) / sizeof(*allFieldNames); i++)
+            if (fields_ & (1u << i))
+            {
+                fieldNames.push_back(allFieldNames[i]);
+                columns.push_back(allColumns[i]);
+            }
+
+        mxArray* out = mxCreateStructMatrix(1, 1, static_cast<int>(fieldNames.size()), fieldNames.data());
+        for (size_t i = 0; i < columns.size(); i++)
+            mxSetFieldByNumber(out, 0, static_cast<int>(i), ColumnToMatlab(*columns[i], mxDOUBLE_CLASS));
         return out;
     }
 
-    mxArray* SampleVectorToMatlab(std::vector<SampleStruct> data_)
+    // outputs only the fields in data_.fields, leaving out an eye if none of its fields are
+    mxArray* SampleColumnsToMatlab(const SMIbuff::SampleColumns& data_)
     {
-        const char* fieldNames[] = {"timestamp","leftEye","rightEye"};
-        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
-        mxSetFieldByNumber(out, 0, 0, FieldToMatlab(data_, mxINT64_CLASS, &SampleStruct::timestamp));
-        mxSetFieldByNumber(out, 0, 1, EyeDataStructToMatlab(data_, &SampleStruct::leftEye));
-        mxSetFieldByNumber(out, 0, 2, EyeDataStructToMatlab(data_, &SampleStruct::rightEye));
+        std::vector<const char*> fieldNames;
+        std::vector<mxArray*> values;
+        if (data_.fields & SMIbuff::SampleField::Timestamp)
+        {
+            fieldNames.push_back("timestamp");
+            values.push_back(ColumnToMatlab(data_.timestamp, mxINT64_CLASS));
+        }
+        if (data_.fields & SMIbuff::SampleField::LeftEye)
+        {
+            fieldNames.push_back("leftEye");
+            values.push_back(EyeDataColumnsToMatlab(data_.leftEye, (data_.fields & SMIbuff::SampleField::LeftEye) / SMIbuff::SampleField::LeftGazeX));
+        }
+        if (data_.fields & SMIbuff::SampleField::RightEye)
+        {
+            fieldNames.push_back("rightEye");
+            values.push_back(EyeDataColumnsToMatlab(data_.rightEye, (data_.fields & SMIbuff::SampleField::RightEye) / SMIbuff::SampleField::RightGazeX));
+        }
         // NB: planeNumber field is not provided by any of the supported eye tracker, so I ignore it here.
 
+        mxArray* out = mxCreateStructMatrix(1, 1, static_cast<int>(fieldNames.size()), fieldNames.data());
+        for (size_t i = 0; i < values.size(); i++)
+            mxSetFieldByNumber(out, 0, static_cast<int>(i), values[i]);
         return out;
     }
+    mxArray* OverflowCountsToMatlab(SMIbuff::OverflowCounts counts_)
+    {
+        const char* fieldNames[] = {"dropped","spilled","compressed"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxArray* temp;
+        mxSetFieldByNumber(out, 0, 0, temp = mxCreateUninitNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL));
+        *static_cast<uint64_t*>(mxGetData(temp)) = counts_.dropped;
+        mxSetFieldByNumber(out, 0, 1, temp = mxCreateUninitNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL));
+        *static_cast<uint64_t*>(mxGetData(temp)) = counts_.spilled;
+        mxSetFieldByNumber(out, 0, 2, temp = mxCreateUninitNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL));
+        *static_cast<uint64_t*>(mxGetData(temp)) = counts_.compressed;
+        return out;
+    }
+    mxArray* StreamStatsToMatlab(const SMIbuff::StreamStats& stats_)
+    {
+        const uint64_t values[] = {stats_.received, stats_.maxCallbackDuration, stats_.totalCallbackDuration, stats_.dropped, stats_.spilled, stats_.compressed, stats_.compressedBytes, stats_.peakSize, stats_.chunkAllocations, stats_.lockWaits, stats_.lockWaitTime, stats_.maxLockWait};
+        const char* fieldNames[] = {"received","maxCallbackDuration","totalCallbackDuration","dropped","spilled","compressed","compressedBytes","peakSize","chunkAllocations","lockWaits","lockWaitTime","maxLockWait","intervalHistogram"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxArray* temp;
+        const auto nValues = sizeof(values) / sizeof(*values);
+        for (size_t i = 0; i < nValues; i++)
+        {
+            mxSetFieldByNumber(out, 0, static_cast<int>(i), temp = mxCreateUninitNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL));
+            *static_cast<uint64_t*>(mxGetData(temp)) = values[i];
+        }
+        mxSetFieldByNumber(out, 0, static_cast<int>(nValues), temp = mxCreateUninitNumericMatrix(1, stats_.intervalHistogram.size(), mxUINT64_CLASS, mxREAL));
+        std::memcpy(mxGetData(temp), stats_.intervalHistogram.data(), stats_.intervalHistogram.size() * sizeof(uint64_t));
+        return out;
+    }
+    mxArray* LatencyStatsToMatlab(const SMIbuff::LatencyStats& stats_)
+    {
+        const uint64_t values[] = {stats_.n, stats_.total, stats_.max};
+        const char* fieldNames[] = {"n","total","max","histogram"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxArray* temp;
+        const auto nValues = sizeof(values) / sizeof(*values);
+        for (size_t i = 0; i < nValues; i++)
+        {
+            mxSetFieldByNumber(out, 0, static_cast<int>(i), temp = mxCreateUninitNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL));
+            *static_cast<uint64_t*>(mxGetData(temp)) = values[i];
+        }
+        mxSetFieldByNumber(out, 0, static_cast<int>(nValues), temp = mxCreateUninitNumericMatrix(1, stats_.histogram.size(), mxUINT64_CLASS, mxREAL));
+        std::memcpy(mxGetData(temp), stats_.histogram.data(), stats_.histogram.size() * sizeof(uint64_t));
+        return out;
+    }
+    mxArray* StatsToMatlab(const SMIbuff::Stats& stats_)
+    {
+        const char* fieldNames[] = {"samples","events","latency"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxSetFieldByNumber(out, 0, 0, StreamStatsToMatlab(stats_.samples));
+        mxSetFieldByNumber(out, 0, 1, StreamStatsToMatlab(stats_.events));
+        mxSetFieldByNumber(out, 0, 2, LatencyStatsToMatlab(stats_.latency));
+        return out;
+    }
+    mxArray* EyeQualityToMatlab(const SMIbuff::EyeQuality& quality_)
+    {
+        const double values[] = {static_cast<double>(quality_.nSamples), static_cast<double>(quality_.nLost), quality_.dataLoss, quality_.rms, quality_.stdev, quality_.meanX, quality_.meanY, quality_.offsetX, quality_.offsetY, quality_.offset};
+        const char* fieldNames[] = {"nSamples","nLost","dataLoss","rms","stdev","meanX","meanY","offsetX","offsetY","offset"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++)
+            mxSetFieldByNumber(out, 0, static_cast<int>(i), mxCreateDoubleScalar(values[i]));
+        return out;
+    }
+    mxArray* QualityToMatlab(const SMIbuff::QualityMetrics& metrics_)
+    {
+        const char* fieldNames[] = {"windowStart","windowEnd","left","right"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxArray* temp;
+        mxSetFieldByNumber(out, 0, 0, temp = mxCreateUninitNumericMatrix(1, 1, mxINT64_CLASS, mxREAL));
+        *static_cast<int64_t*>(mxGetData(temp)) = metrics_.windowStart;
+        mxSetFieldByNumber(out, 0, 1, temp = mxCreateUninitNumericMatrix(1, 1, mxINT64_CLASS, mxREAL));
+        *static_cast<int64_t*>(mxGetData(temp)) = metrics_.windowEnd;
+        mxSetFieldByNumber(out, 0, 2, EyeQualityToMatlab(metrics_.left));
+        mxSetFieldByNumber(out, 0, 3, EyeQualityToMatlab(metrics_.right));
+        return out;
+    }
+    mxArray* ClockModelToMatlab(const SMIbuff::ClockModel& model_)
+    {
+        const char* fieldNames[] = {"refTracker","offset","drift","nWindows"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxArray* temp;
+        mxSetFieldByNumber(out, 0, 0, temp = mxCreateUninitNumericMatrix(1, 1, mxINT64_CLASS, mxREAL));
+        *static_cast<int64_t*>(mxGetData(temp)) = model_.refTracker;
+        mxSetFieldByNumber(out, 0, 1, mxCreateDoubleScalar(model_.offset));
+        mxSetFieldByNumber(out, 0, 2, mxCreateDoubleScalar(model_.drift));
+        mxSetFieldByNumber(out, 0, 3, mxCreateDoubleScalar(static_cast<double>(model_.nWindows)));
+        return out;
+    }
+    mxArray* StringVectorToMatlab(const std::vector<std::string>& data_)
+    {
+        mxArray* out = mxCreateCellMatrix(1, data_.size());
+        for (size_t i = 0; i < data_.size(); i++)
+            mxSetCell(out, i, mxCreateString(data_[i].c_str()));
+        return out;
+    }
+    mxArray* LogContentsToMatlab(const SMIbuff::LogContents& data_)
+    {
+        SMIbuff::SampleColumns samples;
+        samples.resize(data_.samples.size());
+        samples.put(0, data_.samples.data(), data_.samples.size());
+
+        const char* fieldNames[] = {"samples","events","complete"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxSetFieldByNumber(out, 0, 0, SampleColumnsToMatlab(samples));
+        mxSetFieldByNumber(out, 0, 1, EventVectorToMatlab(data_.events));
+        mxSetFieldByNumber(out, 0, 2, mxCreateLogicalScalar(data_.complete));
+        return out;
+    }
+    mxArray* EpochsToMatlab(const std::vector<SMIbuff::Epoch>& epochs_)
+    {
+        std::vector<std::string> labels;
+        mxArray* isOpen = mxCreateLogicalMatrix(1, epochs_.size());
+        auto storage = static_cast<mxLogical*>(mxGetData(isOpen));
+        for (const auto& epoch : epochs_)
+        {
+            labels.push_back(epoch.label);
+            *storage++ = epoch.isOpen();
+        }
+
+        const char* fieldNames[] = {"label","trackerTime","hostTime","isOpen"};
+        mxArray* out = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(*fieldNames), fieldNames);
+        mxSetFieldByNumber(out, 0, 0, StringVectorToMatlab(labels));
+        mxSetFieldByNumber(out, 0, 1, FieldToMatlab(epochs_, mxINT64_CLASS, &SMIbuff::Epoch::trackerTime));
+        mxSetFieldByNumber(out, 0, 2, FieldToMatlab(epochs_, mxINT64_CLASS, &SMIbuff::Epoch::hostTime));
+        mxSetFieldByNumber(out, 0, 3, isOpen);
+        return out;
+    }
+
+    // stops logging, detection, monitoring, sharing and transforms, clears buffers, clears registered callbacks
+    void ResetInstance(SMIbuffer& instance_)
+    {
+        instance_.stopLogging();
+        instance_.stopTransforms(true);
+        instance_.stopEventDetection(true);
+        instance_.stopQualityMonitor();
+        instance_.stopSharing();
+        instance_.stopEventBuffering(true);
+        instance_.stopSampleBuffering(true);
+    }
+
+    // used by new and delete, and registered with mexAtExit. The destructor joins the instance's threads
+    void DeleteInstance()
+    {
+        if (SMIbufferClassInstance)
+            ResetInstance(*SMIbufferClassInstance);
+        delete SMIbufferClassInstance;
+        SMIbufferClassInstance = nullptr;
+    }
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstddef>
 
 #define BOOST_PYTHON_STATIC_LIB
 #include <boost/python.hpp>
@@ -96,30 +98,869 @@ struct EventConverter {
 };
 EventConverter convertEvents;
 
+// releases the GIL while in scope, so other Python threads (e.g. the drawing loop) can
+// run while we wait for the buffer's lock or copy data
+struct ScopedGILRelease {
+    ScopedGILRelease() : _state(PyEval_SaveThread()) {}
+    ~ScopedGILRelease() { PyEval_RestoreThread(_state); }
+    PyThreadState* _state;
+};
+
+// NumPy structured array output. The dtypes mirror the memory layout of SampleStruct
+// and EventStruct exactly, so the data is copied in one go instead of per element
+struct ArrayConverter {
+    void init() {
+        numpy = import("numpy");
+
+        list eyeNames, eyeFormats, eyeOffsets;
+        const std::pair<const char*, size_t> eyeFields[] = {
+            {"gazeX",        offsetof(EyeDataStruct, gazeX)},
+            {"gazeY",        offsetof(EyeDataStruct, gazeY)},
+            {"diam",         offsetof(EyeDataStruct, diam)},
+            {"eyePositionX", offsetof(EyeDataStruct, eyePositionX)},
+            {"eyePositionY", offsetof(EyeDataStruct, eyePositionY)},
+            {"eyePositionZ", offsetof(EyeDataStruct, eyePositionZ)},
+        };
+        for (auto& f : eyeFields)
+        {
+            eyeNames.append(f.first);
+            eyeFormats.append("f8");
+            eyeOffsets.append(f.second);
+        }
+        auto eyeDtype = makeDtype(eyeNames, eyeFormats, eyeOffsets, sizeof(EyeDataStruct));
+
+        list sampNames, sampFormats, sampOffsets;
+        sampNames.append("timestamp");      sampFormats.append("i8");       sampOffsets.append(offsetof(SampleStruct, timestamp));
+        sampNames.append("leftEye");        sampFormats.append(eyeDtype);   sampOffsets.append(offsetof(SampleStruct, leftEye));
+        sampNames.append("rightEye");       sampFormats.append(eyeDtype);   sampOffsets.append(offsetof(SampleStruct, rightEye));
+        sampNames.append("planeNumber");    sampFormats.append("i4");       sampOffsets.append(offsetof(SampleStruct, planeNumber));
+        sampDtype = makeDtype(sampNames, sampFormats, sampOffsets, sizeof(SampleStruct));
+
+        list evtNames, evtFormats, evtOffsets;
+        evtNames.append("eventType");   evtFormats.append("S1");    evtOffsets.append(offsetof(EventStruct, eventType));
+        evtNames.append("eye");         evtFormats.append("S1");    evtOffsets.append(offsetof(EventStruct, eye));
+        evtNames.append("startTime");   evtFormats.append("i8");    evtOffsets.append(offsetof(EventStruct, startTime));
+        evtNames.append("endTime");     evtFormats.append("i8");    evtOffsets.append(offsetof(EventStruct, endTime));
+        evtNames.append("duration");    evtFormats.append("i8");    evtOffsets.append(offsetof(EventStruct, duration));
+        evtNames.append("positionX");   evtFormats.append("f8");    evtOffsets.append(offsetof(EventStruct, positionX));
+        evtNames.append("positionY");   evtFormats.append("f8");    evtOffsets.append(offsetof(EventStruct, positionY));
+        evtDtype = makeDtype(evtNames, evtFormats, evtOffsets, sizeof(EventStruct));
+    }
+
+    api::object makeDtype(list names_, list formats_, list offsets_, size_t itemSize_) {
+        dict spec;
+        spec["names"] = names_;
+        spec["formats"] = formats_;
+        spec["offsets"] = offsets_;
+        spec["itemsize"] = itemSize_;
+        return numpy.attr("dtype")(spec);
+    }
+
+    bool inited = false;
+    api::object numpy;
+    api::object sampDtype;
+    api::object evtDtype;
+
+    api::object getSampleDtype() {
+        if (!inited)
+        {
+            init();
+            inited = true;
+        }
+        return sampDtype;
+    }
+
+    template <typename T>
+    api::object get(const std::vector<T>& data_) {
+        if (!inited)
+        {
+            init();
+            inited = true;
+        }
+        api::object arr = numpy.attr("empty")(data_.size(), std::is_same_v<T, SampleStruct> ? sampDtype : evtDtype);
+        if (data_.empty())
+            return arr;
 
-list consumeEvents(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
-    return convertEvents.get(smib_.consumeEvents(firstN_));
+        Py_buffer view;
+        if (PyObject_GetBuffer(arr.ptr(), &view, PyBUF_WRITABLE) != 0)
+            throw_error_already_set();
+        {
+            ScopedGILRelease noGIL;
+            std::memcpy(view.buf, data_.data(), data_.size() * sizeof(T));
+        }
+        PyBuffer_Release(&view);
+        return arr;
+    }
+
+    // one field as a 1D array
+    template <typename T>
+    api::object getColumn(const std::vector<T>& data_) {
+        if (!inited)
+        {
+            init();
+            inited = true;
+        }
+        api::object arr = numpy.attr("empty")(data_.size(), std::is_same_v<T, double> ? "f8" : "i8");
+        if (data_.empty())
+            return arr;
+
+        Py_buffer view;
+        if (PyObject_GetBuffer(arr.ptr(), &view, PyBUF_WRITABLE) != 0)
+            throw_error_already_set();
+        {
+            ScopedGILRelease noGIL;
+            std::memcpy(view.buf, data_.data(), data_.size() * sizeof(T));
+        }
+        PyBuffer_Release(&view);
+        return arr;
+    }
+    // dict of the selected fields (see SMIbuff::SampleColumns), eyes as nested dicts
+    dict getColumns(const SMIbuff::SampleColumns& data_) {
+        dict result;
+        if (data_.fields & SMIbuff::SampleField::Timestamp)
+            result["timestamp"] = getColumn(data_.timestamp);
+        const std::pair<const char*, const SMIbuff::EyeDataColumns*> eyes[] = { {"leftEye", &data_.leftEye}, {"rightEye", &data_.rightEye} };
+        SMIbuff::SampleFieldMask bit = SMIbuff::SampleField::LeftGazeX;
+        for (auto& eye : eyes)
+        {
+            const std::pair<const char*, const std::vector<double>*> columns[] = {
+                {"gazeX", &eye.second->gazeX}, {"gazeY", &eye.second->gazeY}, {"diam", &eye.second->diam},
+                {"eyePositionX", &eye.second->eyePositionX}, {"eyePositionY", &eye.second->eyePositionY}, {"eyePositionZ", &eye.second->eyePositionZ},
+            };
+            dict eyeDict;
+            for (auto& column : columns)
+            {
+                if (data_.fields & bit)
+                    eyeDict[column.first] = getColumn(*column.second);
+                bit <<= 1;
+            }
+            if (len(eyeDict))
+                result[eye.first] = eyeDict;
+        }
+        return result;
+    }
+};
+// never destroyed: static destruction runs after Python has shut down, releasing the
+// numpy objects then would crash
+ArrayConverter& convertArrays = *new ArrayConverter;
+
+
+list consumeEvents(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEvents(firstN_, reader_);
+    }
+    return convertEvents.get(data);
+}
+api::object consumeEventsArray(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEvents(firstN_, reader_);
+    }
+    return convertArrays.get(data);
 }
 list peekEvents(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
-    return convertEvents.get(smib_.peekEvents(lastN_));
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEvents(lastN_);
+    }
+    return convertEvents.get(data);
 }
-list consumeSamples(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
-    return convertSamples.get(smib_.consumeSamples(firstN_));
+api::object peekEventsArray(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEvents(lastN_);
+    }
+    return convertArrays.get(data);
+}
+list consumeSamples(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeSamples(firstN_, reader_);
+    }
+    return convertSamples.get(data);
+}
+api::object consumeSamplesArray(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeSamples(firstN_, reader_);
+    }
+    return convertArrays.get(data);
 }
 list peekSamples(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
-    return convertSamples.get(smib_.peekSamples(lastN_));
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekSamples(lastN_);
+    }
+    return convertSamples.get(data);
+}
+api::object peekSamplesArray(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekSamples(lastN_);
+    }
+    return convertArrays.get(data);
+}
+// fields_: None for all, a list of field names (see SMIbuff::sampleFieldsFromNames) or
+// a bitmask (see SMIbuff::SampleField)
+SMIbuff::SampleFieldMask sampleFieldsFromPython(api::object fields_) {
+    if (fields_.is_none())
+        return SMIbuff::SampleField::All;
+    extract<SMIbuff::SampleFieldMask> mask(fields_);
+    if (mask.check())
+        return mask() & SMIbuff::SampleField::All;
+
+    std::vector<std::string> names;
+    for (Py_ssize_t i = 0; i < len(fields_); i++)
+        names.push_back(extract<std::string>(fields_[i]));
+    SMIbuff::SampleFieldMask fields;
+    if (!SMIbuff::sampleFieldsFromNames(names, fields))
+    {
+        PyErr_SetString(PyExc_ValueError, "Unrecognized sample field name");
+        throw_error_already_set();
+    }
+    return fields;
+}
+dict consumeSampleColumns(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount, const std::string& reader_ = SMIbuff::g_defaultReader, api::object fields_ = api::object()) {
+    const auto fields = sampleFieldsFromPython(fields_);
+    SMIbuff::SampleColumns data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeSampleColumns(firstN_, reader_, fields);
+    }
+    return convertArrays.getColumns(data);
+}
+dict peekSampleColumns(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount, api::object fields_ = api::object()) {
+    const auto fields = sampleFieldsFromPython(fields_);
+    SMIbuff::SampleColumns data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekSampleColumns(lastN_, fields);
+    }
+    return convertArrays.getColumns(data);
+}
+// consume into out_, a preallocated C-contiguous NumPy array with sampleDtype(), instead
+// of a new array, so that polling allocates nothing. Returns the number of samples
+// written to the start of out_, at most its length
+size_t consumeSamplesInto(SMIbuffer& smib_, api::object out_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    if (out_.attr("dtype") != convertArrays.getSampleDtype())
+    {
+        PyErr_SetString(PyExc_TypeError, "out must be an array with dtype sampleDtype()");
+        throw_error_already_set();
+    }
+    Py_buffer view;
+    if (PyObject_GetBuffer(out_.ptr(), &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0)
+        throw_error_already_set();
+    size_t n;
+    {
+        ScopedGILRelease noGIL;
+        n = smib_.consumeSamplesInto(static_cast<SampleStruct*>(view.buf), static_cast<size_t>(view.len) / sizeof(SampleStruct), reader_);
+    }
+    PyBuffer_Release(&view);
+    return n;
+}
+api::object sampleDtype() {
+    return convertArrays.getSampleDtype();
+}
+// (timestamp, leftGazeX, leftGazeY, rightGazeX, rightGazeY), or None if no sample yet.
+// Doesn't release the GIL: reading the sample is cheaper than that
+// With arrivalTime_, the sample's arrival time in host time is appended
+api::object getLatestSample(const SMIbuffer& smib_, bool arrivalTime_ = false) {
+    SampleStruct sample;
+    int64_t arrivalTime;
+    if (!smib_.getLatestSample(sample, arrivalTime))
+        return api::object();
+    if (arrivalTime_)
+        return make_tuple(sample.timestamp, sample.leftEye.gazeX, sample.leftEye.gazeY, sample.rightEye.gazeX, sample.rightEye.gazeY, arrivalTime);
+    return make_tuple(sample.timestamp, sample.leftEye.gazeX, sample.leftEye.gazeY, sample.rightEye.gazeX, sample.rightEye.gazeY);
+}
+bool waitForSamples(SMIbuffer& smib_, size_t n_, unsigned timeout_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    ScopedGILRelease noGIL;
+    return smib_.waitForSamples(n_, timeout_, reader_);
+}
+bool waitForTimestamp(SMIbuffer& smib_, int64_t ts_, unsigned timeout_) {
+    ScopedGILRelease noGIL;
+    return smib_.waitForTimestamp(ts_, timeout_);
+}
+// returns the event, or None on timeout. type_: single character, or empty for any type
+api::object waitForEventImpl(SMIbuffer& smib_, const std::string& type_, unsigned timeout_, bool detected_) {
+    if (type_.size() > 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected event type to be a single character, or empty for any type");
+        throw_error_already_set();
+    }
+    const char type = type_.empty() ? SMIbuff::g_anyEventType : type_[0];
+    EventStruct event;
+    bool found;
+    {
+        ScopedGILRelease noGIL;
+        found = detected_ ? smib_.waitForDetectedEvent(type, timeout_, event) : smib_.waitForEvent(type, timeout_, event);
+    }
+    if (!found)
+        return api::object();
+    return convertEvents.get({event})[0];
+}
+api::object waitForEvent(SMIbuffer& smib_, const std::string& type_, unsigned timeout_) {
+    return waitForEventImpl(smib_, type_, timeout_, false);
+}
+api::object waitForDetectedEvent(SMIbuffer& smib_, const std::string& type_, unsigned timeout_) {
+    return waitForEventImpl(smib_, type_, timeout_, true);
+}
+list peekEventsRange(SMIbuffer& smib_, int64_t tStart_, int64_t tEnd_) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEventsRange(tStart_, tEnd_);
+    }
+    return convertEvents.get(data);
+}
+list consumeEventsUntil(SMIbuffer& smib_, int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEventsUntil(ts_, reader_);
+    }
+    return convertEvents.get(data);
+}
+api::object peekEventsRangeArray(SMIbuffer& smib_, int64_t tStart_, int64_t tEnd_) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEventsRange(tStart_, tEnd_);
+    }
+    return convertArrays.get(data);
+}
+api::object consumeEventsUntilArray(SMIbuffer& smib_, int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEventsUntil(ts_, reader_);
+    }
+    return convertArrays.get(data);
+}
+list peekSamplesRange(SMIbuffer& smib_, int64_t tStart_, int64_t tEnd_) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekSamplesRange(tStart_, tEnd_);
+    }
+    return convertSamples.get(data);
+}
+list consumeSamplesUntil(SMIbuffer& smib_, int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeSamplesUntil(ts_, reader_);
+    }
+    return convertSamples.get(data);
+}
+api::object peekSamplesRangeArray(SMIbuffer& smib_, int64_t tStart_, int64_t tEnd_) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekSamplesRange(tStart_, tEnd_);
+    }
+    return convertArrays.get(data);
+}
+api::object consumeSamplesUntilArray(SMIbuffer& smib_, int64_t ts_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeSamplesUntil(ts_, reader_);
+    }
+    return convertArrays.get(data);
+}
+list readersToList(const std::vector<std::string>& names_) {
+    list result;
+    for (auto& name : names_)
+        result.append(name);
+    return result;
+}
+list getSampleReaders(SMIbuffer& smib_) {
+    return readersToList(smib_.getSampleReaders());
+}
+list getEventReaders(SMIbuffer& smib_) {
+    return readersToList(smib_.getEventReaders());
+}
+bool startLogging(SMIbuffer& smib_, const std::string& file_, unsigned logInterval_ = SMIbuff::g_logIntervalDefault) {
+    ScopedGILRelease noGIL;
+    return smib_.startLogging(file_, logInterval_);
+}
+void stopLogging(SMIbuffer& smib_) {
+    // waits for the log thread to write out remaining data
+    ScopedGILRelease noGIL;
+    smib_.stopLogging();
+}
+// With writeFailed_, returns (logging, writeFailed): writeFailed is true if logging
+// stopped because writing the log file failed
+api::object isLogging(SMIbuffer& smib_, bool writeFailed_ = false) {
+    bool writeFailed;
+    bool logging;
+    {
+        ScopedGILRelease noGIL;
+        logging = smib_.isLogging(writeFailed);
+    }
+    if (writeFailed_)
+        return make_tuple(logging, writeFailed);
+    return api::object(logging);
+}
+list consumeDetectedEvents(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeDetectedEvents(firstN_);
+    }
+    return convertEvents.get(data);
+}
+api::object consumeDetectedEventsArray(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeDetectedEvents(firstN_);
+    }
+    return convertArrays.get(data);
+}
+list peekDetectedEvents(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekDetectedEvents(lastN_);
+    }
+    return convertEvents.get(data);
+}
+api::object peekDetectedEventsArray(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekDetectedEvents(lastN_);
+    }
+    return convertArrays.get(data);
+}
+// stages_: list of transformStage
+bool startTransforms(SMIbuffer& smib_, list stages_, unsigned interval_ = SMIbuff::g_transformIntervalDefault, size_t bufferSize_ = SMIbuff::g_sampleBufDefaultSize, SMIbuff::OverflowPolicy overflowPolicy_ = SMIbuff::g_overflowPolicyDefault) {
+    std::vector<SMIbuff::TransformStage> stages;
+    for (ssize_t i = 0; i < len(stages_); i++)
+        stages.push_back(extract<SMIbuff::TransformStage>(stages_[i]));
+    ScopedGILRelease noGIL;
+    return smib_.startTransforms(stages, interval_, bufferSize_, overflowPolicy_);
+}
+void stopTransforms(SMIbuffer& smib_, bool emptyBuffer_ = SMIbuff::g_stopBufferEmptiesDefault) {
+    // waits for the transform thread to finish
+    ScopedGILRelease noGIL;
+    smib_.stopTransforms(emptyBuffer_);
+}
+list consumeTransformedSamples(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeTransformedSamples(firstN_);
+    }
+    return convertSamples.get(data);
+}
+api::object consumeTransformedSamplesArray(SMIbuffer& smib_, size_t firstN_ = SMIbuff::g_consumeDefaultAmount) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeTransformedSamples(firstN_);
+    }
+    return convertArrays.get(data);
+}
+list peekTransformedSamples(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekTransformedSamples(lastN_);
+    }
+    return convertSamples.get(data);
+}
+api::object peekTransformedSamplesArray(SMIbuffer& smib_, size_t lastN_ = SMIbuff::g_peekDefaultAmount) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekTransformedSamples(lastN_);
+    }
+    return convertArrays.get(data);
+}
+// epoch_: index, or label (the last epoch with that label)
+size_t epochIndex(SMIbuffer& smib_, api::object epoch_) {
+    extract<std::string> label(epoch_);
+    if (label.check())
+        return smib_.findEpoch(label());
+    return extract<size_t>(epoch_);
+}
+// index of the last epoch with that label, or None
+api::object findEpoch(SMIbuffer& smib_, const std::string& label_) {
+    const size_t index = smib_.findEpoch(label_);
+    if (index == SMIbuff::g_noEpoch)
+        return api::object();
+    return api::object(index);
+}
+list getEpochs(SMIbuffer& smib_) {
+    list result;
+    for (auto& epoch : smib_.getEpochs())
+        result.append(epoch);
+    return result;
+}
+list peekEpochSamples(SMIbuffer& smib_, api::object epoch_) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEpochSamples(index);
+    }
+    return convertSamples.get(data);
+}
+api::object peekEpochSamplesArray(SMIbuffer& smib_, api::object epoch_) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEpochSamples(index);
+    }
+    return convertArrays.get(data);
+}
+list consumeEpochSamples(SMIbuffer& smib_, api::object epoch_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEpochSamples(index, reader_);
+    }
+    return convertSamples.get(data);
+}
+api::object consumeEpochSamplesArray(SMIbuffer& smib_, api::object epoch_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEpochSamples(index, reader_);
+    }
+    return convertArrays.get(data);
+}
+list peekEpochEvents(SMIbuffer& smib_, api::object epoch_) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEpochEvents(index);
+    }
+    return convertEvents.get(data);
+}
+api::object peekEpochEventsArray(SMIbuffer& smib_, api::object epoch_) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.peekEpochEvents(index);
+    }
+    return convertArrays.get(data);
+}
+list consumeEpochEvents(SMIbuffer& smib_, api::object epoch_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEpochEvents(index, reader_);
+    }
+    return convertEvents.get(data);
+}
+api::object consumeEpochEventsArray(SMIbuffer& smib_, api::object epoch_, const std::string& reader_ = SMIbuff::g_defaultReader) {
+    const size_t index = epochIndex(smib_, epoch_);
+    std::vector<EventStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.consumeEpochEvents(index, reader_);
+    }
+    return convertArrays.get(data);
+}
+bool trimEpochs(SMIbuffer& smib_, api::object epoch_) {
+    const size_t index = epochIndex(smib_, epoch_);
+    ScopedGILRelease noGIL;
+    return smib_.trimEpochs(index);
+}
+// eventPos_: the event's position in the event buffer, the number of events received
+// before it
+list getEventSamples(SMIbuffer& smib_, uint64_t eventPos_) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.getEventSamples(eventPos_);
+    }
+    return convertSamples.get(data);
+}
+api::object getEventSamplesArray(SMIbuffer& smib_, uint64_t eventPos_) {
+    std::vector<SampleStruct> data;
+    {
+        ScopedGILRelease noGIL;
+        data = smib_.getEventSamples(eventPos_);
+    }
+    return convertArrays.get(data);
+}
+// (event, position), or None if there is no such event
+api::object getLatestEvent(SMIbuffer& smib_, const std::string& type_) {
+    if (type_.size() > 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "Expected event type to be a single character, or empty for any type");
+        throw_error_already_set();
+    }
+    EventStruct event;
+    uint64_t eventPos;
+    bool found;
+    {
+        ScopedGILRelease noGIL;
+        found = smib_.getLatestEvent(type_.empty() ? SMIbuff::g_anyEventType : type_[0], event, eventPos);
+    }
+    if (!found)
+        return api::object();
+    return make_tuple(convertEvents.get({event})[0], eventPos);
+}
+// metrics, or None if the monitor was never started. Doesn't release the GIL, as
+// getLatestSample
+api::object getQuality(const SMIbuffer& smib_) {
+    SMIbuff::QualityMetrics metrics;
+    if (!smib_.getQuality(metrics))
+        return api::object();
+    return api::object(metrics);
+}
+list getIntervalHistogram(const SMIbuff::StreamStats& stats_) {
+    list result;
+    for (auto count : stats_.intervalHistogram)
+        result.append(count);
+    return result;
+}
+list getLatencyHistogram(const SMIbuff::LatencyStats& stats_) {
+    list result;
+    for (auto count : stats_.histogram)
+        result.append(count);
+    return result;
+}
+// clock model and time conversions: None if there is no model yet. Don't release the
+// GIL, reading the model is cheaper than that
+api::object getClockModel(const SMIbuffer& smib_) {
+    SMIbuff::ClockModel model;
+    if (!smib_.getClockModel(model))
+        return api::object();
+    return api::object(model);
+}
+api::object trackerToHostTime(const SMIbuffer& smib_, int64_t trackerTime_) {
+    int64_t hostTime;
+    if (!smib_.trackerToHostTime(trackerTime_, hostTime))
+        return api::object();
+    return api::object(hostTime);
+}
+api::object hostToTrackerTime(const SMIbuffer& smib_, int64_t hostTime_) {
+    int64_t trackerTime;
+    if (!smib_.hostToTrackerTime(hostTime_, trackerTime))
+        return api::object();
+    return api::object(trackerTime);
+}
+// returns (samples, events, complete), samples and events as NumPy structured arrays
+tuple readLog(const std::string& file_) {
+    SMIbuff::LogContents data;
+    bool ok;
+    {
+        ScopedGILRelease noGIL;
+        ok = SMIbuff::readLog(file_, data);
+    }
+    if (!ok)
+    {
+        PyErr_SetString(PyExc_IOError, ("Cannot read file, or not an SMIbuffer log: " + file_).c_str());
+        throw_error_already_set();
+    }
+    return make_tuple(convertArrays.get(data.samples), convertArrays.get(data.events), data.complete);
+}
+
+// reading shared rings from another process (see SMIbuffer::startSharing)
+template <typename T>
+api::object readShared(SMIbuff::SharedRingReader<T>& reader_, size_t maxN_ = SMIbuff::g_consumeDefaultAmount) {
+    std::vector<T> data;
+    {
+        ScopedGILRelease noGIL;
+        reader_.read(data, maxN_);
+    }
+    return convertArrays.get(data);
+}
+template <typename T>
+void defSharedReader(const char* name_) {
+    class_<SMIbuff::SharedRingReader<T>, boost::noncopyable>(name_)
+        .def("attach", &SMIbuff::SharedRingReader<T>::attach, (arg("self"), arg("name"), arg("fromOldest")=false))
+        .def("detach", &SMIbuff::SharedRingReader<T>::detach)
+        .def("isAttached", &SMIbuff::SharedRingReader<T>::isAttached)
+        .def("available", &SMIbuff::SharedRingReader<T>::available)
+        .def("read", readShared<T>, (arg("self"), arg("maxN")=SMIbuff::g_consumeDefaultAmount))
+        .add_property("position", &SMIbuff::SharedRingReader<T>::getPosition)
+        .add_property("lost", &SMIbuff::SharedRingReader<T>::getLost)
+        ;
 }
 
 // tell boost.python about functions with optional arguments
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(startSampleBuffering_overloads, SMIbuffer::startSampleBuffering, 0, 1);
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( startEventBuffering_overloads, SMIbuffer:: startEventBuffering, 0, 1);
-BOOST_PYTHON_FUNCTION_OVERLOADS( consumeEvents_overloads,  consumeEvents, 1, 2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(startSampleBuffering_overloads, SMIbuffer::startSampleBuffering, 0, 4);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( startEventBuffering_overloads, SMIbuffer:: startEventBuffering, 0, 2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( startEventDetection_overloads, SMIbuffer:: startEventDetection, 0, 3);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(  stopEventDetection_overloads, SMIbuffer::  stopEventDetection, 0, 1);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( startQualityMonitor_overloads, SMIbuffer:: startQualityMonitor, 0, 1);
 BOOST_PYTHON_FUNCTION_OVERLOADS(    peekEvents_overloads,     peekEvents, 1, 2);
-BOOST_PYTHON_FUNCTION_OVERLOADS(consumeSamples_overloads, consumeSamples, 1, 2);
 BOOST_PYTHON_FUNCTION_OVERLOADS(   peekSamples_overloads,    peekSamples, 1, 2);
 // start module scope
 BOOST_PYTHON_MODULE(SMIbuffer_python)
 {
+    enum_<SMIbuff::OverflowPolicy>("overflowPolicy")
+        .value("grow", SMIbuff::OverflowPolicy::Grow)
+        .value("dropOldest", SMIbuff::OverflowPolicy::DropOldest)
+        .value("dropNewest", SMIbuff::OverflowPolicy::DropNewest)
+        .value("spillToDisk", SMIbuff::OverflowPolicy::SpillToDisk)
+        .value("compress", SMIbuff::OverflowPolicy::Compress)
+        ;
+
+    enum_<SMIbuff::SampleLayout>("sampleLayout")
+        .value("records", SMIbuff::SampleLayout::Records)
+        .value("columns", SMIbuff::SampleLayout::Columns)
+        ;
+
+    enum_<SMIbuff::SampleEyes>("sampleEyes")
+        .value("binocular", SMIbuff::SampleEyes::Binocular)
+        .value("left", SMIbuff::SampleEyes::Left)
+        .value("right", SMIbuff::SampleEyes::Right)
+        ;
+
+    // what of each sample is stored, see startSampleBuffering
+    class_<SMIbuff::SampleProfile>("sampleProfile")
+        .def_readwrite("eyes", &SMIbuff::SampleProfile::eyes)
+        .def_readwrite("singlePrecision", &SMIbuff::SampleProfile::singlePrecision)
+        .def_readwrite("eyePosition", &SMIbuff::SampleProfile::eyePosition)
+        ;
+
+    enum_<SMIbuff::DetectionAlgorithm>("detectionAlgorithm")
+        .value("velocity", SMIbuff::DetectionAlgorithm::Velocity)
+        .value("dispersion", SMIbuff::DetectionAlgorithm::Dispersion)
+        ;
+
+    // online event detection settings, see startEventDetection
+    class_<SMIbuff::DetectorSettings>("detectorSettings")
+        .def_readwrite("algorithm", &SMIbuff::DetectorSettings::algorithm)
+        .def_readwrite("eyes", &SMIbuff::DetectorSettings::eyes)
+        .def_readwrite("pixelsPerDegree", &SMIbuff::DetectorSettings::pixelsPerDegree)
+        .def_readwrite("velocityThreshold", &SMIbuff::DetectorSettings::velocityThreshold)
+        .def_readwrite("velocityWindow", &SMIbuff::DetectorSettings::velocityWindow)
+        .def_readwrite("dispersionThreshold", &SMIbuff::DetectorSettings::dispersionThreshold)
+        .def_readwrite("minFixationDuration", &SMIbuff::DetectorSettings::minFixationDuration)
+        .def_readwrite("minSaccadeDuration", &SMIbuff::DetectorSettings::minSaccadeDuration)
+        ;
+
+    enum_<SMIbuff::TransformType>("transformType")
+        .value("offset", SMIbuff::TransformType::Offset)
+        .value("toDegrees", SMIbuff::TransformType::PixelsToDegrees)
+        .value("smooth", SMIbuff::TransformType::Smooth)
+        .value("averageEyes", SMIbuff::TransformType::AverageEyes)
+        ;
+
+    // a sample transform, see startTransforms
+    class_<SMIbuff::TransformStage>("transformStage")
+        .def_readwrite("type", &SMIbuff::TransformStage::type)
+        .def_readwrite("x", &SMIbuff::TransformStage::x)
+        .def_readwrite("y", &SMIbuff::TransformStage::y)
+        .def_readwrite("pixelsPerDegree", &SMIbuff::TransformStage::pixelsPerDegree)
+        .def_readwrite("window", &SMIbuff::TransformStage::window)
+        ;
+
+    enum_<SMIbuff::QualityWindowType>("qualityWindowType")
+        .value("time", SMIbuff::QualityWindowType::Time)
+        .value("count", SMIbuff::QualityWindowType::Count)
+        ;
+
+    // data-quality monitor settings, see startQualityMonitor
+    class_<SMIbuff::QualitySettings>("qualitySettings")
+        .def_readwrite("windowType", &SMIbuff::QualitySettings::windowType)
+        .def_readwrite("windowLength", &SMIbuff::QualitySettings::windowLength)
+        .def_readwrite("targetX", &SMIbuff::QualitySettings::targetX)
+        .def_readwrite("targetY", &SMIbuff::QualitySettings::targetY)
+        .def_readwrite("maxSampleRate", &SMIbuff::QualitySettings::maxSampleRate)
+        ;
+    // in pixels, NaN if there is no data to compute a metric on
+    class_<SMIbuff::EyeQuality>("eyeQuality")
+        .def_readonly("nSamples", &SMIbuff::EyeQuality::nSamples)
+        .def_readonly("nLost", &SMIbuff::EyeQuality::nLost)
+        .def_readonly("dataLoss", &SMIbuff::EyeQuality::dataLoss)
+        .def_readonly("rms", &SMIbuff::EyeQuality::rms)
+        .def_readonly("stdev", &SMIbuff::EyeQuality::stdev)
+        .def_readonly("meanX", &SMIbuff::EyeQuality::meanX)
+        .def_readonly("meanY", &SMIbuff::EyeQuality::meanY)
+        .def_readonly("offsetX", &SMIbuff::EyeQuality::offsetX)
+        .def_readonly("offsetY", &SMIbuff::EyeQuality::offsetY)
+        .def_readonly("offset", &SMIbuff::EyeQuality::offset)
+        ;
+    class_<SMIbuff::QualityMetrics>("qualityMetrics")
+        .def_readonly("windowStart", &SMIbuff::QualityMetrics::windowStart)
+        .def_readonly("windowEnd", &SMIbuff::QualityMetrics::windowEnd)
+        .def_readonly("left", &SMIbuff::QualityMetrics::left)
+        .def_readonly("right", &SMIbuff::QualityMetrics::right)
+        ;
+
+    class_<SMIbuff::OverflowCounts>("overflowCounts")
+        .def_readonly("dropped", &SMIbuff::OverflowCounts::dropped)
+        .def_readonly("spilled", &SMIbuff::OverflowCounts::spilled)
+        .def_readonly("compressed", &SMIbuff::OverflowCounts::compressed)
+        ;
+
+    // runtime statistics, see SMIbuff::BufferStats and SMIbuff::StreamStats. Times in ns
+    class_<SMIbuff::BufferStats>("bufferStats")
+        .def_readonly("dropped", &SMIbuff::BufferStats::dropped)
+        .def_readonly("spilled", &SMIbuff::BufferStats::spilled)
+        .def_readonly("compressed", &SMIbuff::BufferStats::compressed)
+        .def_readonly("compressedBytes", &SMIbuff::BufferStats::compressedBytes)
+        .def_readonly("peakSize", &SMIbuff::BufferStats::peakSize)
+        .def_readonly("chunkAllocations", &SMIbuff::BufferStats::chunkAllocations)
+        .def_readonly("lockWaits", &SMIbuff::BufferStats::lockWaits)
+        .def_readonly("lockWaitTime", &SMIbuff::BufferStats::lockWaitTime)
+        .def_readonly("maxLockWait", &SMIbuff::BufferStats::maxLockWait)
+        ;
+    class_<SMIbuff::StreamStats, bases<SMIbuff::BufferStats>>("streamStats")
+        .def_readonly("received", &SMIbuff::StreamStats::received)
+        .def_readonly("maxCallbackDuration", &SMIbuff::StreamStats::maxCallbackDuration)
+        .def_readonly("totalCallbackDuration", &SMIbuff::StreamStats::totalCallbackDuration)
+        // bin 0: intervals < 1 us, bin i: [2^(i-1), 2^i) us, last bin: all longer
+        .add_property("intervalHistogram", getIntervalHistogram)
+        ;
+    // sample delivery latency relative to the fastest delivery (see getClockModel), in us
+    class_<SMIbuff::LatencyStats>("latencyStats")
+        .def_readonly("n", &SMIbuff::LatencyStats::n)
+        .def_readonly("total", &SMIbuff::LatencyStats::total)
+        .def_readonly("max", &SMIbuff::LatencyStats::max)
+        // bins as for streamStats.intervalHistogram
+        .add_property("histogram", getLatencyHistogram)
+        ;
+    class_<SMIbuff::Stats>("stats")
+        .def_readonly("samples", &SMIbuff::Stats::samples)
+        .def_readonly("events", &SMIbuff::Stats::events)
+        .def_readonly("latency", &SMIbuff::Stats::latency)
+        ;
+
+    // host = tracker + offset + drift * (tracker - refTracker), times in us
+    class_<SMIbuff::ClockModel>("clockModel")
+        .def_readonly("refTracker", &SMIbuff::ClockModel::refTracker)
+        .def_readonly("offset", &SMIbuff::ClockModel::offset)
+        .def_readonly("drift", &SMIbuff::ClockModel::drift)
+        .def_readonly("nWindows", &SMIbuff::ClockModel::nWindows)
+        .def("toHost", &SMIbuff::ClockModel::toHost)
+        .def("toTracker", &SMIbuff::ClockModel::toTracker)
+        ;
+
+    // see markEpoch. hostTime is std::chrono::steady_clock, in us
+    class_<SMIbuff::Epoch>("epoch")
+        .def_readonly("label", &SMIbuff::Epoch::label)
+        .def_readonly("trackerTime", &SMIbuff::Epoch::trackerTime)
+        .def_readonly("hostTime", &SMIbuff::Epoch::hostTime)
+        .add_property("isOpen", &SMIbuff::Epoch::isOpen)
+        ;
+
     class_<SMIbuffer, boost::noncopyable>("SMIbuffer", init<optional<bool>>())
         .def("startSampleBuffering", &SMIbuffer::startSampleBuffering, startSampleBuffering_overloads())
         .def("startEventBuffering" , &SMIbuffer:: startEventBuffering,  startEventBuffering_overloads())
@@ -129,9 +970,158 @@ BOOST_PYTHON_MODULE(SMIbuffer_python)
         .def("stopEventBuffering" , &SMIbuffer:: stopEventBuffering)
 
         // get the data and command messages received since the last call to this function
-        .def("consumeSamples", consumeSamples, consumeSamples_overloads())
+        // reader is optional, so that firstN can be left at its default: consumeSamples(reader='name')
+        .def("consumeSamples", consumeSamples, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount, arg("reader")=std::string(SMIbuff::g_defaultReader)))
         .def("peekSamples", peekSamples, peekSamples_overloads())
-        .def("consumeEvents", consumeEvents, consumeEvents_overloads())
+        .def("consumeEvents", consumeEvents, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount, arg("reader")=std::string(SMIbuff::g_defaultReader)))
         .def("peekEvents", peekEvents, peekEvents_overloads())
+        // same, but output as NumPy structured array (field names as for the namedtuples). Much faster for many samples
+        .def("consumeSamplesArray", consumeSamplesArray, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount, arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekSamplesArray", peekSamplesArray, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+        .def("consumeEventsArray", consumeEventsArray, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount, arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEventsArray", peekEventsArray, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+        // samples as a dict of 1D NumPy arrays, one per field ('timestamp', and 'leftEye'
+        // and 'rightEye' as dicts of arrays). fields selects which are output, only those
+        // are copied: a list of names (e.g. ['timestamp', 'gazeX', 'gazeY']; 'gazeX' is
+        // that field of both eyes, 'leftEye.gazeX' of one eye, 'leftEye' all its fields)
+        // or a bitmask. Default: all
+        .def("consumeSampleColumns", consumeSampleColumns, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount, arg("reader")=std::string(SMIbuff::g_defaultReader), arg("fields")=api::object()))
+        .def("peekSampleColumns", peekSampleColumns, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount, arg("fields")=api::object()))
+        // consume into a preallocated NumPy array (out = numpy.empty(n, sampleDtype())),
+        // returns the number of samples written to the start of out. Allocates nothing,
+        // e.g. for polling every frame
+        .def("consumeSamplesInto", consumeSamplesInto, (arg("self"), arg("out"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        // newest sample as (timestamp, leftGazeX, leftGazeY, rightGazeX, rightGazeY), or
+        // None. Much cheaper than peekSamples(1), e.g. for gaze-contingent displays
+        .def("getLatestSample", getLatestSample, (arg("self"), arg("arrivalTime")=false))
+
+        // time range queries, timestamps in the SDK's clock (events by start time). Range
+        // is [tStart, tEnd); consume*Until consumes everything with timestamp < t
+        .def("peekSamplesRange", peekSamplesRange, (arg("self"), arg("tStart"), arg("tEnd")))
+        .def("consumeSamplesUntil", consumeSamplesUntil, (arg("self"), arg("t"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekSamplesRangeArray", peekSamplesRangeArray, (arg("self"), arg("tStart"), arg("tEnd")))
+        .def("consumeSamplesUntilArray", consumeSamplesUntilArray, (arg("self"), arg("t"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEventsRange", peekEventsRange, (arg("self"), arg("tStart"), arg("tEnd")))
+        .def("consumeEventsUntil", consumeEventsUntil, (arg("self"), arg("t"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEventsRangeArray", peekEventsRangeArray, (arg("self"), arg("tStart"), arg("tEnd")))
+        .def("consumeEventsUntilArray", consumeEventsUntilArray, (arg("self"), arg("t"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+
+        // wait without polling (timeout in ms), with the GIL released. waitForSamples and
+        // waitForTimestamp return False on timeout, waitFor(Detected)Event the first
+        // matching event that arrived after the call, or None on timeout
+        .def("waitForSamples", waitForSamples, (arg("self"), arg("n"), arg("timeout"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("waitForTimestamp", waitForTimestamp, (arg("self"), arg("t"), arg("timeout")))
+        .def("waitForEvent", waitForEvent, (arg("self"), arg("type"), arg("timeout")))
+        .def("waitForDetectedEvent", waitForDetectedEvent, (arg("self"), arg("type"), arg("timeout")))
+
+        // number of samples/events dropped, spilled to disk or compressed because buffer was full
+        .def("getSampleOverflowCounts", &SMIbuffer::getSampleOverflowCounts)
+        .def("getEventOverflowCounts" , &SMIbuffer:: getEventOverflowCounts)
+        // runtime statistics of both streams, accumulated until resetStats()
+        .def("getStats", &SMIbuffer::getStats)
+        .def("resetStats", &SMIbuffer::resetStats)
+
+        // relation between the tracker's clock (sample timestamps) and host time
+        // (getHostTime()), estimated as samples arrive. Conversions return None while
+        // there is no model yet
+        .def("getClockModel", getClockModel)
+        .def("trackerToHostTime", trackerToHostTime, (arg("self"), arg("trackerTime")))
+        .def("hostToTrackerTime", hostToTrackerTime, (arg("self"), arg("hostTime")))
+
+        // readers: each reader consumes independently and gets all samples/events. The
+        // default reader ('') is used when no reader is given to consumeSamples/consumeEvents
+        .def("addSampleReader", &SMIbuffer::addSampleReader)
+        .def("addEventReader" , &SMIbuffer:: addEventReader)
+        .def("removeSampleReader", &SMIbuffer::removeSampleReader)
+        .def("removeEventReader" , &SMIbuffer:: removeEventReader)
+        .def("getSampleReaders", getSampleReaders)
+        .def("getEventReaders" , getEventReaders)
+
+        // write all samples and events to a binary log file in the background, read
+        // it back with readLog. Interval (ms) is how often new data is written
+        .def("startLogging", startLogging, (arg("self"), arg("file"), arg("interval")=SMIbuff::g_logIntervalDefault))
+        .def("stopLogging", stopLogging)
+        .def("isLogging", isLogging, (arg("self"), arg("writeFailed")=false))
+
+        // online fixation ('F') and saccade ('S') detection on the incoming samples. The
+        // detected events have their own buffer. Saccades are also reported at their
+        // onset, with endTime and duration 0
+        .def("startEventDetection", &SMIbuffer::startEventDetection, startEventDetection_overloads())
+        .def("stopEventDetection", &SMIbuffer::stopEventDetection, stopEventDetection_overloads())
+        .def("isDetectingEvents", &SMIbuffer::isDetectingEvents)
+        .def("clearDetectedEventBuffer", &SMIbuffer::clearDetectedEventBuffer)
+        .def("consumeDetectedEvents", consumeDetectedEvents, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount))
+        .def("peekDetectedEvents", peekDetectedEvents, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+        .def("consumeDetectedEventsArray", consumeDetectedEventsArray, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount))
+        .def("peekDetectedEventsArray", peekDetectedEventsArray, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+
+        // data-quality metrics (precision, data loss, offset) over a sliding window of the
+        // incoming samples, updated as they arrive. getQuality is cheap enough to call
+        // every frame, and returns a qualityMetrics, or None if never started
+        .def("startQualityMonitor", &SMIbuffer::startQualityMonitor, startQualityMonitor_overloads())
+        .def("stopQualityMonitor", &SMIbuffer::stopQualityMonitor)
+        .def("isMonitoringQuality", &SMIbuffer::isMonitoringQuality)
+        .def("getQuality", getQuality)
+
+        // publish samples and events live in shared-memory rings name+'_samples' and
+        // name+'_events', for other processes to follow with sharedSampleReader and
+        // sharedEventReader. Capacities are rounded up to a power of two, readers that
+        // fall further behind lose the oldest data
+        .def("startSharing", &SMIbuffer::startSharing, (arg("self"), arg("name"), arg("sampleCapacity")=SMIbuff::g_sharedSampleCapacityDefault, arg("eventCapacity")=SMIbuff::g_sharedEventCapacityDefault))
+        .def("stopSharing", &SMIbuffer::stopSharing)
+        .def("isSharing", &SMIbuffer::isSharing)
+
+        // per-sample transforms (list of transformStage, applied in order) on a background
+        // thread. Transformed samples have their own buffer, lost data is NaN in them
+        .def("startTransforms", startTransforms, (arg("self"), arg("stages"), arg("interval")=SMIbuff::g_transformIntervalDefault, arg("bufferSize")=SMIbuff::g_sampleBufDefaultSize, arg("overflowPolicy")=SMIbuff::g_overflowPolicyDefault))
+        .def("stopTransforms", stopTransforms, (arg("self"), arg("emptyBuffer")=SMIbuff::g_stopBufferEmptiesDefault))
+        .def("isTransforming", &SMIbuffer::isTransforming)
+        .def("clearTransformedSampleBuffer", &SMIbuffer::clearTransformedSampleBuffer)
+        .def("consumeTransformedSamples", consumeTransformedSamples, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount))
+        .def("peekTransformedSamples", peekTransformedSamples, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+        .def("consumeTransformedSamplesArray", consumeTransformedSamplesArray, (arg("self"), arg("firstN")=SMIbuff::g_consumeDefaultAmount))
+        .def("peekTransformedSamplesArray", peekTransformedSamplesArray, (arg("self"), arg("lastN")=SMIbuff::g_peekDefaultAmount))
+
+        // epochs (e.g. trials): markEpoch starts one and returns its index, its data is
+        // what arrives until the next markEpoch or endEpoch. Retrieval takes the epoch's
+        // index or label (the last epoch with that label) and needs no search.
+        // consumeEpoch* moves the reader past the end of the epoch, trimEpochs discards
+        // everything up to the end of the epoch for all readers
+        .def("markEpoch", &SMIbuffer::markEpoch)
+        .def("endEpoch", &SMIbuffer::endEpoch)
+        .def("findEpoch", findEpoch)
+        .def("getEpochs", getEpochs)
+        .def("clearEpochs", &SMIbuffer::clearEpochs)
+        .def("peekEpochSamples", peekEpochSamples, (arg("self"), arg("epoch")))
+        .def("consumeEpochSamples", consumeEpochSamples, (arg("self"), arg("epoch"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEpochEvents", peekEpochEvents, (arg("self"), arg("epoch")))
+        .def("consumeEpochEvents", consumeEpochEvents, (arg("self"), arg("epoch"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEpochSamplesArray", peekEpochSamplesArray, (arg("self"), arg("epoch")))
+        .def("consumeEpochSamplesArray", consumeEpochSamplesArray, (arg("self"), arg("epoch"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("peekEpochEventsArray", peekEpochEventsArray, (arg("self"), arg("epoch")))
+        .def("consumeEpochEventsArray", consumeEpochEventsArray, (arg("self"), arg("epoch"), arg("reader")=std::string(SMIbuff::g_defaultReader)))
+        .def("trimEpochs", trimEpochs, (arg("self"), arg("epoch")))
+
+        // samples covered by an event (startTime <= timestamp <= endTime). Events are
+        // identified by their position: the number of events received before them.
+        // getLatestEvent returns the newest event of a type (e.g. 'F', '' for any) still
+        // stored and its position, or None. Each event's samples are looked up once,
+        // after that they are read directly
+        .def("getEventSamples", getEventSamples, (arg("self"), arg("eventPos")))
+        .def("getEventSamplesArray", getEventSamplesArray, (arg("self"), arg("eventPos")))
+        .def("getLatestEvent", getLatestEvent, (arg("self"), arg("type")))
         ;
+
+    def("readLog", readLog, arg("file"));
+    // follow the shared rings of an SMIbuffer in another process (see startSharing):
+    // attach(name, fromOldest=False) to e.g. 'name_samples', then read(maxN) returns the
+    // new samples or events as a NumPy structured array, as the ...Array functions do.
+    // lost counts those overwritten before they could be read
+    defSharedReader<SampleStruct>("sharedSampleReader");
+    defSharedReader<EventStruct>("sharedEventReader");
+    // host time: std::chrono::steady_clock in us, the clock of the clock model, arrival
+    // times and epochs
+    def("getHostTime", SMIbuff::hostTimeNow);
+    // dtype of the sample structured arrays, for preallocating the output of consumeSamplesInto
+    def("sampleDtype", sampleDtype);
 }
\ No newline at end of file
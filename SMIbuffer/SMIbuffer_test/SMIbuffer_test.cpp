@@ -0,0 +1,491 @@
+// tests of the SMIbuffer storage engine, run by ctest (see CMakeLists.txt). Data comes
+// from a ReplaySource of generated samples (at speed 0, so as fast as possible) or from
+// a SyntheticSource, no eye tracker needed. Each test is run by name:
+//   overflowPolicies    each overflow policy keeps or drops what it should, and counts it
+//   multiReaderConsume  readers consuming concurrently with the producer all get every sample
+//   compressedRoundTrip what goes into a CompressedStore comes back out bit for bit
+//   logTruncatedTail    readLog returns the intact prefix of a log whose tail is cut off
+//   trimWhileLogging    trimming epochs doesn't lose data not yet logged or transformed
+//   stopEmptyingBuffer  stopping buffering with emptying the buffer doesn't lose data not yet logged
+//   detectorSaccades    event detection finds the fixations of synthetic gaze data
+//   sharedRingLapping   SharedRingReader counts what the writer overwrote before it was read
+//
+// usage: SMIbuffer_test testName
+#include "SMIbuffer/SMIbuffer.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <filesystem>
+
+namespace
+{
+    int g_nFailed = 0;
+
+#define CHECK(cond_) \
+    do { if (!(cond_)) { std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond_); g_nFailed++; } } while (0)
+
+    constexpr double g_sampleRate = 2000.;
+
+    // noisy binocular samples at g_sampleRate, with a stretch of lost data (all zeros)
+    // every now and then
+    std::vector<SampleStruct> makeSamples(size_t n_, uint32_t seed_ = 1)
+    {
+        std::mt19937 rng(seed_);
+        std::normal_distribution<double> noise(0., .5);
+        std::vector<SampleStruct> out(n_);
+        for (size_t i = 0; i < n_; i++)
+        {
+            auto& s = out[i];
+            s.timestamp = static_cast<long long>(std::llround(i * 1e6 / g_sampleRate));
+            if (i % 1000 >= 950)
+                continue;
+            for (auto eye : {&s.leftEye, &s.rightEye})
+            {
+                eye->gazeX = 960. + noise(rng);
+                eye->gazeY = 540. + noise(rng);
+                eye->diam  = 4. + noise(rng) / 10.;
+                eye->eyePositionX = (eye == &s.leftEye ? -32. : 32.) + noise(rng);
+                eye->eyePositionZ = 600. + noise(rng);
+            }
+        }
+        return out;
+    }
+
+    void waitForFinished(const SMIbuff::ThreadedSource& source_)
+    {
+        while (!source_.finished())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool increasing(const std::vector<SampleStruct>& data_)
+    {
+        for (size_t i = 1; i < data_.size(); i++)
+            if (data_[i].timestamp <= data_[i - 1].timestamp)
+                return false;
+        return true;
+    }
+
+    std::string tempPath(const std::string& name_)
+    {
+        return (std::filesystem::temp_directory_path() / name_).string();
+    }
+
+    // replays input_ into a buffer of capacity_ under policy_
+    struct PolicyResult
+    {
+        std::vector<SampleStruct>   consumed;
+        SMIbuff::OverflowCounts     counts;
+    };
+    PolicyResult runPolicy(const std::vector<SampleStruct>& input_, SMIbuff::OverflowPolicy policy_, size_t capacity_, double speed_)
+    {
+        auto source = std::make_shared<SMIbuff::ReplaySource>(input_, std::vector<EventStruct>{}, speed_);
+        SMIbuffer buffer(false, source);
+        buffer.startSampleBuffering(capacity_, policy_);
+        waitForFinished(*source);
+        buffer.stopSampleBuffering(false);
+
+        PolicyResult out;
+        out.counts   = buffer.getSampleOverflowCounts();
+        out.consumed = buffer.consumeSamples();
+        return out;
+    }
+
+    void testOverflowPolicies()
+    {
+        constexpr size_t n = 20000, capacity = 2000;
+        const auto input = makeSamples(n);
+
+        // grows to hold everything
+        auto r = runPolicy(input, SMIbuff::OverflowPolicy::Grow, capacity, 0.);
+        CHECK(r.consumed.size() == n);
+        CHECK(!r.counts.dropped && !r.counts.spilled && !r.counts.compressed);
+
+        // keeps the newest capacity samples
+        r = runPolicy(input, SMIbuff::OverflowPolicy::DropOldest, capacity, 0.);
+        CHECK(r.consumed.size() <= capacity && !r.consumed.empty());
+        CHECK(r.counts.dropped == n - r.consumed.size());
+        CHECK(r.consumed.back().timestamp == input.back().timestamp);
+        CHECK(increasing(r.consumed));
+
+        // keeps the oldest capacity samples
+        r = runPolicy(input, SMIbuff::OverflowPolicy::DropNewest, capacity, 0.);
+        CHECK(r.consumed.size() <= capacity && !r.consumed.empty());
+        CHECK(r.counts.dropped == n - r.consumed.size());
+        CHECK(r.consumed.front().timestamp == input.front().timestamp);
+        CHECK(r.consumed.back().timestamp == input[r.consumed.size() - 1].timestamp);
+
+        // the spill thread easily keeps up at 4x real time: nothing lost, and the moved
+        // part comes back in order and unchanged
+        const std::vector<SampleStruct> shorter(input.begin(), input.begin() + 4 * capacity);
+        for (auto policy : {SMIbuff::OverflowPolicy::SpillToDisk, SMIbuff::OverflowPolicy::Compress})
+        {
+            r = runPolicy(shorter, policy, capacity, 4.);
+            const auto moved = policy == SMIbuff::OverflowPolicy::SpillToDisk ? r.counts.spilled : r.counts.compressed;
+            CHECK(moved > 0);
+            CHECK(r.counts.dropped == 0);
+            CHECK(r.consumed.size() == shorter.size() && std::memcmp(r.consumed.data(), shorter.data(), shorter.size() * sizeof(SampleStruct)) == 0);
+        }
+    }
+
+    void testMultiReaderConsume()
+    {
+        constexpr size_t n = 200000;
+        const auto input = makeSamples(n);
+        auto source = std::make_shared<SMIbuff::ReplaySource>(input, std::vector<EventStruct>{}, 0.);
+        SMIbuffer buffer(false, source);
+        const std::vector<std::string> readers = {"a", "b", "c"};
+        for (const auto& reader : readers)
+            CHECK(buffer.addSampleReader(reader));
+        CHECK(buffer.removeSampleReader(SMIbuff::g_defaultReader));
+        buffer.startSampleBuffering(1000, SMIbuff::OverflowPolicy::Grow);
+
+        // each reader on its own thread, consuming in different batch sizes while samples
+        // come in
+        std::vector<std::vector<SampleStruct>> got(readers.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < readers.size(); i++)
+            threads.emplace_back([&, i]()
+            {
+                const size_t batch = i == 0 ? 1 : i == 1 ? 97 : SMIbuff::g_consumeDefaultAmount;
+                while (got[i].size() < n)
+                {
+                    const bool finished = source->finished();
+                    auto samples = buffer.consumeSamples(batch, readers[i]);
+                    got[i].insert(got[i].end(), samples.begin(), samples.end());
+                    if (samples.empty() && finished)
+                        break;
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+        buffer.stopSampleBuffering(false);
+
+        for (const auto& samples : got)
+            CHECK(samples.size() == n && std::memcmp(samples.data(), input.data(), n * sizeof(SampleStruct)) == 0);
+        // all consumed by all readers: storage released
+        CHECK(buffer.peekSamples(SMIbuff::g_peekDefaultAmount).empty());
+    }
+
+    void testCompressedRoundTrip()
+    {
+        constexpr size_t n = 10 * SMIbuff::g_compressedBlockSize + 123;     // last block incomplete
+        const auto input = makeSamples(n);
+        SMIbuff::CompressedStore<SampleStruct> store;
+        std::mt19937 rng(2);
+        for (size_t i = 0; i < n;)
+        {
+            const auto chunk = std::min<size_t>(n - i, std::uniform_int_distribution<size_t>(1, 3000)(rng));
+            store.append(input.data() + i, chunk);
+            i += chunk;
+        }
+        CHECK(store.size() == n);
+        CHECK(store.memoryUsage() < n * sizeof(SampleStruct));     // noisy doubles barely compress, the rest does
+
+        std::vector<SampleStruct> out(n);
+        CHECK(store.read(0, out.data(), n) == n);
+        CHECK(std::memcmp(out.data(), input.data(), n * sizeof(SampleStruct)) == 0);
+        // reads starting and ending mid-block, and reading past the end
+        for (int i = 0; i < 100; i++)
+        {
+            const auto first = std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+            const auto count = std::uniform_int_distribution<size_t>(1, 5000)(rng);
+            const auto nRead = store.read(first, out.data(), count);
+            CHECK(nRead == std::min(count, n - first));
+            CHECK(std::memcmp(out.data(), input.data() + first, nRead * sizeof(SampleStruct)) == 0);
+        }
+        // released blocks can't be read, the rest still can
+        store.release(3 * SMIbuff::g_compressedBlockSize);
+        CHECK(store.read(0, out.data(), 1) == 0);
+        CHECK(store.read(3 * SMIbuff::g_compressedBlockSize, out.data(), n) == n - 3 * SMIbuff::g_compressedBlockSize);
+        CHECK(std::memcmp(out.data(), input.data() + 3 * SMIbuff::g_compressedBlockSize, (n - 3 * SMIbuff::g_compressedBlockSize) * sizeof(SampleStruct)) == 0);
+    }
+
+    void testLogTruncatedTail()
+    {
+        constexpr size_t n = 20000;
+        const auto input = makeSamples(n);
+        std::vector<EventStruct> events;
+        for (size_t i = 100; i < n; i += 500)
+        {
+            EventStruct e{};
+            e.eventType = 'F';
+            e.eye       = 'l';
+            e.startTime = input[i - 100].timestamp;
+            e.endTime   = input[i].timestamp;
+            e.duration  = e.endTime - e.startTime;
+            events.push_back(e);
+        }
+        const auto path = tempPath("SMIbuffer_test_log.bin");
+        auto source = std::make_shared<SMIbuff::ReplaySource>(input, events, 20.);
+        SMIbuffer buffer(false, source);
+        buffer.startEventBuffering();
+        buffer.startSampleBuffering();
+        CHECK(buffer.startLogging(path, 5));
+        waitForFinished(*source);
+        buffer.stopLogging();
+        buffer.stopSampleBuffering(false);
+        buffer.stopEventBuffering(false);
+        // the log holds what was buffered
+        const auto samples = buffer.peekSamples(SMIbuff::g_consumeDefaultAmount);
+        const auto bufEvents = buffer.peekEvents(SMIbuff::g_consumeDefaultAmount);
+
+        SMIbuff::LogContents log;
+        CHECK(SMIbuff::readLog(path, log));
+        CHECK(log.complete);
+        CHECK(log.samples.size() == samples.size() && std::memcmp(log.samples.data(), samples.data(), samples.size() * sizeof(SampleStruct)) == 0);
+        CHECK(log.events.size() == bufEvents.size() && !bufEvents.empty());
+
+        // cut at various places: in the last block's elements, in its header, and halfway
+        const auto size = std::filesystem::file_size(path);
+        for (auto cut : {uint64_t(1), uint64_t(sizeof(SampleStruct) / 2), uint64_t(1000), size / 2})
+        {
+            std::filesystem::resize_file(path, size - cut);
+            SMIbuff::LogContents partial;
+            CHECK(SMIbuff::readLog(path, partial));
+            CHECK(!partial.complete || cut > 1);
+            CHECK(partial.samples.size() + partial.events.size() < log.samples.size() + log.events.size());
+            CHECK(partial.samples.size() <= samples.size() && std::memcmp(partial.samples.data(), samples.data(), partial.samples.size() * sizeof(SampleStruct)) == 0);
+            CHECK(partial.events.size() <= bufEvents.size() && std::memcmp(partial.events.data(), bufEvents.data(), partial.events.size() * sizeof(EventStruct)) == 0);
+        }
+        // only the file header left: valid, but empty
+        std::filesystem::resize_file(path, sizeof(SMIbuff::LogFileHeader));
+        SMIbuff::LogContents empty;
+        CHECK(SMIbuff::readLog(path, empty) && empty.complete && empty.samples.empty() && empty.events.empty());
+        // not even that
+        std::filesystem::resize_file(path, sizeof(SMIbuff::LogFileHeader) - 1);
+        CHECK(!SMIbuff::readLog(path, empty));
+        std::filesystem::remove(path);
+    }
+
+    void testTrimWhileLogging()
+    {
+        constexpr size_t n = 20000;
+        const auto input = makeSamples(n);
+        const auto path = tempPath("SMIbuffer_test_trim.bin");
+        auto source = std::make_shared<SMIbuff::ReplaySource>(input, std::vector<EventStruct>{}, 10.);
+        SMIbuffer buffer(false, source);
+        // log and transform threads run less often than epochs are trimmed, so trimming
+        // discards data they haven't gotten to yet
+        CHECK(buffer.startLogging(path, 1000));
+        CHECK(buffer.startTransforms({SMIbuff::TransformStage{}}, 1000));
+        buffer.startSampleBuffering();
+        size_t nTrimmed = 0;
+        for (size_t epoch = 0; !source->finished(); epoch++)
+        {
+            buffer.markEpoch("e" + std::to_string(epoch));
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            if (epoch)
+                nTrimmed += buffer.trimEpochs(epoch - 1);
+        }
+        buffer.stopSampleBuffering(false);
+        buffer.stopLogging();
+        buffer.stopTransforms(false);
+        const auto nTransformed = buffer.consumeTransformedSamples().size();
+
+        SMIbuff::LogContents log;
+        CHECK(nTrimmed > 10);
+        CHECK(SMIbuff::readLog(path, log));
+        CHECK(log.samples.size() == n && std::memcmp(log.samples.data(), input.data(), n * sizeof(SampleStruct)) == 0);
+        CHECK(nTransformed == n);
+        std::filesystem::remove(path);
+    }
+
+    void testStopEmptyingBuffer()
+    {
+        constexpr size_t n = 20000;
+        const auto input = makeSamples(n);
+        const auto path = tempPath("SMIbuffer_test_stop.bin");
+        auto source = std::make_shared<SMIbuff::ReplaySource>(input, std::vector<EventStruct>{}, 0.);
+        SMIbuffer buffer(false, source);
+        // the log and transform threads don't get to run before the buffer is emptied
+        CHECK(buffer.startLogging(path, 10000));
+        SMIbuff::TransformStage offset;
+        offset.x = 1.;
+        offset.y = 2.;
+        CHECK(buffer.startTransforms({ offset }, 10000));
+        buffer.startSampleBuffering();
+        waitForFinished(*source);
+        buffer.stopSampleBuffering(true);
+        CHECK(buffer.peekSamples().empty());
+        buffer.stopLogging();
+
+        const auto transformed = buffer.consumeTransformedSamples();
+        buffer.stopTransforms(true);
+        CHECK(transformed.size() == n);
+        bool same = transformed.size() == n;
+        for (size_t i = 0; same && i < n; i++)
+        {
+            const bool lost = input[i].leftEye.gazeX == 0.;     // NaN after transforming
+            same = transformed[i].timestamp == input[i].timestamp &&
+                   (lost ? std::isnan(transformed[i].leftEye.gazeX)  : transformed[i].leftEye.gazeX  == input[i].leftEye.gazeX - 1.) &&
+                   (lost ? std::isnan(transformed[i].rightEye.gazeY) : transformed[i].rightEye.gazeY == input[i].rightEye.gazeY - 2.);
+        }
+        CHECK(same);
+
+        SMIbuff::LogContents log;
+        CHECK(SMIbuff::readLog(path, log));
+        CHECK(log.samples.size() == n && std::memcmp(log.samples.data(), input.data(), n * sizeof(SampleStruct)) == 0);
+        std::filesystem::remove(path);
+    }
+
+    void testDetectorSaccades()
+    {
+        // record a few seconds of synthetic data: its fixation events are the truth
+        auto synthetic = std::make_shared<SMIbuff::SyntheticSource>(1000., 3);
+        SMIbuffer recorder(false, synthetic);
+        recorder.startEventBuffering();
+        recorder.startSampleBuffering();
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        recorder.stopSampleBuffering(false);
+        recorder.stopEventBuffering(false);
+        const auto samples = recorder.consumeSamples();
+        const auto truth   = recorder.consumeEvents();
+
+        // and detect on it as fast as possible
+        auto replay = std::make_shared<SMIbuff::ReplaySource>(samples, std::vector<EventStruct>{}, 0.);
+        SMIbuffer buffer(false, replay);
+        buffer.startEventDetection();       // default settings
+        buffer.startSampleBuffering();
+        waitForFinished(*replay);
+        buffer.stopSampleBuffering(false);
+        buffer.stopEventDetection(false);
+        const auto detected = buffer.consumeDetectedEvents();
+
+        // each true fixation is detected, give or take the saccades' slow start and end
+        constexpr long long tolerance = 15000;
+        size_t nTruth = 0, nMatched = 0, nSaccades = 0, nOnsets = 0;
+        for (const auto& t : truth)
+        {
+            nTruth++;
+            for (const auto& d : detected)
+                if (d.eventType == SMIbuff::g_fixationEvent && d.eye == t.eye &&
+                    std::llabs(d.startTime - t.startTime) < tolerance && std::llabs(d.endTime - t.endTime) < tolerance)
+                {
+                    nMatched++;
+                    break;
+                }
+        }
+        // and every detected saccade lies between true fixations
+        for (const auto& d : detected)
+        {
+            if (d.eventType == SMIbuff::g_saccadeEvent && !d.endTime)
+                nOnsets++;
+            if (d.eventType != SMIbuff::g_saccadeEvent || !d.endTime)
+                continue;
+            nSaccades++;
+            for (const auto& t : truth)
+                CHECK(d.eye != t.eye || d.endTime <= t.startTime + tolerance || d.startTime >= t.endTime - tolerance);
+        }
+        CHECK(nTruth >= 4);
+        CHECK(nMatched == nTruth);
+        CHECK(nSaccades >= nTruth / 2);
+        // the fixations' noise doesn't produce onsets: every onset is followed by a saccade, but
+        // for one cut short by the end of the recording
+        CHECK(nOnsets <= nSaccades + 1);
+    }
+
+    void testSharedRingLapping()
+    {
+        const auto name = "SMIbuffer_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        constexpr size_t capacity = 64;
+        SMIbuff::SharedRingWriter<SampleStruct> writer;
+        CHECK(writer.create(name, capacity));
+        const auto input = makeSamples(1000);
+
+        SMIbuff::SharedRingReader<SampleStruct> reader;
+        CHECK(reader.attach(name));
+        std::vector<SampleStruct> out;
+        // keeping up: nothing lost
+        for (size_t i = 0; i < 40; i++)
+            writer.push(input[i]);
+        CHECK(reader.read(out) == 40);
+        CHECK(reader.getLost() == 0 && reader.getPosition() == 40);
+        // lapped: the oldest are lost, the newest capacity are read
+        for (size_t i = 40; i < 300; i++)
+            writer.push(input[i]);
+        CHECK(reader.available() == 260);
+        out.clear();
+        CHECK(reader.read(out) == capacity);
+        CHECK(reader.getLost() == 260 - capacity);
+        CHECK(reader.getPosition() == 300);
+        CHECK(out.front().timestamp == input[300 - capacity].timestamp && out.back().timestamp == input[299].timestamp);
+
+        // a late reader starts at the writer, or at the oldest still in the ring
+        SMIbuff::SharedRingReader<SampleStruct> late, oldest;
+        CHECK(late.attach(name) && !late.available());
+        CHECK(oldest.attach(name, true) && oldest.available() == capacity);
+
+        // through SMIbuffer, at speed 0, so the reader may well not keep up: read + lost
+        // accounts for all samples
+        const auto many = makeSamples(200000);
+        auto source = std::make_shared<SMIbuff::ReplaySource>(many, std::vector<EventStruct>{}, 0.);
+        SMIbuffer buffer(false, source);
+        CHECK(buffer.startSharing(name, capacity, capacity));
+        SMIbuff::SharedRingReader<SampleStruct> follower;
+        CHECK(follower.attach(name + SMIbuff::g_sharedSampleSuffix));
+        buffer.startSampleBuffering(1000, SMIbuff::OverflowPolicy::DropOldest);
+        size_t nRead = 0;
+        long long last = -1;
+        bool ordered = true;
+        while (!source->finished() || follower.available())
+        {
+            out.clear();
+            nRead += follower.read(out);
+            for (const auto& s : out)
+            {
+                ordered = ordered && s.timestamp > last;
+                last = s.timestamp;
+            }
+        }
+        buffer.stopSampleBuffering();
+        buffer.stopSharing();
+        CHECK(ordered);
+        CHECK(nRead + follower.getLost() == many.size());
+    }
+
+    struct Test
+    {
+        const char* name;
+        void      (*run)();
+    };
+    constexpr Test g_tests[] =
+    {
+        {"overflowPolicies",    testOverflowPolicies},
+        {"multiReaderConsume",  testMultiReaderConsume},
+        {"compressedRoundTrip", testCompressedRoundTrip},
+        {"logTruncatedTail",    testLogTruncatedTail},
+        {"trimWhileLogging",    testTrimWhileLogging},
+        {"stopEmptyingBuffer",  testStopEmptyingBuffer},
+        {"detectorSaccades",    testDetectorSaccades},
+        {"sharedRingLapping",   testSharedRingLapping},
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: SMIbuffer_test testName\n");
+        return 2;
+    }
+    for (const auto& test : g_tests)
+        if (std::strcmp(argv[1], test.name) == 0)
+        {
+            test.run();
+            if (g_nFailed)
+                std::fprintf(stderr, "%s: %d checks failed\n", test.name, g_nFailed);
+            return g_nFailed ? 1 : 0;
+        }
+    std::fprintf(stderr, "unknown test: %s\n", argv[1]);
+    return 2;
+}
@@ -0,0 +1,273 @@
+#include "SMIbuffer/DataSource.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#ifndef SMIBUFFER_NO_IVIEWX
+#   include <iViewXAPI.h>
+#   if _WIN64
+#       pragma comment(lib, "iViewXAPI64.lib")
+#   else
+#       pragma comment(lib, "iViewXAPI.lib")
+#   endif
+
+namespace {
+    // the SDK takes plain C callbacks, these forward to the callbacks set on IViewXSource
+    SMIbuff::DataSource::SampleCallback g_sampleCallback;
+    SMIbuff::DataSource::EventCallback  g_eventCallback;
+
+    int __stdcall SMISampleCallback(SampleStruct sample_)
+    {
+        g_sampleCallback(sample_);
+        return 1;
+    }
+    int __stdcall SMIEventCallback(EventStruct event_)
+    {
+        g_eventCallback(event_);
+        return 1;
+    }
+}
+
+namespace SMIbuff
+{
+    int IViewXSource::setSampleCallback(SampleCallback callback_)
+    {
+        // unregister before changing the callback, so the SDK's thread doesn't call it meanwhile
+        const auto ret = iV_SetSampleCallback(nullptr);
+        g_sampleCallback = std::move(callback_);
+        return g_sampleCallback ? iV_SetSampleCallback(SMISampleCallback) : ret;
+    }
+    int IViewXSource::setEventCallback(EventCallback callback_)
+    {
+        const auto ret = iV_SetEventCallback(nullptr);
+        g_eventCallback = std::move(callback_);
+        return g_eventCallback ? iV_SetEventCallback(SMIEventCallback) : ret;
+    }
+}
+#endif
+
+namespace SMIbuff
+{
+    std::shared_ptr<DataSource> defaultDataSource()
+    {
+#ifdef SMIBUFFER_NO_IVIEWX
+        return nullptr;
+#else
+        return std::make_shared<IViewXSource>();
+#endif
+    }
+
+
+    ThreadedSource::~ThreadedSource()
+    {
+        // NB: derived class should already have stopped the thread, as produce() can't
+        // be called anymore by now
+        stopThread();
+    }
+
+    int ThreadedSource::setSampleCallback(SampleCallback callback_)
+    {
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            _sampleCallback = std::move(callback_);
+        }
+        updateThread();
+        return g_sourceSuccess;
+    }
+    int ThreadedSource::setEventCallback(EventCallback callback_)
+    {
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            _eventCallback = std::move(callback_);
+        }
+        updateThread();
+        return g_sourceSuccess;
+    }
+
+    void ThreadedSource::stopThread()
+    {
+        _stop = true;
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    void ThreadedSource::updateThread()
+    {
+        bool active;
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            active = _sampleCallback || _eventCallback;
+        }
+        if (active && !_thread.joinable())
+        {
+            _stop = false;
+            _thread = std::thread(&ThreadedSource::run, this);
+        }
+        else if (!active)
+            stopThread();
+    }
+
+    void ThreadedSource::run()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        while (!_stop.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> l(_mutex);
+                if (!produce(_elapsed + (std::chrono::steady_clock::now() - start)))
+                {
+                    _finished.store(true, std::memory_order_release);
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        _elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+
+    namespace
+    {
+        // the SDK reports events once they've ended
+        long long eventTime(const EventStruct& event_)
+        {
+            return event_.endTime ? event_.endTime : event_.startTime;
+        }
+    }
+
+    ReplaySource::ReplaySource(std::vector<SampleStruct> samples_, std::vector<EventStruct> events_, double speed_ /*= 1.*/, bool loop_ /*= false*/) :
+        _samples(std::move(samples_)),
+        _events(std::move(events_)),
+        _speed(speed_),
+        _loop(loop_)
+    {
+        if (_samples.empty() && _events.empty())
+            return;
+
+        constexpr auto tMax = std::numeric_limits<long long>::max();
+        _t0 = std::min(_samples.empty() ? tMax : _samples.front().timestamp, _events.empty() ? tMax : _events.front().startTime);
+        const auto tEnd = std::max(_samples.empty() ? _t0 : _samples.back().timestamp, _events.empty() ? _t0 : eventTime(_events.back()));
+        // one sample interval between the end of a repetition and the start of the next
+        const auto interval = _samples.size() > 1 ? (_samples.back().timestamp - _samples.front().timestamp) / static_cast<long long>(_samples.size() - 1) : 1;
+        _period = std::max(tEnd - _t0 + interval, 1LL);
+    }
+    ReplaySource::~ReplaySource()
+    {
+        stopThread();
+    }
+
+    bool ReplaySource::produce(std::chrono::duration<double> elapsed_)
+    {
+        if (_samples.empty() && _events.empty())
+            return false;
+
+        constexpr auto tMax = std::numeric_limits<long long>::max();
+        const auto due = _speed > 0. ? _t0 + static_cast<long long>(elapsed_.count() * 1e6 * _speed) : tMax;
+        // as fast as possible: emit in batches, so the thread can be stopped
+        for (size_t budget = 1 << 16; budget; budget--)
+        {
+            const auto tSample = _iSample < _samples.size() ? _samples[_iSample].timestamp + _offset : tMax;
+            const auto tEvent  = _iEvent  < _events.size()  ? eventTime(_events[_iEvent]) + _offset : tMax;
+            if (tSample == tMax && tEvent == tMax)
+            {
+                if (!_loop)
+                    return false;
+                _offset += _period;
+                _iSample = _iEvent = 0;
+                continue;
+            }
+            if (std::min(tSample, tEvent) > due)
+                break;
+
+            if (tSample <= tEvent)
+            {
+                auto sample = _samples[_iSample++];
+                sample.timestamp += _offset;
+                emitSample(sample);
+            }
+            else
+            {
+                auto event = _events[_iEvent++];
+                event.startTime += _offset;
+                event.endTime   += _offset;
+                emitEvent(event);
+            }
+        }
+        return true;
+    }
+
+
+    SyntheticSource::SyntheticSource(double sampleRate_ /*= 1000.*/, uint32_t seed_ /*= 0*/) :
+        _sampleRate(sampleRate_),
+        _rng(seed_)
+    {
+        nextFixation();
+    }
+    SyntheticSource::~SyntheticSource()
+    {
+        stopThread();
+    }
+
+    void SyntheticSource::nextFixation()
+    {
+        std::uniform_real_distribution<double> xDist(100., 1820.), yDist(100., 980.), durDist(150e3, 400e3);
+        _fromX = _x;
+        _fromY = _y;
+        _x = xDist(_rng);
+        _y = yDist(_rng);
+        // saccade duration grows with amplitude, roughly 20 ms + 2 ms/deg at ~40 px/deg
+        const auto amplitude = std::hypot(_x - _fromX, _y - _fromY);
+        _saccadeStart = _fixEnd;
+        _fixStart = _saccadeStart + static_cast<long long>(20e3 + amplitude / 40. * 2e3);
+        _fixEnd = _fixStart + static_cast<long long>(durDist(_rng));
+    }
+
+    bool SyntheticSource::produce(std::chrono::duration<double> elapsed_)
+    {
+        std::normal_distribution<double> gazeNoise(0., .5), diamNoise(0., .05), posNoise(0., .2);
+        const auto due = static_cast<uint64_t>(elapsed_.count() * _sampleRate);
+        for (; _iSample < due; _iSample++)
+        {
+            const auto ts = static_cast<long long>(std::llround(_iSample * 1e6 / _sampleRate));
+            if (ts >= _fixEnd)
+            {
+                EventStruct event{};
+                event.eventType = 'F';
+                event.startTime = _fixStart;
+                event.endTime   = _fixEnd;
+                event.duration  = _fixEnd - _fixStart;
+                event.positionX = _x;
+                event.positionY = _y;
+                for (auto eye : {'l', 'r'})
+                {
+                    event.eye = eye;
+                    emitEvent(event);
+                }
+                nextFixation();
+            }
+
+            double x = _x, y = _y;
+            if (ts < _fixStart)
+            {
+                const auto f = static_cast<double>(ts - _saccadeStart) / static_cast<double>(_fixStart - _saccadeStart);
+                x = _fromX + f * (_x - _fromX);
+                y = _fromY + f * (_y - _fromY);
+            }
+
+            SampleStruct sample{};
+            sample.timestamp = ts;
+            for (auto eye : {&sample.leftEye, &sample.rightEye})
+            {
+                const auto side = eye == &sample.leftEye ? -1. : 1.;
+                eye->gazeX        = x + gazeNoise(_rng);
+                eye->gazeY        = y + gazeNoise(_rng);
+                eye->diam         = 4. + diamNoise(_rng);
+                eye->eyePositionX = side * 32. + posNoise(_rng);
+                eye->eyePositionY = posNoise(_rng);
+                eye->eyePositionZ = 600. + posNoise(_rng);
+            }
+            emitSample(sample);
+        }
+        return true;
+    }
+}
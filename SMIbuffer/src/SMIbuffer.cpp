@@ -1,55 +1,77 @@
 #include "SMIbuffer/SMIbuffer.h"
 #include <vector>
-#include <shared_mutex>
 #include <algorithm>
 
 namespace {
-    SMIbuffer* SMIbufferClassInstance=nullptr;  // for plain C callback to be able to call into the class instances
-
-    typedef std::shared_timed_mutex mutex_type;
-    typedef std::shared_lock<mutex_type> read_lock;
-    typedef std::unique_lock<mutex_type> write_lock;
-
-    mutex_type g_mSamp, g_mEvent;
-
-    template <typename T>
-    read_lock  lockForReading() { return  read_lock(getMutex<T>()); }
-    template <typename T>
-    write_lock lockForWriting() { return write_lock(getMutex<T>()); }
-
-    template <typename T>
-    mutex_type& getMutex()
+    // index in SMIbuff::SampleStorage
+    size_t sampleStorageIndex(SMIbuff::SampleLayout layout_, const SMIbuff::SampleProfile& profile_)
     {
-        if constexpr (std::is_same<T, SampleStruct>::value)
-            return g_mSamp;
-        if constexpr (std::is_same<T, EventStruct>::value)
-            return g_mEvent;
+        return profile_.isFull() ? static_cast<size_t>(layout_) : 1 + profile_.index();
+    }
+    template <size_t... I>
+    void emplaceSampleStorage(SMIbuff::SampleStorage& storage_, size_t index_, std::index_sequence<I...>)
+    {
+        ((index_ == I ? void(storage_.emplace<I>()) : void()), ...);
     }
 }
 
-int __stdcall SMISampleCallback(SampleStruct sample_)
+// NB: the callbacks run on the data source's thread (e.g. the SDK's). Pushing into the
+// buffers is lock-free, so they never have to wait for a reader
+void SMIbuffer::onSample(SampleStruct sample_)
 {
-    if (SMIbufferClassInstance)
+    const auto start = SMIbuff::CallbackStats::clock_type::now();
+    _sampleQuiescence.enter();
+    if (_doEyeSwap)
+        std::swap(sample_.leftEye, sample_.rightEye);
+
+    std::visit([&sample_](auto& buf_) { buf_.push(sample_); }, _sampleData);
+    const auto arrival = std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count();
+    _latestSample.store({sample_, arrival});
+    _sampleNotifier.notify();
+    if (const auto detector = _detector.get())
+        detector->process(sample_, [this](const EventStruct& event_) { _detectedEventData.push(event_); _detectedEventNotifier.notify(); });
+    if (const auto quality = _quality.get())
     {
-        if (SMIbufferClassInstance->_doEyeSwap)
-            std::swap(sample_.leftEye, sample_.rightEye);
-
-        auto l = lockForWriting<SampleStruct>();
-        SMIbufferClassInstance->_sampleData.push_back(sample_);
+        quality->process(sample_);
+        _qualityMetrics.store(quality->getMetrics());
     }
+    if (const auto shared = _sharedSamples.get())
+        shared->push(sample_);
+    _sampleQuiescence.leave();
+    if (_clockSync.process(sample_.timestamp, arrival))
+        _clockModel.store(_clockSync.getModel());
+    _latency.record(arrival - _clockSync.getModel().toHost(sample_.timestamp));
+    _sampleStats.record(start, SMIbuff::CallbackStats::clock_type::now());
+}
 
-    return 1;
+void SMIbuffer::onEvent(const EventStruct& event_)
+{
+    const auto start = SMIbuff::CallbackStats::clock_type::now();
+    _eventData.push(event_);
+    _eventNotifier.notify();
+    _eventQuiescence.enter();
+    if (const auto shared = _sharedEvents.get())
+        shared->push(event_);
+    _eventQuiescence.leave();
+    _eventStats.record(start, SMIbuff::CallbackStats::clock_type::now());
 }
 
-int __stdcall SMIEventCallback(EventStruct event_)
+int SMIbuffer::setSampleCallback(bool set_)
 {
-    if (SMIbufferClassInstance)
-    {
-        auto l = lockForWriting<EventStruct>();
-        SMIbufferClassInstance->_eventData.push_back(event_);
-    }
+    if (!_dataSource)
+        return 0;
+    if (set_)
+        return _dataSource->setSampleCallback([this](const SampleStruct& sample_) { onSample(sample_); });
+    return _dataSource->setSampleCallback(nullptr);
+}
 
-    return 1;
+int SMIbuffer::setEventCallback(bool set_)
+{
+    if (!_dataSource)
+        return 0;
+    if (set_)
+        return _dataSource->setEventCallback([this](const EventStruct& event_) { onEvent(event_); });
+    return _dataSource->setEventCallback(nullptr);
 }
 
 
@@ -57,60 +79,54 @@ int __stdcall SMIEventCallback(EventStruct event_)
 
 
 // helpers to make below generic
-template <typename T>
-std::vector<T>& SMIbuffer::getBuffer()
+template <typename T, typename F>
+decltype(auto) SMIbuffer::withBuffer(F&& f_)
 {
     if constexpr (std::is_same_v<T, SampleStruct>)
-        return _sampleData;
+        return std::visit(std::forward<F>(f_), _sampleData);
     if constexpr (std::is_same_v<T, EventStruct>)
-        return _eventData;
+        return f_(_eventData);
 }
 template <typename T>
 void SMIbuffer::clearBuffer()
 {
-    auto l = lockForWriting<T>();
-    getBuffer<T>().clear();
+    withBuffer<T>([](auto& buf_) { buf_.clear(); });
 }
 template <typename T>
 void SMIbuffer::stopBufferingGenericPart(bool emptyBuffer_)
 {
-    if (emptyBuffer_)
-        clearBuffer<T>();
+    if (!emptyBuffer_)
+        return;
+    // make sure what is cleared is logged (and transformed), as clearSampleBuffer and clearEventBuffer do
+    std::lock_guard<std::mutex> l(_logMutex);
+    std::lock_guard<std::mutex> tl(_transformMutex);
+    writeLog();
+    if constexpr (std::is_same_v<T, SampleStruct>)
+        processTransforms();
+    clearBuffer<T>();
 }
 template <typename T>
 std::vector<T> SMIbuffer::peek(size_t lastN_)
 {
-    auto l = lockForReading<T>();
-    auto& buf = getBuffer<T>();
-    // copy last N or whole vector if less than N elements available
-    return std::vector<T>(buf.end() - std::min(buf.size(), lastN_), buf.end());
+    return withBuffer<T>([&](auto& buf_) { return buf_.peek(lastN_); });
 }
 template <typename T>
-std::vector<T> SMIbuffer::consume(size_t firstN_)
+std::vector<T> SMIbuffer::consume(size_t firstN_, const std::string& reader_)
 {
-    auto l = lockForWriting<T>();
-    auto& buf = getBuffer<T>();
-
-    if (firstN_ == -1 || firstN_ >= buf.size())		// firstN_=-1 overflows, so first check strictly not needed. Better keep code legible tho
-        return std::vector<T>(std::move(buf));
-    else
-    {
-        std::vector<T> out;
-        out.reserve(firstN_);
-        out.insert(out.end(), std::make_move_iterator(buf.begin()), std::make_move_iterator(buf.begin() + firstN_));
-        buf.erase(buf.begin(), buf.begin() + firstN_);
-        return out;
-    }
+    return withBuffer<T>([&](auto& buf_) { return buf_.consume(firstN_, reader_); });
 }
 
 
 
-SMIbuffer::SMIbuffer(bool needsEyeSwap_ /*= false*/) :
-    _doEyeSwap(needsEyeSwap_)
+SMIbuffer::SMIbuffer(bool needsEyeSwap_ /*= false*/, std::shared_ptr<SMIbuff::DataSource> dataSource_ /*= SMIbuff::defaultDataSource()*/) :
+    _doEyeSwap(needsEyeSwap_),
+    _dataSource(std::move(dataSource_))
 {}
 
 SMIbuffer::~SMIbuffer()
 {
+    stopLogging();
+    stopTransforms(true);
     stopSampleBuffering(true);
     stopEventBuffering (true);
 }
@@ -120,65 +136,737 @@ void SMIbuffer::setEyeSwap(const bool& needsEyeSwap_)
     _doEyeSwap = needsEyeSwap_;
 }
 
-int SMIbuffer::startSampleBuffering(size_t initialBufferSize_ /*= SMIbuff::g_sampleBufDefaultSize*/)
+void SMIbuffer::setDataSource(std::shared_ptr<SMIbuff::DataSource> dataSource_)
 {
-    // make sure we know what class instance should receive the data
-    SMIbufferClassInstance = this;
+    if (_bufferingSamples)
+        setSampleCallback(false);
+    if (_bufferingEvents)
+        setEventCallback(false);
+    _dataSource = std::move(dataSource_);
+    // the new source's tracker clock may be another
+    _clockSync = SMIbuff::ClockSync{};
+    if (_bufferingSamples)
+        setSampleCallback(true);
+    if (_bufferingEvents)
+        setEventCallback(true);
+}
 
-    auto l = lockForWriting<SampleStruct>();
-    _sampleData.reserve(initialBufferSize_);
+int SMIbuffer::startSampleBuffering(size_t bufferSize_ /*= SMIbuff::g_sampleBufDefaultSize*/, SMIbuff::OverflowPolicy overflowPolicy_ /*= SMIbuff::g_overflowPolicyDefault*/, SMIbuff::SampleLayout sampleLayout_ /*= SMIbuff::g_sampleLayoutDefault*/, const SMIbuff::SampleProfile& sampleProfile_ /*= SMIbuff::SampleProfile{}*/)
+{
+    const auto storage = sampleStorageIndex(sampleLayout_, sampleProfile_);
+    if (_sampleData.index() != storage)
+    {
+        // different layout or profile: recreate storage. Make sure callback isn't pushing into it
+        // and log and transform threads aren't reading from it meanwhile
+        setSampleCallback(false);
+        std::lock_guard<std::mutex> l(_logMutex);
+        std::lock_guard<std::mutex> tl(_transformMutex);
+        writeLog();
+        processTransforms();
+        emplaceSampleStorage(_sampleData, storage, std::make_index_sequence<std::variant_size_v<SMIbuff::SampleStorage>>{});
+        {
+            std::lock_guard<std::mutex> el(_epochMutex);
+            _epochs.resetSamplePositions();
+        }
+        {
+            std::lock_guard<std::mutex> el(_eventSampleMutex);
+            _eventSamples.resetSamplePositions();
+        }
+        if (_logWriter.isOpen())
+            withBuffer<SampleStruct>([](auto& buf_) { buf_.addReader(SMIbuff::g_logReader); });
+        if (_transforms)
+            withBuffer<SampleStruct>([](auto& buf_) { buf_.addReader(SMIbuff::g_transformReader); });
+    }
+    withBuffer<SampleStruct>([&](auto& buf_) { buf_.reserve(bufferSize_, overflowPolicy_); });
 
-    return iV_SetSampleCallback(SMISampleCallback);
+    _bufferingSamples = true;
+    return setSampleCallback(true);
 }
 
-int SMIbuffer::startEventBuffering(size_t initialBufferSize_ /*= SMIbuff::g_eventBufDefaultSize*/)
+int SMIbuffer::startEventBuffering(size_t bufferSize_ /*= SMIbuff::g_eventBufDefaultSize*/, SMIbuff::OverflowPolicy overflowPolicy_ /*= SMIbuff::g_overflowPolicyDefault*/)
 {
-    // make sure we know what class instance should receive the data
-    SMIbufferClassInstance = this;
-
-    auto l = lockForWriting<EventStruct>();
-    _eventData.reserve(initialBufferSize_);
+    _eventData.reserve(bufferSize_, overflowPolicy_);
 
-    return iV_SetEventCallback(SMIEventCallback);
+    _bufferingEvents = true;
+    return setEventCallback(true);
 }
 
 void SMIbuffer::clearSampleBuffer()
 {
+    // make sure what is cleared is logged and transformed
+    std::lock_guard<std::mutex> l(_logMutex);
+    std::lock_guard<std::mutex> tl(_transformMutex);
+    writeLog();
+    processTransforms();
     clearBuffer<SampleStruct>();
 }
 
 void SMIbuffer::clearEventBuffer()
 {
+    std::lock_guard<std::mutex> l(_logMutex);
+    writeLog();
     clearBuffer<EventStruct>();
 }
 
 void SMIbuffer::stopSampleBuffering(bool emptyBuffer_ /*= g_stopBufferEmptiesDefault*/)
 {
     // remove callback function
-    iV_SetSampleCallback(nullptr);
+    setSampleCallback(false);
+    _bufferingSamples = false;
     stopBufferingGenericPart<SampleStruct>(emptyBuffer_);
 }
 
 void SMIbuffer::stopEventBuffering(bool emptyBuffer_ /*= g_stopBufferEmptiesDefault*/)
 {
     // remove callback function
-    iV_SetEventCallback(nullptr);
+    setEventCallback(false);
+    _bufferingEvents = false;
     stopBufferingGenericPart<EventStruct>(emptyBuffer_);
 }
 
-std::vector<SampleStruct> SMIbuffer::consumeSamples(size_t firstN_/* = g_consumeDefaultAmount*/)
+std::vector<SampleStruct> SMIbuffer::consumeSamples(size_t firstN_/* = g_consumeDefaultAmount*/, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
 {
-    return consume<SampleStruct>(firstN_);
+    return consume<SampleStruct>(firstN_, reader_);
 }
 std::vector<SampleStruct> SMIbuffer::peekSamples(size_t lastN_/* = g_peekDefaultAmount*/)
 {
     return peek<SampleStruct>(lastN_);
 }
-std::vector<EventStruct> SMIbuffer::consumeEvents(size_t firstN_/* = g_consumeDefaultAmount*/)
+bool SMIbuffer::getLatestSample(SampleStruct& sample_) const
+{
+    int64_t arrivalTime;
+    return getLatestSample(sample_, arrivalTime);
+}
+bool SMIbuffer::getLatestSample(SampleStruct& sample_, int64_t& arrivalTime_) const
+{
+    SMIbuff::ArrivedSample latest;
+    if (!_latestSample.load(latest))
+        return false;
+    sample_      = latest.sample;
+    arrivalTime_ = latest.arrivalTime;
+    return true;
+}
+SMIbuff::SampleColumns SMIbuffer::consumeSampleColumns(size_t firstN_/* = g_consumeDefaultAmount*/, const std::string& reader_/* = SMIbuff::g_defaultReader*/, SMIbuff::SampleFieldMask fields_/* = SMIbuff::SampleField::All*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumeColumns(firstN_, reader_, SMIbuff::SampleColumns(fields_)); });
+}
+SMIbuff::SampleColumns SMIbuffer::peekSampleColumns(size_t lastN_/* = g_peekDefaultAmount*/, SMIbuff::SampleFieldMask fields_/* = SMIbuff::SampleField::All*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekColumns(lastN_, SMIbuff::SampleColumns(fields_)); });
+}
+size_t SMIbuffer::consumeSamplesInto(SampleStruct* out_, size_t capacity_, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumeInto(out_, capacity_, reader_); });
+}
+size_t SMIbuffer::consumeSampleColumnsInto(SMIbuff::SampleColumns& out_, size_t firstN_/* = g_consumeDefaultAmount*/, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumeColumnsInto(out_, firstN_, reader_); });
+}
+std::vector<EventStruct> SMIbuffer::consumeEvents(size_t firstN_/* = g_consumeDefaultAmount*/, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
 {
-    return consume<EventStruct>(firstN_);
+    return consume<EventStruct>(firstN_, reader_);
 }
 std::vector<EventStruct> SMIbuffer::peekEvents(size_t lastN_/* = g_peekDefaultAmount*/)
 {
     return peek<EventStruct>(lastN_);
+}
+bool SMIbuffer::waitForSamples(size_t n_, unsigned timeout_, const std::string& reader_ /*= SMIbuff::g_defaultReader*/)
+{
+    return _sampleNotifier.waitFor(std::chrono::milliseconds(timeout_), [&]()
+    {
+        return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.available(reader_); }) >= n_;
+    });
+}
+bool SMIbuffer::waitForTimestamp(int64_t ts_, unsigned timeout_)
+{
+    return _sampleNotifier.waitFor(std::chrono::milliseconds(timeout_), [&]()
+    {
+        SampleStruct sample;
+        return getLatestSample(sample) && sample.timestamp >= ts_;
+    });
+}
+bool SMIbuffer::waitForEvent(char type_, unsigned timeout_, EventStruct& event_)
+{
+    return waitForEventIn(_eventData, _eventNotifier, type_, timeout_, event_);
+}
+bool SMIbuffer::waitForDetectedEvent(char type_, unsigned timeout_, EventStruct& event_)
+{
+    return waitForEventIn(_detectedEventData, _detectedEventNotifier, type_, timeout_, event_);
+}
+bool SMIbuffer::waitForEventIn(SMIbuff::ChunkedBuffer<EventStruct>& buf_, SMIbuff::Notifier& notifier_, char type_, unsigned timeout_, EventStruct& event_)
+{
+    // a reader of its own that skips what's already there sees exactly the new events
+    const auto reader = SMIbuff::g_waitReaderPrefix + std::to_string(_nWaitReaders.fetch_add(1, std::memory_order_relaxed));
+    buf_.addReader(reader);
+    buf_.advance(reader, SMIbuff::g_consumeDefaultAmount);
+    const auto found = notifier_.waitFor(std::chrono::milliseconds(timeout_), [&]()
+    {
+        for (const auto& event : buf_.consume(SMIbuff::g_consumeDefaultAmount, reader))
+        {
+            if (type_ == SMIbuff::g_anyEventType || event.eventType == type_)
+            {
+                event_ = event;
+                return true;
+            }
+        }
+        return false;
+    });
+    buf_.removeReader(reader);
+    return found;
+}
+std::vector<SampleStruct> SMIbuffer::peekSamplesRange(int64_t tStart_, int64_t tEnd_)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekRange(tStart_, tEnd_); });
+}
+std::vector<SampleStruct> SMIbuffer::consumeSamplesUntil(int64_t ts_, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumeUntil(ts_, reader_); });
+}
+SMIbuff::SampleColumns SMIbuffer::peekSampleColumnsRange(int64_t tStart_, int64_t tEnd_, SMIbuff::SampleFieldMask fields_/* = SMIbuff::SampleField::All*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekRangeColumns(tStart_, tEnd_, SMIbuff::SampleColumns(fields_)); });
+}
+SMIbuff::SampleColumns SMIbuffer::consumeSampleColumnsUntil(int64_t ts_, const std::string& reader_/* = SMIbuff::g_defaultReader*/, SMIbuff::SampleFieldMask fields_/* = SMIbuff::SampleField::All*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumeUntilColumns(ts_, reader_, SMIbuff::SampleColumns(fields_)); });
+}
+std::vector<EventStruct> SMIbuffer::peekEventsRange(int64_t tStart_, int64_t tEnd_)
+{
+    return _eventData.peekRange(tStart_, tEnd_);
+}
+std::vector<EventStruct> SMIbuffer::consumeEventsUntil(int64_t ts_, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return _eventData.consumeUntil(ts_, reader_);
+}
+size_t SMIbuffer::markEpoch(const std::string& label_)
+{
+    SMIbuff::Epoch epoch;
+    epoch.label = label_;
+    SampleStruct sample;
+    if (getLatestSample(sample))
+        epoch.trackerTime = sample.timestamp;
+    epoch.hostTime    = SMIbuff::hostTimeNow();
+    epoch.sampleStart = withBuffer<SampleStruct>([](auto& buf_) { return buf_.writePosition(); });
+    epoch.eventStart  = _eventData.writePosition();
+
+    std::lock_guard<std::mutex> l(_epochMutex);
+    return _epochs.mark(std::move(epoch));
+}
+void SMIbuffer::endEpoch()
+{
+    const auto samplePos = withBuffer<SampleStruct>([](auto& buf_) { return buf_.writePosition(); });
+    const auto eventPos  = _eventData.writePosition();
+    std::lock_guard<std::mutex> l(_epochMutex);
+    _epochs.end(samplePos, eventPos);
+}
+size_t SMIbuffer::findEpoch(const std::string& label_)
+{
+    std::lock_guard<std::mutex> l(_epochMutex);
+    return _epochs.find(label_);
+}
+std::vector<SMIbuff::Epoch> SMIbuffer::getEpochs()
+{
+    std::lock_guard<std::mutex> l(_epochMutex);
+    return _epochs.getAll();
+}
+void SMIbuffer::clearEpochs()
+{
+    std::lock_guard<std::mutex> l(_epochMutex);
+    _epochs.clear();
+}
+bool SMIbuffer::getEpoch(size_t index_, SMIbuff::Epoch& epoch_)
+{
+    std::lock_guard<std::mutex> l(_epochMutex);
+    const auto epoch = _epochs.get(index_);
+    if (!epoch)
+        return false;
+    epoch_ = *epoch;
+    return true;
+}
+std::vector<SampleStruct> SMIbuffer::peekEpochSamples(size_t index_)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekPositions(epoch.sampleStart, epoch.sampleEnd); });
+}
+SMIbuff::SampleColumns SMIbuffer::peekEpochSampleColumns(size_t index_)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.template peekPositionsColumns<SMIbuff::SampleColumns>(epoch.sampleStart, epoch.sampleEnd); });
+}
+std::vector<SampleStruct> SMIbuffer::consumeEpochSamples(size_t index_, const std::string& reader_ /*= SMIbuff::g_defaultReader*/)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.consumePositions(epoch.sampleStart, epoch.sampleEnd, reader_); });
+}
+SMIbuff::SampleColumns SMIbuffer::consumeEpochSampleColumns(size_t index_, const std::string& reader_ /*= SMIbuff::g_defaultReader*/)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.template consumePositionsColumns<SMIbuff::SampleColumns>(epoch.sampleStart, epoch.sampleEnd, reader_); });
+}
+std::vector<EventStruct> SMIbuffer::peekEpochEvents(size_t index_)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return _eventData.peekPositions(epoch.eventStart, epoch.eventEnd);
+}
+std::vector<EventStruct> SMIbuffer::consumeEpochEvents(size_t index_, const std::string& reader_ /*= SMIbuff::g_defaultReader*/)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch))
+        return {};
+    return _eventData.consumePositions(epoch.eventStart, epoch.eventEnd, reader_);
+}
+bool SMIbuffer::trimEpochs(size_t index_)
+{
+    SMIbuff::Epoch epoch;
+    if (!getEpoch(index_, epoch) || epoch.isOpen())
+        return false;
+    // discarding moves all readers, so first log and transform what they haven't gotten to yet
+    std::lock_guard<std::mutex> l(_logMutex);
+    std::lock_guard<std::mutex> tl(_transformMutex);
+    writeLog();
+    processTransforms();
+    withBuffer<SampleStruct>([&](auto& buf_) { buf_.discardUntil(epoch.sampleEnd); });
+    _eventData.discardUntil(epoch.eventEnd);
+    return true;
+}
+SMIbuff::SampleRange SMIbuffer::findEventSamples(const EventStruct& event_)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return SMIbuff::SampleRange{buf_.findPosition(event_.startTime), buf_.findPosition(event_.endTime + 1)}; });
+}
+void SMIbuffer::updateEventSamples()
+{
+    const auto end = _eventData.writePosition();
+    // ranges of events no longer stored aren't needed anymore
+    _eventSamples.discardUntil(end - std::min<uint64_t>(_eventData.size(), end));
+    if (_eventSamples.nextEvent() >= end)
+        return;
+    SampleStruct latest;
+    if (!getLatestSample(latest))
+        return;
+
+    // in order of arrival, up to the first event that may still be missing samples
+    const auto events = _eventData.peekPositions(_eventSamples.nextEvent(), end);
+    auto pos = end - events.size();
+    for (const auto& event : events)
+    {
+        if (event.endTime > latest.timestamp)
+            break;
+        _eventSamples.add(pos++, findEventSamples(event));
+    }
+}
+bool SMIbuffer::getEventSampleRange(uint64_t eventPos_, SMIbuff::SampleRange& range_)
+{
+    {
+        std::lock_guard<std::mutex> l(_eventSampleMutex);
+        updateEventSamples();
+        if (_eventSamples.find(eventPos_, range_))
+            return true;
+    }
+    // not indexed (yet): its samples may still be arriving, look up what is there
+    const auto event = _eventData.peekPositions(eventPos_, eventPos_ + 1);
+    if (event.empty())
+        return false;
+    range_ = findEventSamples(event[0]);
+    return true;
+}
+std::vector<SampleStruct> SMIbuffer::getEventSamples(uint64_t eventPos_)
+{
+    SMIbuff::SampleRange range;
+    if (!getEventSampleRange(eventPos_, range))
+        return {};
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekPositions(range.first, range.end); });
+}
+SMIbuff::SampleColumns SMIbuffer::getEventSampleColumns(uint64_t eventPos_, SMIbuff::SampleFieldMask fields_ /*= SMIbuff::SampleField::All*/)
+{
+    SMIbuff::SampleRange range;
+    if (!getEventSampleRange(eventPos_, range))
+        return SMIbuff::SampleColumns(fields_);
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.peekPositionsColumns(range.first, range.end, SMIbuff::SampleColumns(fields_)); });
+}
+bool SMIbuffer::getLatestEvent(char type_, EventStruct& event_, uint64_t& eventPos_)
+{
+    // search back from the newest event, in ever larger steps
+    auto end = _eventData.writePosition();
+    for (uint64_t n = 16; end; n *= 2)
+    {
+        const auto first  = end - std::min(n, end);
+        const auto events = _eventData.peekPositions(first, end);
+        for (auto i = events.size(); i-- > 0;)
+        {
+            if (type_ == SMIbuff::g_anyEventType || events[i].eventType == type_)
+            {
+                event_    = events[i];
+                eventPos_ = end - events.size() + i;
+                return true;
+            }
+        }
+        // reached the oldest event stored
+        if (events.size() < end - first)
+            break;
+        end = first;
+    }
+    return false;
+}
+SMIbuff::OverflowCounts SMIbuffer::getSampleOverflowCounts() const
+{
+    return std::visit([](const auto& buf_) { return buf_.getOverflowCounts(); }, _sampleData);
+}
+SMIbuff::OverflowCounts SMIbuffer::getEventOverflowCounts() const
+{
+    return _eventData.getOverflowCounts();
+}
+SMIbuff::Stats SMIbuffer::getStats() const
+{
+    SMIbuff::Stats out;
+    static_cast<SMIbuff::BufferStats&>(out.samples) = std::visit([](const auto& buf_) { return buf_.getStats(); }, _sampleData);
+    static_cast<SMIbuff::BufferStats&>(out.events)  = _eventData.getStats();
+    _sampleStats.getStats(out.samples);
+    _eventStats .getStats(out.events);
+    _latency.getStats(out.latency);
+    return out;
+}
+void SMIbuffer::resetStats()
+{
+    std::visit([](auto& buf_) { buf_.resetStats(); }, _sampleData);
+    _eventData.resetStats();
+    _sampleStats.resetStats();
+    _eventStats .resetStats();
+    _latency.resetStats();
+}
+bool SMIbuffer::getClockModel(SMIbuff::ClockModel& model_) const
+{
+    return _clockModel.load(model_);
+}
+bool SMIbuffer::trackerToHostTime(int64_t trackerTime_, int64_t& hostTime_) const
+{
+    SMIbuff::ClockModel model;
+    if (!_clockModel.load(model))
+        return false;
+    hostTime_ = model.toHost(trackerTime_);
+    return true;
+}
+bool SMIbuffer::hostToTrackerTime(int64_t hostTime_, int64_t& trackerTime_) const
+{
+    SMIbuff::ClockModel model;
+    if (!_clockModel.load(model))
+        return false;
+    trackerTime_ = model.toTracker(hostTime_);
+    return true;
+}
+
+void SMIbuffer::startEventDetection(const SMIbuff::DetectorSettings& settings_ /*= SMIbuff::DetectorSettings{}*/, size_t bufferSize_ /*= SMIbuff::g_eventBufDefaultSize*/, SMIbuff::OverflowPolicy overflowPolicy_ /*= SMIbuff::g_overflowPolicyDefault*/)
+{
+    finishEventDetection();
+    _detectedEventData.reserve(bufferSize_, overflowPolicy_);
+    _detector.exchange(std::make_unique<SMIbuff::EventDetector>(settings_));
+}
+void SMIbuffer::stopEventDetection(bool emptyBuffer_ /*= SMIbuff::g_stopBufferEmptiesDefault*/)
+{
+    finishEventDetection();
+    if (emptyBuffer_)
+        _detectedEventData.clear();
+}
+void SMIbuffer::finishEventDetection()
+{
+    auto detector = _detector.exchange(nullptr);
+    if (!detector)
+        return;
+    // once the sample callback is done with the detector, we are the producer of
+    // _detectedEventData
+    _sampleQuiescence.waitForQuiescence();
+    detector->finish([this](const EventStruct& event_) { _detectedEventData.push(event_); _detectedEventNotifier.notify(); });
+}
+bool SMIbuffer::isDetectingEvents() const
+{
+    return static_cast<bool>(_detector);
+}
+void SMIbuffer::clearDetectedEventBuffer()
+{
+    _detectedEventData.clear();
+}
+std::vector<EventStruct> SMIbuffer::consumeDetectedEvents(size_t firstN_ /*= SMIbuff::g_consumeDefaultAmount*/)
+{
+    return _detectedEventData.consume(firstN_);
+}
+std::vector<EventStruct> SMIbuffer::peekDetectedEvents(size_t lastN_ /*= SMIbuff::g_peekDefaultAmount*/)
+{
+    return _detectedEventData.peek(lastN_);
+}
+bool SMIbuffer::startQualityMonitor(const SMIbuff::QualitySettings& settings_ /*= SMIbuff::QualitySettings{}*/)
+{
+    if (!settings_.isValid())
+        return false;
+    auto quality = std::make_unique<SMIbuff::QualityMonitor>(settings_);
+    // the callback must be done storing metrics of the old monitor before we store those
+    // of the new one (_qualityMetrics has a single writer)
+    stopQualityMonitor();
+    _qualityMetrics.store(quality->getMetrics());
+    _quality.exchange(std::move(quality));
+    return true;
+}
+void SMIbuffer::stopQualityMonitor()
+{
+    auto quality = _quality.exchange(nullptr);
+    if (quality)
+        _sampleQuiescence.waitForQuiescence();
+}
+bool SMIbuffer::isMonitoringQuality() const
+{
+    return static_cast<bool>(_quality);
+}
+bool SMIbuffer::startSharing(const std::string& name_, size_t sampleCapacity_ /*= SMIbuff::g_sharedSampleCapacityDefault*/, size_t eventCapacity_ /*= SMIbuff::g_sharedEventCapacityDefault*/)
+{
+    auto samples = std::make_unique<SMIbuff::SharedRingWriter<SampleStruct>>();
+    auto events  = std::make_unique<SMIbuff::SharedRingWriter<EventStruct>>();
+    // the old rings have to be gone before new ones with the same name can be created
+    stopSharing();
+    if (!samples->create(name_ + SMIbuff::g_sharedSampleSuffix, sampleCapacity_) ||
+        !events ->create(name_ + SMIbuff::g_sharedEventSuffix,  eventCapacity_))
+        return false;
+
+    _sharedSamples.exchange(std::move(samples));
+    _sharedEvents .exchange(std::move(events));
+    return true;
+}
+void SMIbuffer::stopSharing()
+{
+    auto samples = _sharedSamples.exchange(nullptr);
+    auto events  = _sharedEvents .exchange(nullptr);
+    // rings are destroyed (and their names released) once the callbacks are done with them
+    if (samples)
+        _sampleQuiescence.waitForQuiescence();
+    if (events)
+        _eventQuiescence.waitForQuiescence();
+}
+bool SMIbuffer::isSharing() const
+{
+    return static_cast<bool>(_sharedSamples);
+}
+bool SMIbuffer::getQuality(SMIbuff::QualityMetrics& metrics_) const
+{
+    return _qualityMetrics.load(metrics_);
+}
+
+bool SMIbuffer::addSampleReader(const std::string& name_)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.addReader(name_); });
+}
+bool SMIbuffer::addEventReader(const std::string& name_)
+{
+    return _eventData.addReader(name_);
+}
+bool SMIbuffer::removeSampleReader(const std::string& name_)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.removeReader(name_); });
+}
+bool SMIbuffer::removeEventReader(const std::string& name_)
+{
+    return _eventData.removeReader(name_);
+}
+std::vector<std::string> SMIbuffer::getSampleReaders()
+{
+    return withBuffer<SampleStruct>([](auto& buf_) { return buf_.getReaders(); });
+}
+std::vector<std::string> SMIbuffer::getEventReaders()
+{
+    return _eventData.getReaders();
+}
+SMIbuff::BufferView<SampleStruct> SMIbuffer::viewSamples(const std::string& reader_/* = SMIbuff::g_defaultReader*/, size_t firstN_/* = g_consumeDefaultAmount*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.view(reader_, firstN_); });
+}
+SMIbuff::BufferView<EventStruct> SMIbuffer::viewEvents(const std::string& reader_/* = SMIbuff::g_defaultReader*/, size_t firstN_/* = g_consumeDefaultAmount*/)
+{
+    return _eventData.view(reader_, firstN_);
+}
+bool SMIbuffer::isValid(const SMIbuff::BufferView<SampleStruct>& view_)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.isValid(view_); });
+}
+bool SMIbuffer::isValid(const SMIbuff::BufferView<EventStruct>& view_)
+{
+    return _eventData.isValid(view_);
+}
+size_t SMIbuffer::advanceSamples(size_t n_, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return withBuffer<SampleStruct>([&](auto& buf_) { return buf_.advance(reader_, n_); });
+}
+size_t SMIbuffer::advanceEvents(size_t n_, const std::string& reader_/* = SMIbuff::g_defaultReader*/)
+{
+    return _eventData.advance(reader_, n_);
+}
+
+bool SMIbuffer::startLogging(const std::string& file_, unsigned logInterval_ /*= SMIbuff::g_logIntervalDefault*/)
+{
+    stopLogging();
+    {
+        std::lock_guard<std::mutex> l(_logMutex);
+        _logWriteFailed = false;
+        if (!_logWriter.open(file_))
+            return false;
+        withBuffer<SampleStruct>([](auto& buf_) { buf_.addReader(SMIbuff::g_logReader); });
+        _eventData.addReader(SMIbuff::g_logReader);
+        _logStop = false;
+    }
+    _logThread = std::thread(&SMIbuffer::logThread, this, logInterval_);
+    return true;
+}
+void SMIbuffer::stopLogging()
+{
+    {
+        std::lock_guard<std::mutex> l(_logMutex);
+        _logStop = true;
+    }
+    _logCondition.notify_all();
+    if (_logThread.joinable())
+        _logThread.join();
+
+    std::lock_guard<std::mutex> l(_logMutex);
+    writeLog();
+    closeLog();
+}
+bool SMIbuffer::isLogging()
+{
+    bool writeFailed;
+    return isLogging(writeFailed);
+}
+bool SMIbuffer::isLogging(bool& writeFailed_)
+{
+    std::lock_guard<std::mutex> l(_logMutex);
+    writeFailed_ = _logWriteFailed;
+    return _logWriter.isOpen();
+}
+void SMIbuffer::logThread(unsigned logInterval_)
+{
+    std::unique_lock<std::mutex> l(_logMutex);
+    while (!_logStop)
+    {
+        _logCondition.wait_for(l, std::chrono::milliseconds(logInterval_), [this]() { return _logStop; });
+        writeLog();
+    }
+}
+void SMIbuffer::writeLog()
+{
+    if (!_logWriter.isOpen())
+        return;
+    // one block per stream per call, batching everything that arrived since last time
+    const auto samples = consumeSamples(SMIbuff::g_consumeDefaultAmount, SMIbuff::g_logReader);
+    const auto events  = consumeEvents (SMIbuff::g_consumeDefaultAmount, SMIbuff::g_logReader);
+    if ((!samples.empty() && !_logWriter.write(samples)) ||
+        (!events .empty() && !_logWriter.write(events)))
+    {
+        // stop logging, so that the log readers don't keep data alive that is never written
+        _logWriteFailed = true;
+        _logStop = true;
+        closeLog();
+    }
+}
+void SMIbuffer::closeLog()
+{
+    if (!_logWriter.isOpen())
+        return;
+    _logWriter.close();
+    withBuffer<SampleStruct>([](auto& buf_) { buf_.removeReader(SMIbuff::g_logReader); });
+    _eventData.removeReader(SMIbuff::g_logReader);
+}
+
+bool SMIbuffer::startTransforms(const std::vector<SMIbuff::TransformStage>& stages_, unsigned interval_ /*= SMIbuff::g_transformIntervalDefault*/, size_t bufferSize_ /*= SMIbuff::g_sampleBufDefaultSize*/, SMIbuff::OverflowPolicy overflowPolicy_ /*= SMIbuff::g_overflowPolicyDefault*/)
+{
+    if (!std::all_of(stages_.begin(), stages_.end(), [](const auto& stage_) { return stage_.isValid(); }))
+        return false;
+    stopTransforms();
+    {
+        std::lock_guard<std::mutex> l(_transformMutex);
+        _transformedData.reserve(bufferSize_, overflowPolicy_);
+        _transforms = std::make_unique<SMIbuff::TransformPipeline>(stages_);
+        withBuffer<SampleStruct>([](auto& buf_) { buf_.addReader(SMIbuff::g_transformReader); });
+        _transformStop = false;
+    }
+    _transformThread = std::thread(&SMIbuffer::transformThread, this, interval_);
+    return true;
+}
+void SMIbuffer::stopTransforms(bool emptyBuffer_ /*= SMIbuff::g_stopBufferEmptiesDefault*/)
+{
+    {
+        std::lock_guard<std::mutex> l(_transformMutex);
+        _transformStop = true;
+    }
+    _transformCondition.notify_all();
+    if (_transformThread.joinable())
+        _transformThread.join();
+
+    std::lock_guard<std::mutex> l(_transformMutex);
+    if (_transforms)
+    {
+        processTransforms();
+        _transforms.reset();
+        withBuffer<SampleStruct>([](auto& buf_) { buf_.removeReader(SMIbuff::g_transformReader); });
+    }
+    if (emptyBuffer_)
+        _transformedData.clear();
+}
+bool SMIbuffer::isTransforming()
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    return _transforms != nullptr;
+}
+void SMIbuffer::clearTransformedSampleBuffer()
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    processTransforms();
+    _transformedData.clear();
+}
+std::vector<SampleStruct> SMIbuffer::consumeTransformedSamples(size_t firstN_ /*= SMIbuff::g_consumeDefaultAmount*/)
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    processTransforms();
+    return _transformedData.consume(firstN_);
+}
+std::vector<SampleStruct> SMIbuffer::peekTransformedSamples(size_t lastN_ /*= SMIbuff::g_peekDefaultAmount*/)
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    processTransforms();
+    return _transformedData.peek(lastN_);
+}
+SMIbuff::SampleColumns SMIbuffer::consumeTransformedSampleColumns(size_t firstN_ /*= SMIbuff::g_consumeDefaultAmount*/)
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    processTransforms();
+    return _transformedData.consumeColumns<SMIbuff::SampleColumns>(firstN_);
+}
+SMIbuff::SampleColumns SMIbuffer::peekTransformedSampleColumns(size_t lastN_ /*= SMIbuff::g_peekDefaultAmount*/)
+{
+    std::lock_guard<std::mutex> l(_transformMutex);
+    processTransforms();
+    return _transformedData.peekColumns<SMIbuff::SampleColumns>(lastN_);
+}
+void SMIbuffer::transformThread(unsigned interval_)
+{
+    std::unique_lock<std::mutex> l(_transformMutex);
+    while (!_transformStop)
+    {
+        _transformCondition.wait_for(l, std::chrono::milliseconds(interval_), [this]() { return _transformStop; });
+        processTransforms();
+    }
+}
+void SMIbuffer::processTransforms()
+{
+    if (!_transforms)
+        return;
+    // everything that arrived since last time as one batch, transformed in place
+    // into the reused _transformBatch, so the arrays only allocate when a batch is bigger than before
+    if (!consumeSampleColumnsInto(_transformBatch, SMIbuff::g_consumeDefaultAmount, SMIbuff::g_transformReader))
+        return;
+    _transforms->apply(_transformBatch);
+    _transformedData.push(_transformBatch, 0, _transformBatch.size());
 }
\ No newline at end of file
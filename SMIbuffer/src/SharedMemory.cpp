@@ -0,0 +1,154 @@
+#include "SMIbuffer/SharedRing.h"
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    std::string mappingName(const std::string& name_)
+    {
+        return "Local\\" + name_;
+    }
+#else
+    std::string mappingName(const std::string& name_)
+    {
+        return "/" + name_;
+    }
+#endif
+}
+
+namespace SMIbuff
+{
+    SharedMemory::~SharedMemory()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+    bool SharedMemory::create(const std::string& name_, size_t size_)
+    {
+        close();
+        const auto size = static_cast<uint64_t>(size_);
+        HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), mappingName(name_).c_str());
+        if (!handle)
+            return false;
+        if (GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            // someone still has a previous block with this name open, and file mappings
+            // can't be replaced
+            CloseHandle(handle);
+            return false;
+        }
+        void* data = MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, size_);
+        if (!data)
+        {
+            CloseHandle(handle);
+            return false;
+        }
+        _handle = handle;
+        _data   = data;
+        _size   = size_;
+        _owner  = true;
+        _name   = name_;
+        return true;
+    }
+    bool SharedMemory::open(const std::string& name_)
+    {
+        close();
+        HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName(name_).c_str());
+        if (!handle)
+            return false;
+        void* data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (!data || !VirtualQuery(data, &info, sizeof(info)))
+        {
+            if (data)
+                UnmapViewOfFile(data);
+            CloseHandle(handle);
+            return false;
+        }
+        _handle = handle;
+        _data   = data;
+        _size   = info.RegionSize;
+        _owner  = false;
+        _name   = name_;
+        return true;
+    }
+    void SharedMemory::close()
+    {
+        if (_data)
+            UnmapViewOfFile(_data);
+        if (_handle)
+            CloseHandle(_handle);
+        _data   = nullptr;
+        _handle = nullptr;
+        _size   = 0;
+        _owner  = false;
+        _name.clear();
+    }
+#else
+    bool SharedMemory::create(const std::string& name_, size_t size_)
+    {
+        close();
+        const auto name = mappingName(name_);
+        // a previous block with this name stays valid for those that have it open
+        shm_unlink(name.c_str());
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            return false;
+        void* data = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(size_)) == 0)
+            data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+        _data  = data;
+        _size  = size_;
+        _owner = true;
+        _name  = name_;
+        return true;
+    }
+    bool SharedMemory::open(const std::string& name_)
+    {
+        close();
+        const int fd = shm_open(mappingName(name_).c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        _data  = data;
+        _size  = static_cast<size_t>(st.st_size);
+        _owner = false;
+        _name  = name_;
+        return true;
+    }
+    void SharedMemory::close()
+    {
+        if (_data)
+            munmap(_data, _size);
+        if (_owner)
+            shm_unlink(mappingName(_name).c_str());
+        _data  = nullptr;
+        _size  = 0;
+        _owner = false;
+        _name.clear();
+    }
+#endif
+}